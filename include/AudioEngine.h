@@ -1,18 +1,40 @@
 #pragma once
 
-#include <imgui/imgui.h>
-
-#include <pulse/simple.h>
+#include <pulse/channelmap.h>
+#include <pulse/sample.h>
 
 #include <fmt/core.h>
 
-#include <fftw3.h>
-
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <string>
 #include <vector>
 #include <thread>
-#include <optional>
 #include <mutex>
 
+#include "AudioSource.h"
+#include "DSP/BandMatrix.h"
+#include "DSP/ConstantQ.h"
+#include "DSP/Descriptors.h"
+#include "DSP/FFTBatch.h"
+#include "DSP/LevelMeter.h"
+#include "DSP/Rhythm.h"
+#include "DSP/Smoothing.h"
+#include "DSP/Stereo.h"
+#include "DSP/Weighting.h"
+#include "LatencyHistogram.h"
+#include "Recorder.h"
+#include "SPSCRing.h"
+#include "SampleHistory.h"
+#include "SpectrumFrame.h"
+#include "ThreadPool.h"
+
+// The ImGui helpers are defined in AudioEngineGUI.cpp, so the analysis itself builds without ImGui
+struct ImVec2;
+
 namespace gaz
 {
 
@@ -20,34 +42,118 @@ class AudioEngine
 {
 public:
 
-	enum struct Channel
+	// How the DFT output is turned into the published spectrum
+	enum struct Analysis
+	{
+		Linear, // the usable DFT bins, evenly spaced from 0Hz to the nyquist frequency
+		ConstantQ // log spaced bins, a fixed number per octave, see DSP::ConstantQKernel
+	};
+
+	// Time constants for the temporal smoothing of each frame, see SpectrumFrame
+	struct SmoothingSettings
 	{
-		Left = 0, // default for mono
-		Right = 1
+		float attackSeconds = 0.01f; // how quickly the smoothed spectrum follows rising levels
+		float releaseSeconds = 0.25f; // ...and falling ones
+		float peakFallDecibelsPerSecond = 24.0f; // how quickly held peaks fall
+		float averageSeconds = 10.0f; // time constant of the long-term average
 	};
 
 	struct SamplingSettings
 	{
-		const unsigned char numChannels; // 1 mono, 2 stereo
+		// 1 mono, 2 stereo, up to PA_CHANNELS_MAX. Channels are addressed by index, in PulseAudio's default order
+		// for the count (see getChannelName)
+		const unsigned char numChannels;
 		const unsigned int sampleRate; // samples per second
-		const unsigned int numSamples; // number of samples or 'frames'
+		const unsigned int numSamples; // number of samples or 'frames' in each DFT window
 		const pa_sample_format_t sampleFormat; // the size of a sample
+
+		// Short-time Fourier transform, the DFT window slides along by hopSize frames each time, so successive
+		// windows overlap when it's smaller than numSamples. 0 uses numSamples, i.e. no overlap
+		const unsigned int hopSize = 0;
+
+		// number of frames requested from the source in each (blocking) read, 0 uses numSamples. This is
+		// independent of the hop size, one read can produce several DFT frames
+		const unsigned int framesPerRead = 0;
+
+		// Start with a quickly estimated DFT plan, and swap to the optimal one once it's been planned in the
+		// background, rather than blocking init(). Either way the plan is cached for the next run
+		const bool upgradePlanInBackground = true;
+
+		// Constant-Q needs a large DFT for musically useful low bins (around 16384 frames at 44.1kHz for 24 bins
+		// per octave down to ~80Hz), the lowest bin is raised if the window is too short for minFrequency
+		const Analysis analysis = Analysis::Linear;
+		const unsigned int binsPerOctave = 24;
+		const float minFrequency = 32.70f; // C1
+
+		// Threads analysing the channels of each window in parallel, counting the recording thread, at most one
+		// per channel. 0 uses the hardware concurrency
+		const unsigned int numWorkerThreads = 0;
+
+		unsigned int getHopSize() const { return hopSize != 0 ? hopSize : numSamples; }
+
+		unsigned int getFramesPerRead() const { return framesPerRead != 0 ? framesPerRead : numSamples; }
 	};
 
-	AudioEngine(const SamplingSettings& settings) :
+	// The engine takes ownership of the source it records from
+	AudioEngine(const SamplingSettings& settings, std::unique_ptr<AudioSource> source) :
 		m_samplingSettings{settings},
-		m_source{nullptr},
-		m_sampleBuffer{},
+		m_source{std::move(source)},
+		m_blockRing{s_blockRingCapacity},
+		m_blockMutex{},
+		m_blockCondition{},
+		m_captureFinished{false},
+		m_lastBlockMutex{},
+		m_lastBlock{},
+		m_sampleFormat{DSP::SampleFormat::Float32},
+		m_channelMap{},
+		m_framesSinceHop{0},
+		m_history{nullptr},
 		m_recordingActive{false},
 		m_recordingThread{nullptr},
+		m_captureThread{nullptr},
+		m_threadPool{nullptr},
 		m_numSpectrumBuckets{20},
-		m_fftData{},
-		m_dftOutputCombined{},
-		m_dftOutputReady{false},
-		m_histogramSmoothing{0.0f}
+		m_spectrumBandScale{DSP::BandScale::Log},
+		m_customBandEdges{},
+		m_bandMatrix{nullptr},
+		m_pendingBandMatrixMutex{},
+		m_pendingBandMatrix{nullptr},
+		m_hasPendingBandMatrix{false},
+		m_bandPower{},
+		m_descriptorPower{},
+		m_fft{nullptr},
+		m_constantQ{nullptr},
+		m_constantQOutput{},
+		m_numOutputBins{0},
+		m_binOffsets{},
+		m_dftBinGains{},
+		m_frequencyWeighting{DSP::FrequencyWeighting::None},
+		m_windowWeighting{DSP::FrequencyWeighting::None},
+		m_levelMeters{},
+		m_loudnessWeights{},
+		m_onsetDetector{nullptr},
+		m_tempoTracker{nullptr},
+		m_stereoAnalyser{nullptr},
+		m_stereoChannels{0, 0},
+		m_recorder{nullptr},
+		m_latencyStats{},
+		m_windowCaptureTime{},
+		m_frameRing{s_frameRingCapacity},
+		m_frameSequence{0},
+		m_frameConsumer{nullptr},
+		m_decibelFloor{-100.0f},
+		m_smoothingSettings{},
+		m_attackCoefficient{1.0f},
+		m_releaseCoefficient{1.0f},
+		m_peakFall{0.0f},
+		m_averageCoefficient{1.0f},
+		m_spectrumSmoothing{},
+		m_bandSmoothing{},
+		m_resetSpectrumSmoothing{true},
+		m_resetBandSmoothing{true},
+		m_displayPlane{SpectrumPlane::Raw}
 	{
 		fmt::print("AudioEngine()\n");
-		assert(m_samplingSettings.numChannels <= 2); // to match the Channel enum
 	}
 
 	~AudioEngine();
@@ -66,83 +172,318 @@ public:
 
 	bool isRecordingActive() const { return m_recordingActive; }
 
+	using FrameConsumer = std::function<void(const SpectrumFrame&)>;
+
+	// Offline analysis, instead of toggleRecording(): read the source to the end on the calling thread as fast as it
+	// goes, handing every frame to 'consume' as soon as it's complete rather than publishing it, so none are dropped.
+	// The frame is only valid during the call. Returns the number of frames analysed
+	uint64_t analyseOffline(const FrameConsumer& consume);
+
 	const SamplingSettings& getSamplingSettings() const { return m_samplingSettings; }
 
+	// The number of bins per channel in each frame's spectrum, the usable DFT bins or the constant-Q bins.
+	// Valid after init()
+	unsigned int getNumOutputBins() const { return m_numOutputBins; }
+
+	// Human readable position of a channel, e.g. "Front Left", or "Auxiliary 3" past the standard layouts.
+	// Valid after init()
+	std::string getChannelName(unsigned int channel) const;
+
+	// Whether the sample history's loops are compiled for this exact configuration, see SampleHistory::create
+	bool isHistorySpecialised() const { return m_history != nullptr && m_history->isSpecialised(); }
+
+	// Whether the DFT is running with its optimal plan yet, see SamplingSettings::upgradePlanInBackground
+	bool isDFTPlanOptimal() const { return m_fft != nullptr && m_fft->isOptimal(); }
+
 	// ImGui Helper Functions
 	void plotInputPCM(
-		const Channel& channel,
+		unsigned int channel,
 		const char* label,
 		const char* overlay,
 		const ImVec2& size
 	);
 
 	void plotDFT(
-		const Channel& channel,
+		unsigned int channel,
 		const char* label,
 		const char* overlay,
 		const ImVec2& size
 	);
 
 	void plotSpectrum(
-		const Channel& channel,
+		unsigned int channel,
 		const char* label,
 		const char* overlay,
 		const ImVec2& size
 	);
 
-	// Histogram display controls
+	// RMS and true peak of a channel
+	void showLevelMeters(unsigned int channel);
+
+	// Momentary and short-term loudness of all channels together
+	void showLoudness();
+
+	// Tempo, beat and onsets
+	void showRhythm();
+
+	// Correlation, width and per bin coherence of the stereo pair
+	void showStereo(const ImVec2& plotSize);
+
+	// Where the recorder is writing to, and how it's keeping up
+	void showRecorder();
+
+	// A row of percentiles per latency stage, and a button to start them again
+	void showLatency();
+
+	// Histogram display controls. Changing the bands only rebuilds the band matrix, which the recording thread
+	// picks up at its next DFT frame
 	void setSpectrumBucketCount(unsigned int bucketCount);
 
 	unsigned int getSpectrumBucketCount() const { return m_numSpectrumBuckets; }
 
-	void setHistogramSmoothing(float smoothing) { m_histogramSmoothing = smoothing; }
+	void setSpectrumBandScale(DSP::BandScale scale);
+
+	DSP::BandScale getSpectrumBandScale() const { return m_spectrumBandScale; }
+
+	// Use custom bands instead, 'edgesHz' holds getSpectrumBucketCount() + 1 ascending edges
+	void setSpectrumBandEdges(const std::vector<float>& edgesHz);
+
+	static constexpr unsigned int s_maxSpectrumBuckets = 100;
+
+	// Spectrum frames in the ring to the renderer, enough to cover a few render frames at high FFT rates
+	static constexpr size_t s_frameRingCapacity = 16;
+
+	// The spectrum and bands are calibrated to dBFS, so a full scale sinusoid peaks at about 0dB, and can be
+	// weighted by perceived loudness on top. Changing it rebuilds the band matrix, like the band settings
+	void setFrequencyWeighting(DSP::FrequencyWeighting weighting);
+
+	DSP::FrequencyWeighting getFrequencyWeighting() const { return m_frequencyWeighting; }
+
+	// Smoothing of the spectrum and bands across frames, picked up by the recording thread at its next frame
+	void setSmoothing(const SmoothingSettings& settings);
+
+	const SmoothingSettings& getSmoothing() const { return m_smoothingSettings; }
+
+	// Which plane of each frame the plots show, and the renderer should upload
+	void setDisplayPlane(SpectrumPlane plane) { m_displayPlane = plane; }
+
+	SpectrumPlane getDisplayPlane() const { return m_displayPlane; }
+
+	// Quietest level reported in the spectrum, anything below (including silence) is clamped to this
+	void setDecibelFloor(float floorDb) { m_decibelFloor = floorDb; }
+
+	float getDecibelFloor() const { return m_decibelFloor; }
+
+	// Borrow the oldest spectrum frame which hasn't been consumed yet, or nullptr if there's nothing new.
+	// The frame isn't copied, and stays valid (and untouched by the recording thread) until the next call.
+	// Only one thread may consume frames
+	const SpectrumFrame* acquireFrame() { return m_frameRing.acquire(); }
+
+	// Latency and overruns of the capture device, if the source is one
+	CaptureStats getCaptureStats() const { return m_source != nullptr ? m_source->getCaptureStats() : CaptureStats{}; }
+
+	// Threads sharing the analysis of each window, valid after init()
+	unsigned int getNumWorkerThreads() const { return m_threadPool != nullptr ? m_threadPool->getNumThreads() : 0; }
+
+	// The number of frames the recording thread had to drop because the consumer wasn't keeping up
+	uint64_t getDroppedFrameCount() const { return m_frameRing.getOverrunCount(); }
+
+	// Stream every read from the source and/or every published frame to 'path' whenever recording is active, see
+	// Recorder. Only while recording is stopped, after init(). Returns false if the file can't be written
+	bool openRecorder(const std::string& path, const Recorder::Settings& settings);
+
+	// Finish the file, also only while recording is stopped
+	void closeRecorder();
 
-	float getHistogramSmoothing() const { return m_histogramSmoothing; }
+	bool isRecorderOpen() const { return m_recorder != nullptr && m_recorder->isOpen(); }
 
-	// Access for OpenGL buffers
-	const std::vector<float>& getDFT(const Channel& channel) const;
+	// How long each frame takes to get from being captured to each stage, the renderer records the stages after
+	// publication. Only meaningful for sources which are paced in real time
+	LatencyStats& getLatencyStats() { return m_latencyStats; }
 
-	// returns a copy of the combined DFT, if it's ready
-	const std::optional<const std::vector<float>> requestDFT(/*const Channel& channel*/);
+	const LatencyStats& getLatencyStats() const { return m_latencyStats; }
 
 private:
 
+	// Recording thread, processes the blocks the capture thread reads
 	void startRecording();
 
-	// static std::vector<float> calculateBuckets(int numBuckets, float powerCurve);
+	// Capture thread, reads blocks from the source into m_blockRing until recording stops or the source runs dry
+	void captureBlocks();
+
+	// Wake whichever thread is waiting on m_blockRing, after it's changed
+	void signalBlockRing();
+
+	// Push one read's worth of interleaved samples into the channel histories, and analyse the window every time
+	// a hop boundary is crossed. 'captureTime' is when the block's last frame was captured
+	void processBlock(const char* block, std::chrono::steady_clock::time_point captureTime);
+
+	// Run the DFT on the latest numSamples frames of each channel's history, and publish the resulting frame
+	void analyseWindow();
+
+	// Read once per window, so every channel is treated the same even if the GUI changes something mid-frame
+	struct WindowParameters
+	{
+		float decibelFloor;
+		const float* binOffsets; // calibration and weighting, see m_binOffsets
+		DSP::SmoothingCoefficients smoothing;
+		bool resetSpectrumSmoothing;
+		bool resetBandSmoothing;
+	};
+
+	// One DFT group's share of analyseWindow(), run on the thread pool
+	void analyseGroup(unsigned int group, SpectrumFrame& frame, const WindowParameters& parameters);
+
+	// A channel's smoothing state, in m_spectrumSmoothing or m_bandSmoothing
+	DSP::SmoothingPlanes getSmoothingState(std::vector<float>& state, unsigned int channel, size_t planeSize);
+
+	// A channel's complex output bins once its group has been analysed, constant-Q coefficients or DFT bins
+	const float* getComplexOutput(unsigned int channel) const;
+
+	// A band matrix for the current band settings, with the weighting folded in
+	DSP::BandMatrix buildBandMatrix() const;
+
+	// Hand a new band matrix over to the recording thread
+	void submitBandMatrix(DSP::BandMatrix matrix);
 
 	const SamplingSettings m_samplingSettings;
 
-	// PulseAudio audio source connection
-	pa_simple* m_source;
+	// Where the samples come from, e.g. a PulseAudio device, a file, or a test signal
+	std::unique_ptr<AudioSource> m_source;
 
-	std::vector<char> m_sampleBuffer; // use char here, as 1 byte
+	// Blocks of framesPerRead interleaved frames, read by the capture thread while the recording thread processes
+	// the previous ones. The capture thread waits when it's full, so a source which isn't paced by hardware can't
+	// run away from the analysis, and capture devices buffer (and count) any overruns themselves
+	static constexpr size_t s_blockRingCapacity = 8;
+	struct CapturedBlock
+	{
+		std::vector<char> samples;
+
+		// When the newest frame was captured, the read's completion less the source's latency
+		std::chrono::steady_clock::time_point captureTime;
+	};
+	SPSCRing<CapturedBlock> m_blockRing;
+	std::mutex m_blockMutex;
+	std::condition_variable m_blockCondition;
+	std::atomic<bool> m_captureFinished;
+
+	// A copy of the block processed most recently, for plotInputPCM. The block itself goes back to the capture
+	// thread once it's processed, so it can't be read from the ring
+	std::mutex m_lastBlockMutex;
+	std::vector<char> m_lastBlock;
+
+	// How the samples in each block are converted to float, from SamplingSettings::sampleFormat
+	DSP::SampleFormat m_sampleFormat;
+
+	// The position of each channel, for display only
+	pa_channel_map m_channelMap;
 
-	bool m_recordingActive;
+	// Frames pushed into the histories since the last DFT window was analysed
+	unsigned int m_framesSinceHop;
+
+	// The last numSamples samples of every channel, specialised at compile time for the common configurations
+	std::unique_ptr<SampleHistory> m_history;
+
+	std::atomic<bool> m_recordingActive;
 	std::unique_ptr<std::thread> m_recordingThread;
+	std::unique_ptr<std::thread> m_captureThread;
+
+	// Fans the channels of each window out over the recording thread and its workers
+	std::unique_ptr<ThreadPool> m_threadPool;
 
 	int m_numSpectrumBuckets;
+	DSP::BandScale m_spectrumBandScale;
 
-	struct FFTData
-	{
-		Channel channelID;
-		// internal data for fftW
-		std::vector<double> fftwInput;
-		fftw_complex* fftwOutput;
-		fftw_plan fftwPlan;
-		// Processed output data
-
-		// bool dftOutputChanged;
-		std::vector<float> dftOutputRaw;
-		std::vector<float> spectrumBuckets;
-	};
+	// From setSpectrumBandEdges, empty when the bands are spaced on m_spectrumBandScale
+	std::vector<float> m_customBandEdges;
+
+	// Recording thread only, maps the DFT bins of each channel onto m_numSpectrumBuckets bands
+	std::unique_ptr<DSP::BandMatrix> m_bandMatrix;
+
+	// Rebuilt matrices wait here until the recording thread swaps them in. The recording thread only ever
+	// try_locks, so it never waits on the GUI. After the swap this holds the old matrix, which is freed by the
+	// next submission rather than on the recording thread
+	std::mutex m_pendingBandMatrixMutex;
+	std::unique_ptr<DSP::BandMatrix> m_pendingBandMatrix;
+	bool m_hasPendingBandMatrix;
+
+	// Scratch space for each channel's band powers, before they're converted to dB, [numChannels * max buckets]
+	std::vector<float> m_bandPower;
+
+	// Each channel's DFT bin powers from the last frame, for the spectral flux, [numChannels * numSamples / 2]
+	std::vector<float> m_descriptorPower;
+
+	// Single precision DFT of every channel, in one group per thread, owns the aligned input and output buffers for
+	// fftw
+	std::unique_ptr<DSP::FFTBatch> m_fft;
+
+	// Only in Analysis::ConstantQ, with scratch space for each channel's complex coefficients
+	std::unique_ptr<DSP::ConstantQKernel> m_constantQ;
+	std::vector<float> m_constantQOutput;
+
+	unsigned int m_numOutputBins;
+
+	// Calibration to dBFS plus each FrequencyWeighting, in dB per output bin for the dB kernel, and as power gains per
+	// DFT bin for the band matrix. Built in init(), read-only after
+	static constexpr size_t s_numWeightings = 3;
+	std::array<std::vector<float>, s_numWeightings> m_binOffsets;
+	std::array<std::vector<float>, s_numWeightings> m_dftBinGains;
+
+	// Set from the GUI thread, and the weighting the recording thread used last, to restart the smoothing on a change
+	std::atomic<DSP::FrequencyWeighting> m_frequencyWeighting;
+	DSP::FrequencyWeighting m_windowWeighting;
+
+	// One per channel, fed the samples which are new in each window
+	std::vector<DSP::LevelMeter> m_levelMeters;
+
+	// How much each channel counts towards the loudness, by position (BS.1770), e.g. none for the LFE channel
+	std::vector<float> m_loudnessWeights;
+
+	// Fed the raw bands of every channel each frame
+	std::unique_ptr<DSP::OnsetDetector> m_onsetDetector;
+	std::unique_ptr<DSP::TempoTracker> m_tempoTracker;
+
+	// Fed the complex output bins of the front left / right pair each frame, only with two or more channels
+	std::unique_ptr<DSP::StereoAnalyser> m_stereoAnalyser;
+	std::array<unsigned int, 2> m_stereoChannels;
+
+	// Written to by the capture and recording threads while they run, only opened or closed while they're stopped
+	std::unique_ptr<Recorder> m_recorder;
+
+	LatencyStats m_latencyStats;
+
+	// Recording thread only, when the newest frame in the window being analysed was captured
+	std::chrono::steady_clock::time_point m_windowCaptureTime;
+
+	// Spectrum frames published to the renderer
+	SPSCRing<SpectrumFrame> m_frameRing;
+
+	// Sequence number of the next frame to be produced
+	uint64_t m_frameSequence;
+
+	// Takes the frames instead of m_frameRing during analyseOffline()
+	const FrameConsumer* m_frameConsumer;
+
+	// dB, set from the GUI thread
+	std::atomic<float> m_decibelFloor;
+
+	// GUI thread copy, and the per frame coefficients derived from it for the recording thread. They're updated
+	// one at a time, which at worst mixes old and new settings for a frame
+	SmoothingSettings m_smoothingSettings;
+	std::atomic<float> m_attackCoefficient;
+	std::atomic<float> m_releaseCoefficient;
+	std::atomic<float> m_peakFall;
+	std::atomic<float> m_averageCoefficient;
 
-	std::vector<FFTData> m_fftData;
+	// Recording thread only, smoothed, peak and average planes for every channel [3 * numChannels * bins / bands]
+	std::vector<float> m_spectrumSmoothing;
+	std::vector<float> m_bandSmoothing;
 
-	std::vector<float> m_dftOutputCombined;
-	bool m_dftOutputReady;
+	// Start the smoothing from the next frame's values, rather than fading in from whatever came before
+	bool m_resetSpectrumSmoothing;
+	bool m_resetBandSmoothing;
 
-	float m_histogramSmoothing;
+	SpectrumPlane m_displayPlane;
 };
 
 }
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "DSP/Deinterleave.h"
+
+#include <pulse/sample.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+
+namespace gaz
+{
+
+// Timing and health of a capture device, so we can tell when we're falling behind
+struct CaptureStats
+{
+	// Capture latency reported by the server, from the samples being recorded to us reading them
+	float latencyMs = 0.0f;
+
+	// Time between the last two fragments delivered by the server, and the longest seen
+	float fragmentIntervalMs = 0.0f;
+	float maxFragmentIntervalMs = 0.0f;
+
+	uint64_t fragments = 0;
+
+	// Times the server's buffer overflowed because we didn't take samples from it quickly enough
+	uint64_t serverOverflows = 0;
+
+	// Frames thrown away because the recording thread didn't read them quickly enough
+	uint64_t droppedFrames = 0;
+};
+
+// Interface for anything which can feed interleaved PCM to the AudioEngine, so that capture is decoupled from
+// analysis. A source is opened once by AudioEngine::init, and then read from the recording thread
+class AudioSource
+{
+public:
+	virtual ~AudioSource() = default;
+
+	// Prepare the source to deliver samples in the given format, in reads of 'framesPerRead' frames.
+	// Returns false if the source couldn't be opened, or can't provide the requested format
+	virtual bool open(const pa_sample_spec& sampleSpec, unsigned int framesPerRead) = 0;
+
+	// Fill 'buffer' with 'size' bytes of interleaved samples, this may block (e.g. waiting on a capture device).
+	// Returns false on error, or once the source has run out of samples
+	virtual bool read(char* buffer, size_t size) = 0;
+
+	// Human readable name, for logging
+	virtual std::string getName() const = 0;
+
+	// Sources which aren't capture devices have nothing to report. May be called from any thread
+	virtual CaptureStats getCaptureStats() const { return {}; }
+
+	// How long before the last read() returned its newest sample was captured, as far as the device can tell, so
+	// the sample's capture time can be worked out. Only call from the thread that reads
+	virtual std::chrono::nanoseconds getReadLatency() const { return std::chrono::nanoseconds{0}; }
+
+	// Create a source from a command line style description, returns nullptr if it isn't recognised.
+	// Descriptions are '<type>[:<argument>][,<option>...]', where type is one of:
+	//  pulse[:<device>][,latency=<ms>] - PulseAudio capture, from the named device or the server's default
+	//  pulse-simple[:<device>]          - as above, with the blocking 'simple' API
+	//  file:<path>[,realtime][,loop]    - WAV or raw PCM file, read as fast as possible unless 'realtime'
+	//  synth:<signal>[,realtime][,duration=<seconds>] - generated test signal, see SyntheticAudioSource
+	static std::unique_ptr<AudioSource> create(const std::string& description);
+};
+
+// The DSP equivalent of a PulseAudio sample format, for the formats we can convert natively (little endian only)
+std::optional<DSP::SampleFormat> toDSPSampleFormat(pa_sample_format_t format);
+
+// Helper for sources which aren't paced by hardware, to throttle reads to real time when that's wanted
+class RealTimePacer
+{
+public:
+	RealTimePacer() :
+		m_started{false},
+		m_deadline{}
+	{
+	}
+
+	// Sleep until 'numFrames' frames worth of time has passed since the previous call
+	void wait(size_t numFrames, unsigned int sampleRate)
+	{
+		if (!m_started)
+		{
+			m_deadline = std::chrono::steady_clock::now();
+			m_started = true;
+		}
+
+		m_deadline += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			std::chrono::duration<double>(static_cast<double>(numFrames) / sampleRate)
+		);
+		std::this_thread::sleep_until(m_deadline);
+	}
+
+private:
+	bool m_started;
+	std::chrono::steady_clock::time_point m_deadline;
+};
+
+}
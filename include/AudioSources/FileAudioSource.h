@@ -0,0 +1,76 @@
+#pragma once
+
+#include "AudioSource.h"
+
+#include <cstdio>
+#include <optional>
+
+namespace gaz
+{
+
+// Reads PCM from a WAV file, or a headerless raw PCM file which is assumed to already be in the requested
+// format. By default the file is read as fast as the consumer allows, which is what we want for batch jobs and
+// perf tests, 'realTime' throttles it to the sample rate instead
+class FileAudioSource : public AudioSource
+{
+public:
+	FileAudioSource(const std::string& path, bool realTime, bool loop) :
+		m_path{path},
+		m_realTime{realTime},
+		m_loop{loop},
+		m_file{nullptr},
+		m_dataOffset{0},
+		m_dataSize{0},
+		m_dataRemaining{0},
+		m_sampleSpec{},
+		m_pacer{}
+	{
+	}
+
+	~FileAudioSource() override;
+
+	// Disable copy constructor and assignment operator, since we're managing a file handle, and it's
+	// not worth the hassle to share their ownership
+	FileAudioSource(const FileAudioSource&) = delete;
+	FileAudioSource& operator=(const FileAudioSource&) = delete;
+	// ...and move constructor, move assignment
+	FileAudioSource(FileAudioSource&&) = delete;
+	FileAudioSource& operator=(FileAudioSource&&) = delete;
+
+	bool open(const pa_sample_spec& sampleSpec, unsigned int framesPerRead) override;
+
+	bool read(char* buffer, size_t size) override;
+
+	std::string getName() const override;
+
+	// Read the sample format from a WAV file's header, so that the engine can be configured to match it.
+	// Returns nothing if the file isn't a WAV file we understand
+	static std::optional<pa_sample_spec> probe(const std::string& path);
+
+private:
+	struct WavInfo
+	{
+		pa_sample_spec sampleSpec;
+		long dataOffset; // bytes from the start of the file
+		size_t dataSize; // bytes
+	};
+
+	static std::optional<WavInfo> readWavHeader(std::FILE* file);
+
+	const std::string m_path;
+	const bool m_realTime;
+	const bool m_loop;
+
+	std::FILE* m_file;
+
+	// Location of the sample data in the file, and how much is left to read before the end (or the next loop)
+	long m_dataOffset;
+	size_t m_dataSize;
+	size_t m_dataRemaining;
+
+	pa_sample_spec m_sampleSpec;
+
+	RealTimePacer m_pacer;
+};
+
+}
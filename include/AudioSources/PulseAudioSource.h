@@ -0,0 +1,50 @@
+#pragma once
+
+#include "AudioSource.h"
+
+#include <pulse/simple.h>
+
+namespace gaz
+{
+
+// Blocking capture from a PulseAudio source (or sink monitor) using the 'simple' API
+class PulseAudioSource : public AudioSource
+{
+public:
+	// An empty device name uses the server's default source
+	explicit PulseAudioSource(const std::string& device) :
+		m_device{device},
+		m_stream{nullptr},
+		m_readLatency{0}
+	{
+	}
+
+	~PulseAudioSource() override;
+
+	// Disable copy constructor and assignment operator, since we're managing PulseAudio resources, and it's
+	// not worth the hassle to share their ownership
+	PulseAudioSource(const PulseAudioSource&) = delete;
+	PulseAudioSource& operator=(const PulseAudioSource&) = delete;
+	// ...and move constructor, move assignment
+	PulseAudioSource(PulseAudioSource&&) = delete;
+	PulseAudioSource& operator=(PulseAudioSource&&) = delete;
+
+	bool open(const pa_sample_spec& sampleSpec, unsigned int framesPerRead) override;
+
+	bool read(char* buffer, size_t size) override;
+
+	std::string getName() const override;
+
+	std::chrono::nanoseconds getReadLatency() const override { return m_readLatency; }
+
+private:
+	const std::string m_device;
+
+	// PulseAudio audio source connection
+	pa_simple* m_stream;
+
+	// The server's latency as of the last read
+	std::chrono::nanoseconds m_readLatency;
+};
+
+}
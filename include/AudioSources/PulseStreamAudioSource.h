@@ -0,0 +1,114 @@
+#pragma once
+
+#include "AudioSource.h"
+
+#include <pulse/pulseaudio.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+namespace gaz
+{
+
+// Asynchronous capture from a PulseAudio source (or sink monitor), with a record stream on PulseAudio's threaded
+// mainloop. The server delivers fragments of about 'latencyMs' to a read callback on the mainloop thread, which
+// copies them into a FIFO that read() drains, so the recording thread never blocks inside PulseAudio.
+// Fragment timing, latency and overflows are tracked, see getCaptureStats()
+class PulseStreamAudioSource : public AudioSource
+{
+public:
+	// An empty device name uses the server's default source
+	PulseStreamAudioSource(const std::string& device, float latencyMs) :
+		m_device{device},
+		m_latencyMs{latencyMs},
+		m_sampleSpec{},
+		m_mainloop{nullptr},
+		m_context{nullptr},
+		m_stream{nullptr},
+		m_fifoMutex{},
+		m_fifoCondition{},
+		m_fifo{},
+		m_fifoReadIndex{0},
+		m_fifoSize{0},
+		m_failed{false},
+		m_lastFragmentTime{},
+		m_latencyUs{0},
+		m_fragmentIntervalUs{0},
+		m_maxFragmentIntervalUs{0},
+		m_fragments{0},
+		m_serverOverflows{0},
+		m_droppedFrames{0},
+		m_readLatency{0}
+	{
+	}
+
+	~PulseStreamAudioSource() override;
+
+	// Disable copy constructor and assignment operator, since we're managing PulseAudio resources, and it's
+	// not worth the hassle to share their ownership
+	PulseStreamAudioSource(const PulseStreamAudioSource&) = delete;
+	PulseStreamAudioSource& operator=(const PulseStreamAudioSource&) = delete;
+	// ...and move constructor, move assignment
+	PulseStreamAudioSource(PulseStreamAudioSource&&) = delete;
+	PulseStreamAudioSource& operator=(PulseStreamAudioSource&&) = delete;
+
+	bool open(const pa_sample_spec& sampleSpec, unsigned int framesPerRead) override;
+
+	bool read(char* buffer, size_t size) override;
+
+	std::string getName() const override;
+
+	CaptureStats getCaptureStats() const override;
+
+	std::chrono::nanoseconds getReadLatency() const override { return m_readLatency; }
+
+private:
+	// Tear down the stream, context and mainloop, safe to call on a partially opened source
+	void close();
+
+	// Mainloop thread callbacks
+	static void onContextState(pa_context* context, void* userData);
+	static void onStreamState(pa_stream* stream, void* userData);
+	static void onStreamRead(pa_stream* stream, size_t numBytes, void* userData);
+	static void onStreamOverflow(pa_stream* stream, void* userData);
+
+	// Append to the FIFO, dropping whatever doesn't fit. A null 'data' is a hole in the stream, filled with silence
+	void pushToFifo(const char* data, size_t size);
+
+	void fail();
+
+	const std::string m_device;
+	const float m_latencyMs;
+
+	pa_sample_spec m_sampleSpec;
+
+	pa_threaded_mainloop* m_mainloop;
+	pa_context* m_context;
+	pa_stream* m_stream;
+
+	// Captured bytes waiting for read(), a ring buffer written by the mainloop thread
+	std::mutex m_fifoMutex;
+	std::condition_variable m_fifoCondition;
+	std::vector<char> m_fifo;
+	size_t m_fifoReadIndex;
+	size_t m_fifoSize;
+
+	// Set when the stream or context dies, wakes up read()
+	std::atomic<bool> m_failed;
+
+	// Stats, written on the mainloop thread
+	std::chrono::steady_clock::time_point m_lastFragmentTime;
+	std::atomic<uint64_t> m_latencyUs;
+	std::atomic<uint64_t> m_fragmentIntervalUs;
+	std::atomic<uint64_t> m_maxFragmentIntervalUs;
+	std::atomic<uint64_t> m_fragments;
+	std::atomic<uint64_t> m_serverOverflows;
+	std::atomic<uint64_t> m_droppedFrames;
+
+	// Read thread only, the stream's latency as of the last read
+	std::chrono::nanoseconds m_readLatency;
+};
+
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "AudioSource.h"
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace gaz
+{
+
+// Generates a deterministic test signal, the sum of any number of sines, exponential sweeps and white noise.
+// Tones are identical on every channel, noise is independent per channel. Any format supported by toDSPSampleFormat()
+// can be generated
+class SyntheticAudioSource : public AudioSource
+{
+public:
+	struct Component
+	{
+		enum struct Type
+		{
+			Sine,
+			Sweep,
+			Noise
+		};
+
+		Type type;
+		float amplitude; // linear, 1.0 is full scale
+		float frequency; // Hz, sine frequency or sweep start
+		float frequencyEnd; // Hz, sweep end
+		float period; // seconds, how long a sweep takes before it restarts
+	};
+
+	// 'duration' limits the length of the signal in seconds, otherwise it never runs out
+	SyntheticAudioSource(
+		const std::vector<Component>& components,
+		bool realTime,
+		std::optional<float> duration
+	);
+
+	bool open(const pa_sample_spec& sampleSpec, unsigned int framesPerRead) override;
+
+	bool read(char* buffer, size_t size) override;
+
+	std::string getName() const override;
+
+	// Parse a signal description, a '+' separated list of components:
+	//  sine@<hz>[*<amplitude>]
+	//  sweep@<start hz>-<end hz>[/<seconds>][*<amplitude>]
+	//  noise[*<amplitude>]
+	// e.g. "sine@440*0.5+sweep@20-20000/10*0.25+noise*0.05"
+	static std::optional<std::vector<Component>> parseSignal(const std::string& description);
+
+private:
+	const std::vector<Component> m_components;
+	const bool m_realTime;
+	const std::optional<float> m_duration;
+
+	pa_sample_spec m_sampleSpec;
+	DSP::SampleFormat m_sampleFormat;
+
+	// Interleaved float samples for one read, before conversion to the sample format
+	std::vector<float> m_output;
+
+	// Number of frames generated so far
+	uint64_t m_frameIndex;
+	std::optional<uint64_t> m_frameLimit;
+
+	// Oscillator phase of each component, in cycles [0, 1)
+	std::vector<double> m_phases;
+
+	// Noise generator state, per channel
+	std::vector<uint32_t> m_noiseState;
+
+	RealTimePacer m_pacer;
+};
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Grouping of DFT bins into frequency bands (e.g. for a spectrum histogram), as a precomputed sparse weight
+// matrix. Each band covers one contiguous span of bins, weighted by how much of each bin lies inside the band,
+// so bands narrower than a bin (common at low frequencies) still get a sensible share of it.
+// Building the matrix does all of the frequency maths, applying it is one sparse matrix-vector product
+
+namespace DSP
+{
+enum struct BandScale
+{
+	Log, // equal width in log frequency, i.e. octaves
+	Mel, // O'Shaughnessy mel scale
+	Bark // Traunmüller's Bark approximation
+};
+
+const char* toString(BandScale scale);
+
+class BandMatrix
+{
+public:
+	// 'numBands' bands spaced evenly on 'scale' between minHz and maxHz, for a DFT of 'fftSize' samples
+	static BandMatrix fromScale(
+		BandScale scale,
+		unsigned int numBands,
+		float minHz,
+		float maxHz,
+		unsigned int sampleRate,
+		unsigned int fftSize
+	);
+
+	// Arbitrary bands, 'edgesHz' holds numBands + 1 ascending edges
+	static BandMatrix fromEdges(const std::vector<float>& edgesHz, unsigned int sampleRate, unsigned int fftSize);
+
+	unsigned int getNumBands() const { return static_cast<unsigned int>(m_bands.size()); }
+
+	// Multiply each bin's contribution by binGains[bin], e.g. a frequency weighting as power gains, so it's applied
+	// for free along with the band weights. 'binGains' holds fftSize / 2 values
+	void scaleBins(const std::vector<float>& binGains);
+
+	// out[band] = mean power of the bins in the band, from 'complexIn' interleaved (re, im) pairs such as
+	// fftwf_complex, at least fftSize / 2 of them. 'out' holds getNumBands() values
+	void apply(const float* complexIn, float* out) const;
+
+private:
+	struct Band
+	{
+		unsigned int firstBin;
+		unsigned int numBins;
+		size_t weightOffset; // into m_weights, numBins weights
+	};
+
+	BandMatrix() = default;
+
+	std::vector<Band> m_bands;
+
+	// Every band's weights, back to back
+	std::vector<float> m_weights;
+};
+
+} // namespace DSP
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Constant-Q transform, with log spaced bins that each span the same fraction of an octave, computed from one
+// ordinary DFT with a precomputed sparse spectral kernel (Brown & Puckette, 1992). Each CQ bin's temporal kernel is
+// a windowed complex sinusoid, whose DFT is concentrated around its centre frequency, so only a short contiguous
+// span of DFT bins contributes to each CQ bin.
+// The longest kernel (the lowest bin) has to fit in the DFT, so the DFT size sets the lowest usable frequency
+
+namespace DSP
+{
+class ConstantQKernel
+{
+public:
+	// Bins from minHz up to maxHz (or the nyquist frequency), 'binsPerOctave' per octave, for a DFT of 'fftSize'
+	// samples. minHz is raised, in whole bins, if the DFT is too short for it. The kernels are made with an estimated
+	// fftw plan, so this waits for fftw's planner, e.g. behind an FFTBatch's background upgrade
+	ConstantQKernel(
+		unsigned int sampleRate,
+		unsigned int fftSize,
+		float minHz,
+		float maxHz,
+		unsigned int binsPerOctave
+	);
+
+	unsigned int getNumBins() const { return static_cast<unsigned int>(m_bins.size()); }
+
+	// Centre frequency of the lowest bin, after any adjustment for the DFT size
+	float getMinFrequency() const { return m_minFrequency; }
+
+	float getBinFrequency(unsigned int bin) const;
+
+	// out[bin] = the (re, im) CQ coefficient of each bin, from 'complexIn' (re, im) DFT output such as
+	// fftwf_complex, at least fftSize / 2 of them. 'out' holds 2 * getNumBins() floats, so it can go straight to
+	// powerToDecibels. Scaled so a sinusoid has roughly the same level as in a Hann windowed DFT of fftSize
+	void apply(const float* complexIn, float* out) const;
+
+private:
+	struct Bin
+	{
+		unsigned int firstBin;
+		unsigned int numBins;
+		size_t weightOffset; // floats into m_weights, numBins complex weights follow
+	};
+
+	const unsigned int m_binsPerOctave;
+
+	float m_minFrequency;
+
+	std::vector<Bin> m_bins;
+
+	// Every bin's conjugated spectral kernel, interleaved (re, im), back to back
+	std::vector<float> m_weights;
+};
+
+} // namespace DSP
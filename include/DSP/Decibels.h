@@ -0,0 +1,27 @@
+#pragma once
+
+#include "DSP/SIMD.h"
+
+#include <cstddef>
+
+// Conversion of DFT output to decibels, the hottest loop after the DFT itself
+
+namespace DSP
+{
+// out[i] = max(10 * log10(re² + im²) + offsetsDb[i], floorDb), for 'count' interleaved (re, im) pairs such as
+// fftwf_complex. The offsets are a per bin gain, e.g. calibration and frequency weighting, for one more (fused)
+// add per bin, or nullptr for none.
+// Uses a polynomial log2 approximation, within 1e-4 dB of std::log10 for anything above the floor.
+// Dispatches to the widest SIMD path the CPU supports
+void powerToDecibels(const float* complexIn, size_t count, float floorDb, const float* offsetsDb, float* out);
+
+// As above, but with an explicit SIMD level, for comparing paths. Falls back to the widest supported level if
+// the CPU doesn't support 'level'
+void powerToDecibels(
+	SIMDLevel level, const float* complexIn, size_t count, float floorDb, const float* offsetsDb, float* out);
+
+// out[i] = max(10 * log10(power[i]), floorDb), for values that are already powers, such as band totals. Scalar,
+// with the same approximation as above, it's meant for short arrays
+void powerToDecibelsReal(const float* power, size_t count, float floorDb, float* out);
+
+} // namespace DSP
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+
+// Helpers for splitting interleaved PCM into the planar per-channel buffers used by the DFT, converting integer
+// samples to float on the way, so the capture buffer is only walked once
+
+namespace DSP
+{
+// Little endian PCM sample formats which can be converted natively
+enum struct SampleFormat
+{
+	Float32, // IEEE float, [-1, 1]
+	S16,     // 16 bit signed
+	S24,     // 24 bit signed, packed into 3 bytes
+	S24In32, // 24 bit signed, in the low 3 bytes of 4
+	S32      // 32 bit signed
+};
+
+constexpr size_t bytesPerSample(SampleFormat format)
+{
+	switch(format)
+	{
+	case SampleFormat::S16:
+		return 2;
+	case SampleFormat::S24:
+		return 3;
+	case SampleFormat::Float32:
+	case SampleFormat::S24In32:
+	case SampleFormat::S32:
+	default:
+		return 4;
+	}
+}
+
+// Copy 'numFrames' frames of interleaved samples into one buffer per channel, converted to float in [-1, 1), so that
+// out[channel][i] = in[i * numChannels + channel]. Mono and stereo are fully vectorized, other channel counts only
+// vectorize the conversion
+void deinterleave(const void* in, SampleFormat format, unsigned int numChannels, size_t numFrames, float* const* out);
+
+// The reverse of the conversion, 'count' floats to samples of 'format', clipping anything outside [-1, 1)
+void encodeSamples(const float* in, SampleFormat format, size_t count, void* out);
+
+} // namespace DSP
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "DSP/SIMD.h"
+
+#include <cstddef>
+
+// Per frame summaries of the shape of a spectrum, a handful of numbers which can drive visuals without reading
+// every bin. All of them are ratios, so they don't depend on the spectrum's scale or calibration
+
+namespace DSP
+{
+struct SpectralDescriptors
+{
+	float centroid = 0.0f; // Hz, the power weighted mean frequency, the "brightness"
+	float bandwidth = 0.0f; // Hz, the power weighted standard deviation of frequency around the centroid
+	float rolloff = 0.0f; // Hz, below which s_rolloffFraction of the power lies
+	float flatness = 0.0f; // geometric over arithmetic mean power, ~0.56 for a frame of white noise, ~0 for a tone
+	float crest = 0.0f; // dB, the loudest bin's power over the mean
+	float flux = 0.0f; // [0, 1], the fraction of the power which is new since the last frame, Σmax(p - p', 0) / Σp
+};
+
+constexpr float s_rolloffFraction = 0.85f;
+
+// One fused pass over 'count' interleaved (re, im) DFT bins, 'hzPerBin' apart from 0Hz. 'power' holds the power of
+// each bin from the previous frame, for the flux, and is overwritten with this frame's. Silence gives all zeros.
+// Dispatches to the widest SIMD path the CPU supports
+SpectralDescriptors spectralDescriptors(const float* complexIn, size_t count, float hzPerBin, float* power);
+
+// As above, but with an explicit SIMD level, for comparing paths
+SpectralDescriptors spectralDescriptors(
+	SIMDLevel level, const float* complexIn, size_t count, float hzPerBin, float* power);
+
+} // namespace DSP
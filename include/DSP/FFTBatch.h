@@ -0,0 +1,137 @@
+#pragma once
+
+#include <fftw3.h>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+// Single precision real-to-complex DFTs of several equally sized channels, run as one batched fftwf plan.
+// Each channel's input and output is planar and starts on a SIMD-aligned boundary, so fftw can use its widest
+// codelets, and the buffers are owned here so the plan's references stay valid.
+// Plans are loaded from, and saved to, the wisdom cache (see FFTWisdom.h) so patient planning only happens once.
+// The channels can be split into groups, which share one plan and can be executed concurrently, e.g. one per worker
+// thread. The last group is padded with spare channels if they don't divide evenly, and there may be fewer groups
+// than asked for, if that's what it takes for every group to hold at least one real channel
+
+namespace DSP
+{
+class FFTBatch
+{
+public:
+	enum struct Planning
+	{
+		// Block until an FFTW_PATIENT plan is ready
+		Patient,
+		// Start with an FFTW_ESTIMATE plan, and swap to an FFTW_PATIENT plan once startUpgrade() has made it on a
+		// background thread. Both are instant if the patient plan is already in the wisdom cache
+		Upgrade,
+		// Block for an FFTW_MEASURE plan, unless the patient plan is cached. Seconds rather than minutes, for tools
+		// which plan many sizes, and it isn't saved, so the cache only ever holds patient plans
+		Measure
+	};
+
+	FFTBatch(unsigned int size, unsigned int numChannels, Planning planning, unsigned int numGroups = 1);
+
+	// Doesn't wait for background planning, an unfinished upgrade is abandoned, and finishes on its own
+	~FFTBatch();
+
+	// Disable copy constructor and assignment operator, since we're managing fftw resources, and it's
+	// not worth the hassle to share their ownership
+	FFTBatch(const FFTBatch&) = delete;
+	FFTBatch& operator=(const FFTBatch&) = delete;
+	// ...and move constructor, move assignment
+	FFTBatch(FFTBatch&&) = delete;
+	FFTBatch& operator=(FFTBatch&&) = delete;
+
+	bool isValid() const { return m_initialPlan != nullptr; }
+
+	// Whether we're running the patient plan yet
+	bool isOptimal() const { return m_isOptimal.load(std::memory_order_relaxed); }
+
+	// Start making the patient plan in the background, if we're waiting to upgrade. fftw's planner is held for the
+	// whole of patient planning, so anything else that plans stalls until it's done: call this once everything
+	// else has been planned
+	void startUpgrade();
+
+	// Run the DFT on every channel, this destroys the contents of the input buffers
+	void execute() const
+	{
+		for(unsigned int group = 0; group < m_numGroups; ++group)
+		{
+			execute(group);
+		}
+	}
+
+	// Run the DFT on one group's channels, different groups may be executed from different threads at once
+	void execute(unsigned int group) const
+	{
+		// The upgraded plan was made on scratch buffers with the same layout and alignment, and every group has
+		// the same layout too, so it can be applied to any of them with the new-array execute
+		const size_t firstChannel = group * m_channelsPerGroup;
+		fftwf_execute_dft_r2c(
+			m_activePlan.load(std::memory_order_acquire),
+			m_input + firstChannel * m_inputStride,
+			m_output + firstChannel * m_outputStride);
+	}
+
+	// Aligned input buffer for a channel, 'size' samples long
+	float* getInput(unsigned int channel) const
+	{
+		return m_input + channel * m_inputStride;
+	}
+
+	// Aligned output buffer for a channel, getNumBins() bins long
+	const fftwf_complex* getOutput(unsigned int channel) const
+	{
+		return m_output + channel * m_outputStride;
+	}
+
+	unsigned int getSize() const { return m_size; }
+
+	unsigned int getNumChannels() const { return m_numChannels; }
+
+	unsigned int getNumGroups() const { return m_numGroups; }
+
+	// Group 'group' holds channels [group * getChannelsPerGroup(), (group + 1) * getChannelsPerGroup()), less any
+	// padding at the end
+	unsigned int getChannelsPerGroup() const { return m_channelsPerGroup; }
+
+	// size / 2 + 1, the last bin being the nyquist frequency
+	unsigned int getNumBins() const { return m_size / 2 + 1; }
+
+private:
+	// What the upgrade thread needs, shared with it so it can outlive the batch
+	struct Upgrade;
+
+	// Plan with the given flags on the given buffers, which must have our layout. Takes the planner lock
+	fftwf_plan makePlan(float* input, fftwf_complex* output, unsigned int flags) const;
+
+	// Background thread, makes the patient plan on scratch buffers and then swaps it in, unless the batch has gone
+	static void upgradePlan(std::shared_ptr<Upgrade> upgrade);
+
+	const unsigned int m_size;
+	const unsigned int m_numChannels;
+	const unsigned int m_numGroups;
+	const unsigned int m_channelsPerGroup;
+
+	// Distance between the start of each channel, in elements, padded to keep each channel aligned
+	const size_t m_inputStride;
+	const size_t m_outputStride;
+
+	float* m_input;
+	fftwf_complex* m_output;
+
+	// The plan we started with, and the patient plan that replaces it if we're upgrading
+	fftwf_plan m_initialPlan;
+	fftwf_plan m_upgradedPlan;
+
+	// Whichever of the above execute() should use
+	std::atomic<fftwf_plan> m_activePlan;
+	std::atomic<bool> m_isOptimal;
+
+	// Set if we're waiting to upgrade, or upgrading
+	std::shared_ptr<Upgrade> m_upgrade;
+};
+
+} // namespace DSP
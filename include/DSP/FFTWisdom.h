@@ -0,0 +1,25 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+
+// Persistent fftwf wisdom, so that expensive FFTW_PATIENT planning only has to happen once per machine.
+// Wisdom is cached in one file per DFT configuration, under $XDG_CACHE_HOME/gaz (or ~/.cache/gaz)
+
+namespace DSP
+{
+// fftw's planner isn't thread safe, so anything that creates or destroys plans, or touches wisdom, has to
+// hold this. Executing plans doesn't need it
+std::mutex& fftwPlannerMutex();
+
+// Cache file for a single precision DFT of the given size and channel count, on this CPU.
+// Returns an empty string if there's nowhere to put it
+std::string wisdomCachePath(unsigned int size, unsigned int numChannels);
+
+// Merge the wisdom in 'path' into fftw's, returns false if there wasn't any. Caller holds fftwPlannerMutex
+bool loadWisdom(const std::string& path);
+
+// Write all of fftw's accumulated wisdom to 'path'. Caller holds fftwPlannerMutex
+bool saveWisdom(const std::string& path);
+
+} // namespace DSP
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// Polynomial log2 for the DSP kernels, one version per SIMD path. Each splits x into its exponent and a mantissa in
+// [1, 2), then approximates log2 of the mantissa. x must be positive and normal
+
+namespace DSP
+{
+namespace FastLog
+{
+// log2(1 + t) ~= t * (c0 + c1 t + c2 t² + c3 t³ + c4 t⁴) for t in [0, 1), least squares fit, max error 1.7e-5
+constexpr float c0 = 1.44187987f;
+constexpr float c1 = -0.708865225f;
+constexpr float c2 = 0.415245563f;
+constexpr float c3 = -0.193516523f;
+constexpr float c4 = 0.0452682935f;
+
+inline float log2(float x)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &x, sizeof(bits));
+	const float exponent = static_cast<float>(static_cast<int>(bits >> 23) - 127);
+	bits = (bits & 0x007FFFFFu) | 0x3F800000u;
+	float mantissa;
+	std::memcpy(&mantissa, &bits, sizeof(mantissa));
+	const float t = mantissa - 1.0f;
+	return exponent + t * (c0 + t * (c1 + t * (c2 + t * (c3 + t * c4))));
+}
+
+#if defined(__x86_64__)
+inline __m128 log2SSE2(__m128 x)
+{
+	const __m128i bits = _mm_castps_si128(x);
+	const __m128 exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+	const __m128 t = _mm_sub_ps(
+		_mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000))),
+		_mm_set1_ps(1.0f));
+
+	__m128 poly = _mm_add_ps(_mm_mul_ps(t, _mm_set1_ps(c4)), _mm_set1_ps(c3));
+	poly = _mm_add_ps(_mm_mul_ps(t, poly), _mm_set1_ps(c2));
+	poly = _mm_add_ps(_mm_mul_ps(t, poly), _mm_set1_ps(c1));
+	poly = _mm_add_ps(_mm_mul_ps(t, poly), _mm_set1_ps(c0));
+	return _mm_add_ps(exponent, _mm_mul_ps(t, poly));
+}
+
+__attribute__((target("avx2,fma"))) inline __m256 log2AVX2(__m256 x)
+{
+	const __m256i bits = _mm256_castps_si256(x);
+	const __m256 exponent =
+		_mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+	const __m256 t = _mm256_sub_ps(
+		_mm256_castsi256_ps(
+			_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)), _mm256_set1_epi32(0x3F800000))),
+		_mm256_set1_ps(1.0f));
+
+	__m256 poly = _mm256_fmadd_ps(t, _mm256_set1_ps(c4), _mm256_set1_ps(c3));
+	poly = _mm256_fmadd_ps(t, poly, _mm256_set1_ps(c2));
+	poly = _mm256_fmadd_ps(t, poly, _mm256_set1_ps(c1));
+	poly = _mm256_fmadd_ps(t, poly, _mm256_set1_ps(c0));
+	return _mm256_fmadd_ps(t, poly, exponent);
+}
+
+__attribute__((target("avx512f"))) inline __m512 log2AVX512(__m512 x)
+{
+	const __m512i bits = _mm512_castps_si512(x);
+	const __m512 exponent =
+		_mm512_cvtepi32_ps(_mm512_sub_epi32(_mm512_srli_epi32(bits, 23), _mm512_set1_epi32(127)));
+	const __m512 t = _mm512_sub_ps(
+		_mm512_castsi512_ps(
+			_mm512_or_si512(_mm512_and_si512(bits, _mm512_set1_epi32(0x007FFFFF)), _mm512_set1_epi32(0x3F800000))),
+		_mm512_set1_ps(1.0f));
+
+	__m512 poly = _mm512_fmadd_ps(t, _mm512_set1_ps(c4), _mm512_set1_ps(c3));
+	poly = _mm512_fmadd_ps(t, poly, _mm512_set1_ps(c2));
+	poly = _mm512_fmadd_ps(t, poly, _mm512_set1_ps(c1));
+	poly = _mm512_fmadd_ps(t, poly, _mm512_set1_ps(c0));
+	return _mm512_fmadd_ps(t, poly, exponent);
+}
+#endif
+
+} // namespace FastLog
+} // namespace DSP
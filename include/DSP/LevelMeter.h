@@ -0,0 +1,104 @@
+#pragma once
+
+#include "DSP/Weighting.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <vector>
+
+// Streaming level meters for one channel, fed the samples block by block: K-weighted mean square for ITU-R BS.1770
+// loudness (momentary and short-term), RMS, and true peak. Each block updates running sums, so a reading costs the
+// same however long the window is
+
+namespace DSP
+{
+class LevelMeter
+{
+public:
+	static constexpr float s_momentarySeconds = 0.4f;
+	static constexpr float s_shortTermSeconds = 3.0f;
+
+	// Every block holds 'blockSize' samples, the windows are rounded to whole blocks
+	LevelMeter(unsigned int sampleRate, unsigned int blockSize);
+
+	// Add the next block of samples
+	void process(const float* samples);
+
+	// Back to a history of silence
+	void reset();
+
+	// K-weighted mean square over the momentary and short-term windows, see loudness()
+	double getMomentaryPower() const { return m_momentary.getMean(); }
+	double getShortTermPower() const { return m_shortTerm.getMean(); }
+
+	// Unweighted mean square over the momentary window
+	double getMeanSquare() const { return m_rms.getMean(); }
+
+	// Largest absolute value of the signal in the last block, between the samples as well as at them (4x oversampled,
+	// BS.1770 Annex 2)
+	float getTruePeak() const { return m_truePeak; }
+
+private:
+	// Sum of squares over the last 'numBlocks' blocks, as a ring of per block sums
+	class Window
+	{
+	public:
+		Window(unsigned int numBlocks, unsigned int blockSize);
+
+		void push(double blockSum);
+
+		void reset();
+
+		double getMean() const { return std::max(m_sum, 0.0) / m_numSamples; }
+
+	private:
+		std::vector<double> m_blockSums;
+		size_t m_next;
+		double m_sum;
+		double m_numSamples;
+	};
+
+	// Direct form II transposed, in double since the K-weighting high pass sits very close to DC
+	struct BiquadState
+	{
+		double z1 = 0.0;
+		double z2 = 0.0;
+
+		double process(const Biquad& filter, double x)
+		{
+			const double y = filter.b0 * x + z1;
+			z1 = filter.b1 * x - filter.a1 * y + z2;
+			z2 = filter.b2 * x - filter.a2 * y;
+			return y;
+		}
+	};
+
+	// 4 phase polyphase interpolator, 12 taps per phase
+	static constexpr unsigned int s_oversampling = 4;
+	static constexpr unsigned int s_tapsPerPhase = 12;
+
+	const unsigned int m_blockSize;
+
+	const KWeightingFilter m_filter;
+	BiquadState m_shelfState;
+	BiquadState m_highPassState;
+
+	Window m_momentary;
+	Window m_shortTerm;
+	Window m_rms;
+
+	// [phase][tap], taps in reverse so they line up with the oldest sample first
+	std::array<std::array<float, s_tapsPerPhase>, s_oversampling> m_interpolator;
+
+	// The last s_tapsPerPhase samples, written twice so any run of them is contiguous
+	std::array<float, 2 * s_tapsPerPhase> m_recent;
+	unsigned int m_recentIndex;
+
+	float m_truePeak;
+};
+
+// Loudness in LUFS, from the sum of every channel's K-weighted mean square, times its channel weight
+float loudness(double weightedPowerSum);
+
+} // namespace DSP
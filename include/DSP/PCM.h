@@ -0,0 +1,266 @@
+#pragma once
+
+#include "DSP/Deinterleave.h"
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// PCM conversion kernels behind DSP::deinterleave, in a header so they can also be instantiated for a fixed channel
+// count and sample format (see FixedSampleHistory)
+
+namespace DSP
+{
+namespace PCM
+{
+// Each format knows how to convert one sample, and with SSE2, 4 consecutive samples. Vector loads may read
+// 'overread' bytes past the 4 samples they convert, callers keep them inside the input
+struct Float32
+{
+	static constexpr size_t bytes = 4;
+
+	static float load(const char* p)
+	{
+		float value;
+		std::memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+#ifdef __SSE2__
+	static constexpr size_t overread = 0;
+
+	static __m128 load4(const char* p)
+	{
+		return _mm_loadu_ps(reinterpret_cast<const float*>(p));
+	}
+#endif
+};
+
+struct S16
+{
+	static constexpr size_t bytes = 2;
+	static constexpr float scale = 1.0f / 32768.0f;
+
+	static float load(const char* p)
+	{
+		int16_t value;
+		std::memcpy(&value, p, sizeof(value));
+		return value * scale;
+	}
+
+#ifdef __SSE2__
+	static constexpr size_t overread = 0;
+
+	static __m128 load4(const char* p)
+	{
+		// Widen by moving each sample into the top half of a 32 bit lane, then shifting it back down with sign
+		const __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+		const __m128i wide = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		return _mm_mul_ps(_mm_cvtepi32_ps(wide), _mm_set1_ps(scale));
+	}
+#endif
+};
+
+struct S24
+{
+	static constexpr size_t bytes = 3;
+	static constexpr float scale = 1.0f / 8388608.0f;
+
+	static float load(const char* p)
+	{
+		const auto* u = reinterpret_cast<const unsigned char*>(p);
+		const uint32_t value = u[0] | (u[1] << 8) | (static_cast<uint32_t>(u[2]) << 16);
+		return (static_cast<int32_t>(value << 8) >> 8) * scale;
+	}
+
+#ifdef __SSE2__
+	static constexpr size_t overread = 4;
+
+	static __m128 load4(const char* p)
+	{
+		// Samples start every 3 bytes, so shift each one down to the bottom of the register and gather the low
+		// lanes, then sign extend from 24 bits
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		const __m128i s01 = _mm_unpacklo_epi32(v, _mm_srli_si128(v, 3));
+		const __m128i s23 = _mm_unpacklo_epi32(_mm_srli_si128(v, 6), _mm_srli_si128(v, 9));
+		const __m128i gathered = _mm_unpacklo_epi64(s01, s23);
+		const __m128i wide = _mm_srai_epi32(_mm_slli_epi32(gathered, 8), 8);
+		return _mm_mul_ps(_mm_cvtepi32_ps(wide), _mm_set1_ps(scale));
+	}
+#endif
+};
+
+struct S24In32
+{
+	static constexpr size_t bytes = 4;
+	static constexpr float scale = 1.0f / 8388608.0f;
+
+	static float load(const char* p)
+	{
+		uint32_t value;
+		std::memcpy(&value, p, sizeof(value));
+		return (static_cast<int32_t>(value << 8) >> 8) * scale;
+	}
+
+#ifdef __SSE2__
+	static constexpr size_t overread = 0;
+
+	static __m128 load4(const char* p)
+	{
+		// Ignore whatever is in the padding byte
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		const __m128i wide = _mm_srai_epi32(_mm_slli_epi32(v, 8), 8);
+		return _mm_mul_ps(_mm_cvtepi32_ps(wide), _mm_set1_ps(scale));
+	}
+#endif
+};
+
+struct S32
+{
+	static constexpr size_t bytes = 4;
+	static constexpr float scale = 1.0f / 2147483648.0f;
+
+	static float load(const char* p)
+	{
+		int32_t value;
+		std::memcpy(&value, p, sizeof(value));
+		return value * scale;
+	}
+
+#ifdef __SSE2__
+	static constexpr size_t overread = 0;
+
+	static __m128 load4(const char* p)
+	{
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		return _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(scale));
+	}
+#endif
+};
+
+// Convert and deinterleave with 'Format'. With a non-zero FixedChannels, 'numChannels' is ignored and the channel
+// count is a compile time constant, so the channel loops can be unrolled
+template <typename Format, unsigned int FixedChannels = 0>
+void deinterleave(const char* in, unsigned int numChannels, size_t numFrames, float* const* out)
+{
+	if constexpr(FixedChannels != 0)
+	{
+		numChannels = FixedChannels;
+	}
+
+	constexpr size_t bytes = Format::bytes;
+	const size_t numSamples = numFrames * numChannels;
+
+	size_t i = 0;
+
+#ifdef __SSE2__
+	// Whether the 4 samples from 'sample' onwards can be loaded as a vector, without reading past the input
+	const auto fits = [numSamples](size_t sample)
+	{
+		return (sample + 4) * bytes + Format::overread <= numSamples * bytes;
+	};
+
+	if(numChannels == 1)
+	{
+		for(; fits(i); i += 4)
+		{
+			_mm_storeu_ps(out[0] + i, Format::load4(in + i * bytes));
+		}
+	}
+	else if(numChannels == 2)
+	{
+		float* left = out[0];
+		float* right = out[1];
+
+		// 4 frames at a time, L0 R0 L1 R1 | L2 R2 L3 R3 -> L0 L1 L2 L3 & R0 R1 R2 R3
+		for(; fits(i * 2 + 4); i += 4)
+		{
+			const __m128 a = Format::load4(in + i * 2 * bytes);
+			const __m128 b = Format::load4(in + (i * 2 + 4) * bytes);
+			_mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+	}
+	else
+	{
+		// Convert 4 samples at a time, and scatter them to their channels
+		size_t sample = 0;
+		size_t frame = 0;
+		unsigned int channel = 0;
+		alignas(16) float converted[4];
+		for(; fits(sample); sample += 4)
+		{
+			_mm_store_ps(converted, Format::load4(in + sample * bytes));
+			for(float value : converted)
+			{
+				out[channel][frame] = value;
+				if(++channel == numChannels)
+				{
+					channel = 0;
+					++frame;
+				}
+			}
+		}
+
+		for(; sample < numSamples; ++sample)
+		{
+			out[channel][frame] = Format::load(in + sample * bytes);
+			if(++channel == numChannels)
+			{
+				channel = 0;
+				++frame;
+			}
+		}
+		return;
+	}
+#endif
+
+	// Remainder, or everything without SSE2
+	for(; i < numFrames; ++i)
+	{
+		for(unsigned int channel = 0; channel < numChannels; ++channel)
+		{
+			out[channel][i] = Format::load(in + (i * numChannels + channel) * bytes);
+		}
+	}
+}
+
+// The kernel for each SampleFormat
+template <SampleFormat format>
+struct FormatOf;
+
+template <>
+struct FormatOf<SampleFormat::Float32>
+{
+	typedef Float32 Type;
+};
+
+template <>
+struct FormatOf<SampleFormat::S16>
+{
+	typedef S16 Type;
+};
+
+template <>
+struct FormatOf<SampleFormat::S24>
+{
+	typedef S24 Type;
+};
+
+template <>
+struct FormatOf<SampleFormat::S24In32>
+{
+	typedef S24In32 Type;
+};
+
+template <>
+struct FormatOf<SampleFormat::S32>
+{
+	typedef S32 Type;
+};
+
+} // namespace PCM
+} // namespace DSP
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Onset detection and tempo / beat tracking, updated once per spectrum frame. Everything is incremental, and the
+// work per frame only depends on the number of bands and the tempo range, never on how much history there is
+
+namespace DSP
+{
+// Spectral flux, the mean rise in level across the bands since the last frame, against an adaptive threshold which
+// follows the recent mean and deviation of the flux, so it works at any level or density of music
+class OnsetDetector
+{
+public:
+	// 'maxLevels' is the most levels process() will be given
+	OnsetDetector(float framesPerSecond, size_t maxLevels);
+
+	// Update from this frame's band levels, in dB. A change in 'count' (e.g. new bands) restarts the detection
+	void process(const float* levels, size_t count);
+
+	// Forget the previous levels, so the next frame isn't compared against bands which have moved
+	void reset();
+
+	// How far the flux is above its threshold this frame, in dB, 0 if it isn't
+	float getStrength() const { return m_strength; }
+
+	// Whether this frame starts an onset, at most one every s_minOnsetInterval
+	bool isOnset() const { return m_onset; }
+
+	// The flux above its recent mean, a continuous onset envelope for tempo tracking
+	float getEnvelope() const { return m_envelope; }
+
+	static constexpr float s_minOnsetInterval = 0.05f; // seconds
+
+private:
+	std::vector<float> m_previousLevels;
+	size_t m_count;
+
+	// Per frame coefficient of the running mean and mean deviation, and decay of the peak
+	const float m_adaptation;
+	const float m_peakDecay;
+	const unsigned int m_refractoryFrames;
+
+	float m_mean;
+	float m_deviation;
+	float m_peak;
+	unsigned int m_framesSinceOnset;
+
+	float m_strength;
+	bool m_onset;
+	float m_envelope;
+};
+
+// The period of an onset envelope, from its autocorrelation over the lags of a tempo range, and the phase of the beat,
+// a free running oscillator at that period which onsets pull into line
+class TempoTracker
+{
+public:
+	TempoTracker(float framesPerSecond, float minBPM = 60.0f, float maxBPM = 200.0f);
+
+	// Update with this frame's onset envelope, and whether it's an onset
+	void process(float envelope, bool onset);
+
+	void reset();
+
+	// Beats per minute, 0 until there's enough history to tell
+	float getTempo() const { return m_tempo; }
+
+	// Position in the current beat, [0, 1), 0 on the beat
+	float getBeatPhase() const { return m_phase; }
+
+	// Whether a beat fell in this frame
+	bool isBeat() const { return m_beat; }
+
+private:
+	const float m_framesPerSecond;
+	const unsigned int m_minLag; // frames
+	const unsigned int m_maxLag;
+
+	// The last m_maxLag + 1 envelope values
+	std::vector<float> m_envelope;
+	size_t m_envelopeIndex;
+	size_t m_numFrames;
+
+	// Exponentially decaying autocorrelation, for each lag from m_minLag to m_maxLag, and the weight of each lag's
+	// tempo, favouring moderate tempos so the tracker doesn't jump between multiples of the beat
+	std::vector<float> m_autocorrelation;
+	std::vector<float> m_tempoWeights;
+	const float m_decay;
+
+	const float m_envelopeSmoothing;
+	float m_smoothedEnvelope;
+
+	float m_tempo;
+	float m_phase;
+	bool m_beat;
+};
+
+} // namespace DSP
@@ -0,0 +1,26 @@
+#pragma once
+
+// Runtime detection of the SIMD extensions our kernels have paths for, so a single binary can use the widest
+// one the CPU supports
+
+// For the scalar kernel a vector kernel finishes its tail with. Inlined, the tail is compiled for the vector
+// kernel's target. Called out of line from AVX code, GCC leaves the upper halves of the registers dirty for the SSE
+// tail and for whoever called the kernel, which costs more than the work: 513 bins to dB took 2.2x as long
+#define DSP_SCALAR_TAIL inline __attribute__((always_inline))
+
+namespace DSP
+{
+enum struct SIMDLevel
+{
+	Scalar = 0,
+	SSE2,
+	AVX2, // implies FMA
+	AVX512 // AVX-512F
+};
+
+// The widest level supported by this CPU, detected once
+SIMDLevel getSIMDLevel();
+
+const char* toString(SIMDLevel level);
+
+} // namespace DSP
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+
+// Temporal smoothing of a spectrum from one frame to the next, so displays don't flicker. Works on dB values, so
+// attack and release behave the same at every level
+
+namespace DSP
+{
+// Per frame coefficients, see smoothingCoefficient() to derive them from time constants
+struct SmoothingCoefficients
+{
+	float attack; // fraction of the way towards a louder value, (0, 1]
+	float release; // fraction of the way towards a quieter value, (0, 1]
+	float peakFall; // dB the held peak falls by
+	float average; // fraction of the way the long-term average moves, (0, 1]
+};
+
+// Where the smoothed values, held peaks and long-term averages for one spectrum live
+struct SmoothingPlanes
+{
+	float* smoothed;
+	float* peak;
+	float* average;
+};
+
+// The one-pole coefficient for a time constant of 'seconds', at 'framesPerSecond' updates per second
+float smoothingCoefficient(float seconds, float framesPerSecond);
+
+// One fused pass over 'count' dB values, updating 'state' and writing the new values to 'out' as well:
+//  smoothed += (in > smoothed ? attack : release) * (in - smoothed)
+//  peak = max(in, peak - peakFall)
+//  average += average coefficient * (in - average)
+// Dispatches to the widest SIMD path the CPU supports
+void smoothSpectrum(
+	const float* in,
+	size_t count,
+	const SmoothingCoefficients& coefficients,
+	const SmoothingPlanes& state,
+	const SmoothingPlanes& out);
+
+// Start every plane of 'state' at 'in', e.g. for the first frame or after the bins change
+void resetSmoothing(const float* in, size_t count, const SmoothingPlanes& state);
+
+} // namespace DSP
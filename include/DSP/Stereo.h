@@ -0,0 +1,58 @@
+#pragma once
+
+#include "DSP/SIMD.h"
+
+#include <cstddef>
+#include <vector>
+
+// The stereo image of a pair of channels, from their complex spectra, which the dB spectrum throws away. Built on
+// running averages of each bin's auto and cross spectra, since a single frame of two sinusoids is always perfectly
+// coherent
+
+namespace DSP
+{
+// Where the per bin results of StereoAnalyser::process go
+struct StereoPlanes
+{
+	float* coherence; // [0, 1], |<L R*>|² / (<|L|²> <|R|²>), how much of the pair is the same signal up to a delay
+	float* phase; // radians [-π, π], arg <L R*>, how far the left channel leads the right
+	float* side; // [0, 1], the side energy over mid + side, 0 for mono, 0.5 for unrelated channels, 1 out of phase
+};
+
+class StereoAnalyser
+{
+public:
+	// 'coefficient' is the per frame coefficient of the running averages, see smoothingCoefficient()
+	StereoAnalyser(size_t numBins, float coefficient);
+
+	// One fused pass over two channels' 'numBins' interleaved (re, im) bins, updating the averages and writing every
+	// bin's results. Dispatches to the widest SIMD path the CPU supports
+	void process(const float* left, const float* right, const StereoPlanes& out);
+
+	// As above, with an explicit SIMD level, for comparing paths
+	void process(SIMDLevel level, const float* left, const float* right, const StereoPlanes& out);
+
+	// Back to silence
+	void reset();
+
+	// Correlation of the two channels over the whole spectrum, [-1, 1]: 1 for mono, 0 for unrelated channels, -1
+	// when one is the other inverted. The frequency domain equivalent of a correlation meter on the (windowed) samples
+	float getCorrelation() const { return m_correlation; }
+
+	// Side energy over mid + side across the whole spectrum, as StereoPlanes::side
+	float getSide() const { return m_side; }
+
+	size_t getNumBins() const { return m_numBins; }
+
+private:
+	const size_t m_numBins;
+	const float m_coefficient;
+
+	// Averages of |L|², |R|², Re(L R*) and Im(L R*), one plane of each [4 * numBins]
+	std::vector<float> m_averages;
+
+	float m_correlation;
+	float m_side;
+};
+
+} // namespace DSP
@@ -0,0 +1,38 @@
+#pragma once
+
+// Frequency weighting curves, which approximate how loud each frequency sounds relative to the others, for
+// weighting a spectrum or a level meter by perceived loudness
+
+namespace DSP
+{
+enum struct FrequencyWeighting
+{
+	None, // flat
+	A, // IEC 61672 A-weighting, the ear's response to quiet sounds
+	K // ITU-R BS.1770 K-weighting, a high shelf and a low cut, as used for LUFS
+};
+
+const char* toString(FrequencyWeighting weighting);
+
+// Gain of a weighting at 'frequencyHz', in dB. K-weighting is defined as digital filters, so it also depends on the
+// sample rate. Clamped to -200dB, rather than -inf at 0Hz
+float weightingDecibels(FrequencyWeighting weighting, float frequencyHz, unsigned int sampleRate);
+
+// Second order IIR section, normalised so a0 = 1:
+//  y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2]
+struct Biquad
+{
+	double b0, b1, b2;
+	double a1, a2;
+};
+
+// The two stages of the K-weighting filter, redesigned for 'sampleRate' from BS.1770's 48kHz definition
+struct KWeightingFilter
+{
+	Biquad shelf; // +4dB above ~1.5kHz, models the acoustic effect of the head
+	Biquad highPass; // the revised low-frequency B curve (RLB), below ~40Hz
+};
+
+KWeightingFilter kWeightingFilter(unsigned int sampleRate);
+
+} // namespace DSP
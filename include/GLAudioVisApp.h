@@ -9,11 +9,15 @@
 #include "SDLUtils/GLContext.h"
 
 #include "GLUtils/ShaderProgram.h"
+#include "GLUtils/Buffer.h"
 #include "GLUtils/VAO.h"
 #include "GLUtils/Texture.h"
 
 #include "AudioEngine.h"
 #include "OrbitalCamera.h"
+#include "RecordingReader.h"
+
+#include <chrono>
 
 namespace gaz
 {
@@ -25,26 +29,73 @@ public:
 	// returns exit code back to main.cpp
 	static int execute(int argc, char* argv[]);
 
+	// How a recording is played back, instead of analysing a source
+	struct ReplaySettings
+	{
+		float speed = 1.0f; // times real time
+
+		// Move on by 1 / fixedFPS seconds (times the speed) every rendered frame, rather than by the time which has
+		// passed, so a replay renders the same frames every time. 0 follows the clock
+		unsigned int fixedFPS = 0;
+
+		bool loop = false;
+	};
+
 private:
 	// Constructors
-	GLAudioVisApp() :
+	GLAudioVisApp(
+		std::unique_ptr<AudioSource> audioSource,
+		AudioEngine::Analysis analysis,
+		unsigned char numChannels,
+		std::unique_ptr<const RecordingReader> replay,
+		const ReplaySettings& replaySettings
+	) :
 		m_mainWindow{nullptr},
 		m_glContext{nullptr},
 		m_imGuiContext{nullptr},
 		m_audioEngine
-		({
-			2, // numChannels
-			44100, // sampleRate
-			1024, // numSamples
-			PA_SAMPLE_FLOAT32LE, // sample format
-		}),
+		(
+			analysis == AudioEngine::Analysis::Linear ?
+			AudioEngine::SamplingSettings{
+				numChannels,
+				44100, // sampleRate
+				1024, // numSamples
+				PA_SAMPLE_FLOAT32LE, // sample format
+			} :
+			// Constant-Q needs a much longer window for its low bins, so hop through it to keep the frame rate up
+			AudioEngine::SamplingSettings{
+				numChannels,
+				44100, // sampleRate
+				16384, // numSamples
+				PA_SAMPLE_FLOAT32LE, // sample format
+				1024, // hopSize
+				1024, // framesPerRead
+				true, // upgradePlanInBackground
+				AudioEngine::Analysis::ConstantQ
+			},
+			std::move(audioSource)
+		),
 		m_outputShader{nullptr},
 		m_emptyVAO{nullptr},
 		m_dftTexture{nullptr},
+		m_descriptorBuffer{nullptr},
+		m_descriptorBlock{},
 		m_sampleCountDFT{32u},
 		m_sampleIndexDFT{0u},
 		m_cubeResolution{64},
-		m_camera()
+		m_cubeDecibelFloor{-60.0f},
+		m_cubeDecibelCeiling{0.0f},
+		m_camera(),
+		m_uploadedCaptureTimes{},
+		m_replay{std::move(replay)},
+		m_replaySettings{replaySettings},
+		m_replayIndex{0},
+		m_replayPosition{0},
+		m_replayPaused{false},
+		m_replayLastUpdate{},
+		m_profilerPaused{false},
+		m_profilerSpanMs{50.0f},
+		m_profilerViewEnd{0}
 	{
 		fmt::print("GLAudioVisApp()\n");
 	}
@@ -87,8 +138,27 @@ private:
 	// rendering
 	void drawFrame();
 
+	// Write a spectrum [numChannels * bins] into the next slice of the DFT texture
+	void uploadSpectrum(const float* spectrum);
+
+	// Move the replay on, and upload the spectra it's passed, returns whether there were any
+	bool advanceReplay();
+
+	// Jump to a point in the recording, the trail is refilled from the spectra leading up to it
+	void seekReplay(int64_t positionNs);
+
 	void drawGUI();
 
+	void drawReplayGUI();
+
+	void drawCubeRangeGUI();
+
+	// The Profiler window, a timeline of the last few frames' scopes on every thread and the GPU
+	void drawProfilerGUI();
+
+	// Bins per channel of each spectrum, from the engine or the recording
+	unsigned int getNumSpectrumBins() const;
+
 	// SDL Window object
 	std::unique_ptr<SDLUtils::Window> m_mainWindow;
 
@@ -110,6 +180,13 @@ private:
 	// Texture object to store DFT output
 	std::unique_ptr<const GLUtils::Texture> m_dftTexture;
 
+	// Uniform buffer for the SpectralDescriptors block in cube.vert, and its std140 contents, two vec4s per channel
+	static constexpr unsigned int s_maxDescriptorChannels = 32;
+	static constexpr unsigned int s_descriptorFloatsPerChannel = 8;
+	static constexpr GLuint s_descriptorBindingPoint = 0;
+	std::unique_ptr<const GLUtils::Buffer> m_descriptorBuffer;
+	std::vector<float> m_descriptorBlock;
+
 	// The number of DFT samples to store in a 3d texture, to act as a 'trail'
 	unsigned int m_sampleCountDFT;
 
@@ -119,8 +196,31 @@ private:
 	// Cube visualisation resolution
 	unsigned int m_cubeResolution;
 
+	// The levels (dBFS) the points fade in from, and reach full brightness at
+	float m_cubeDecibelFloor;
+	float m_cubeDecibelCeiling;
+
 	// Camera
 	OrbitalCamera m_camera;
+
+	// When the frames uploaded since the last buffer swap were captured, for the swap's latency
+	std::vector<std::chrono::steady_clock::time_point> m_uploadedCaptureTimes;
+
+	// When replaying a recording, the engine is left idle and the spectra come straight out of the file's mapping
+	std::unique_ptr<const RecordingReader> m_replay;
+	ReplaySettings m_replaySettings;
+
+	// The next spectrum to upload, and the replay's position on the recording's clock, in ns
+	size_t m_replayIndex;
+	int64_t m_replayPosition;
+	bool m_replayPaused;
+	std::chrono::steady_clock::time_point m_replayLastUpdate;
+
+	// The profiler timeline stops collecting while paused, so it can be looked over. It shows m_profilerSpanMs up to
+	// m_profilerViewEnd, on the profiler's clock
+	bool m_profilerPaused;
+	float m_profilerSpanMs;
+	int64_t m_profilerViewEnd;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <GL/glew.h>
+
+// This just wraps a couple of OpenGL Buffer Object manipulation methods,
+// so that I don't have to touch the raw ID
+// also ensures deletion when it goes out of scope
+
+namespace GLUtils
+{
+class Buffer
+{
+public:
+	Buffer()
+		: m_id(0)
+	{
+		glGenBuffers(1, &m_id);
+	}
+
+	~Buffer()
+	{
+		glDeleteBuffers(1, &m_id);
+	}
+
+	// Disable copy constructor and assignment operator, since we're managing OpenGL resources, and it's
+	// not worth the hassle to share their ownership
+	Buffer(const Buffer&) = delete;
+	Buffer& operator=(const Buffer&) = delete;
+	// ...and move constructor, move assignment
+	Buffer(Buffer&&) = delete;
+	Buffer& operator=(Buffer&&) = delete;
+
+	inline void bindAs(const GLenum& target) const
+	{
+		glBindBuffer(target, m_id);
+	}
+
+	// Bind to an indexed target, e.g. a uniform block binding point, this also binds it to the generic target
+	inline void bindToIndex(const GLenum& target, const GLuint& index) const
+	{
+		glBindBufferBase(target, index, m_id);
+	}
+
+	static inline void unbind(const GLenum& target)
+	{
+		glBindBuffer(target, 0);
+	}
+
+private:
+	// Buffer ID
+	GLuint m_id;
+};
+
+} // namespace GLUtils
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "Profiler.h"
+
+#include <array>
+
+#include <GL/glew.h>
+
+// GPU side of gaz::Profiler. GAZ_PROFILE_GPU_SCOPE("name") is a CPU scope which also brackets the GL commands issued
+// in it with timestamp queries. Like GLUtils::Timer, the results are only read back once the GPU has them, a frame or
+// two later, and never waited on. They're moved onto the CPU's clock and recorded on the profiler's "GPU" track,
+// against the same Site as their CPU scope, so the two can be lined up
+
+namespace GLUtils
+{
+class GPUProfiler
+{
+public:
+	// Render thread only, with the GL context current
+	static GPUProfiler& instance();
+
+	// Disable copy constructor and assignment operator, since we're managing OpenGL resources, and it's
+	// not worth the hassle to share their ownership
+	GPUProfiler(const GPUProfiler&) = delete;
+	GPUProfiler& operator=(const GPUProfiler&) = delete;
+	// ...and move constructor, move assignment
+	GPUProfiler(GPUProfiler&&) = delete;
+	GPUProfiler& operator=(GPUProfiler&&) = delete;
+
+	// Open a scope, returns its slot, or -1 if the profiler's off or every slot is still waiting on the GPU
+	int begin(const gaz::Profiler::Site& site);
+
+	void end(int slot);
+
+	// Record every scope the GPU has finished on the profiler's GPU track, without waiting for the rest. Once a frame
+	void collect();
+
+	// Free the queries, before the GL context is destroyed
+	void clear();
+
+	// Scopes skipped because every slot was still waiting on the GPU
+	unsigned long getSkipped() const
+	{
+		return m_skipped;
+	}
+
+private:
+	GPUProfiler();
+
+	// Whether a query's result can be read without waiting
+	static bool isAvailable(GLuint query);
+
+	struct Query
+	{
+		GLuint start, end;
+		const gaz::Profiler::Site* site;
+		uint32_t depth;
+		int64_t issuedNs; // CPU time at begin()
+		bool ended;
+	};
+
+	// A couple of hundred scopes a frame, for a few frames in flight
+	static constexpr unsigned int s_numQueries = 1024;
+	std::array<Query, s_numQueries> m_queries;
+	bool m_hasQueries;
+
+	// Scopes begun and collected so far, the slot for each is its index modulo s_numQueries. Everything from
+	// m_collected up to m_begun is waiting on the GPU, or still open
+	unsigned long m_begun;
+	unsigned long m_collected;
+	unsigned int m_depth;
+	unsigned long m_skipped;
+
+	// CPU minus GPU timestamps, in ns, and when it was last measured
+	int64_t m_clockOffset;
+	int64_t m_lastCalibration;
+
+	gaz::Profiler::Track* m_track;
+};
+
+// Helper for GAZ_PROFILE_GPU_SCOPE
+struct GPUProfileScope
+{
+	GPUProfileScope(const gaz::Profiler::Site& site)
+		: slot(GPUProfiler::instance().begin(site))
+	{
+	}
+	~GPUProfileScope()
+	{
+		GPUProfiler::instance().end(slot);
+	}
+	const int slot;
+};
+
+} // namespace GLUtils
+
+// Profile the rest of the enclosing block as 'name' on both the CPU and the GPU, render thread only
+#define GAZ_PROFILE_GPU_SCOPE(name) \
+	GAZ_PROFILE_SCOPE(name); \
+	const GLUtils::GPUProfileScope GAZ_PROFILE_CONCAT(gpuProfileScope, __LINE__){ \
+		GAZ_PROFILE_CONCAT(s_profileSite, __LINE__) \
+	}
@@ -40,6 +40,9 @@ public:
 	// Make sure you use this shader program before using the returned value in glUniform...
 	GLint getUniformLocation(const char* uniformName) const;
 
+	// Point a uniform block at a buffer binding point, false if the program has no active block of that name
+	bool bindUniformBlock(const char* blockName, GLuint bindingPoint) const;
+
 	bool isValid() const { return m_isValid; }
 
 private:
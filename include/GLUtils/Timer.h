@@ -1,6 +1,5 @@
 #pragma once
 
-#include <algorithm>
 #include <array>
 
 #include <GL/glew.h>
@@ -13,9 +12,21 @@ constexpr size_t constStringHash(char const* input)
 	return *input ? static_cast<size_t>(*input) + 33 * constStringHash(input + 1) : 5381;
 }
 
-// Start a timer given it's hash, prefer the 'named' macro below to do compile time hashing
-void _startTimer(const size_t& hash);
+// How a timer measures the GPU time between its start and end
+enum struct TimerMode
+{
+	// A GL_TIMESTAMP query at each end, so timers can nest and overlap
+	Timestamp,
+	// One GL_TIME_ELAPSED query around the commands, which is cheaper, but only one can be active at a time, so these
+	// timers can't nest in each other
+	TimeElapsed
+};
+
+// Start a timer given it's hash, prefer the 'named' macro below to do compile time hashing. The timer is created by
+// its first start, with that mode
+void _startTimer(const size_t& hash, TimerMode mode = TimerMode::Timestamp);
 #define startTimer(name) _startTimer(GLUtils::constStringHash(#name))
+#define startElapsedTimer(name) _startTimer(GLUtils::constStringHash(#name), GLUtils::TimerMode::TimeElapsed)
 
 // End a timer given it's hash, prefer the 'named' macro below to do compile time hashing
 void _endTimer(const size_t& hash);
@@ -24,10 +35,10 @@ void _endTimer(const size_t& hash);
 // Helper for the scoped timer, starts the timer when it's constructed, ends it when it's destructed
 struct _scopedTimer
 {
-	_scopedTimer(const size_t& h)
+	_scopedTimer(const size_t& h, TimerMode mode = TimerMode::Timestamp)
 		: hash(h)
 	{
-		_startTimer(hash);
+		_startTimer(hash, mode);
 	}
 	~_scopedTimer()
 	{
@@ -37,8 +48,11 @@ struct _scopedTimer
 };
 // TODO: what if someone calls this twice with the same name?
 #define scopedTimer(name) _scopedTimer _timer_##name(GLUtils::constStringHash(#name))
+#define scopedElapsedTimer(name) \
+	_scopedTimer _timer_##name(GLUtils::constStringHash(#name), GLUtils::TimerMode::TimeElapsed)
 
-// Get a timer's elapsed value given it's hash, prefer the 'named' macro below to do compile time hashing
+// Get a timer's elapsed value given it's hash, prefer the 'named' macro below to do compile time hashing. This is the
+// newest measurement the GPU has finished, usually from a frame or two ago
 float _getElapsed(const size_t& hash);
 #define getElapsed(name) _getElapsed(GLUtils::constStringHash(#name))
 
@@ -46,10 +60,14 @@ float _getElapsed(const size_t& hash);
 // called before the gl context is destroyed
 void clearTimers();
 
+// GPU timer which never waits on the GPU. Each start / end pair writes its queries into the next slot of a ring, one
+// slot per measurement (usually per frame), and the results are only read back once the GPU says they're available,
+// oldest first. With several frames in flight the ring just fills up, and if it's ever full the measurement is skipped
+// rather than stalling
 class Timer
 {
 public:
-	Timer();
+	explicit Timer(TimerMode mode = TimerMode::Timestamp);
 
 	~Timer()
 	{
@@ -61,26 +79,54 @@ public:
 	Timer(const Timer&) = delete;
 	Timer& operator=(const Timer&) = delete;
 
-	void start() const
-	{
-		glQueryCounter(m_queries.front().start, GL_TIMESTAMP);
-	}
+	void start();
 
 	void end();
 
+	// ms, of the newest measurement which has finished
 	float elapsed() const
 	{
 		return m_elapsed;
 	}
 
+	TimerMode getMode() const
+	{
+		return m_mode;
+	}
+
+	// Measurements skipped because every slot was still waiting on the GPU
+	unsigned long getSkipped() const
+	{
+		return m_skipped;
+	}
+
 private:
 	struct TimerQuery
 	{
-		GLuint start, end;
+		GLuint start, end; // only start is used for TimerMode::TimeElapsed
 	};
 
-	static constexpr unsigned int s_bufferSize = 3;
+	// Read back every measurement the GPU has finished, without waiting for the rest
+	void collect();
+
+	// Whether a query's result can be read without waiting
+	static bool isAvailable(GLuint query);
+
+	const TimerMode m_mode;
+
+	// Deep enough for the few frames a driver queues up, with plenty to spare
+	static constexpr unsigned int s_bufferSize = 8;
 	std::array<TimerQuery, s_bufferSize> m_queries;
+
+	// Measurements started and collected so far, the slot for each is its index modulo s_bufferSize. Everything from
+	// m_collected up to m_started is waiting on the GPU
+	unsigned long m_started;
+	unsigned long m_collected;
+
+	// Whether the measurement in progress got a slot
+	bool m_measuring;
+	unsigned long m_skipped;
+
 	float m_elapsed;
 };
 
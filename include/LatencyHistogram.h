@@ -0,0 +1,134 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+namespace gaz
+{
+
+// Lock-free histogram of nanosecond durations, in the style of HdrHistogram: each power of two is split into
+// s_numSubBuckets linear buckets, so every value is kept to within about 3% from nanoseconds up to minutes, in a
+// fixed few KB. Any number of threads may record at once, each value is a couple of relaxed atomic adds. Readers see
+// a consistent enough picture for percentiles, though a reset() racing with writers can lose some of their values
+class LatencyHistogram
+{
+public:
+	LatencyHistogram();
+
+	// Disable copy and move, since the counts may be written by several threads
+	LatencyHistogram(const LatencyHistogram&) = delete;
+	LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+	LatencyHistogram(LatencyHistogram&&) = delete;
+	LatencyHistogram& operator=(LatencyHistogram&&) = delete;
+
+	// Negative durations count as 0, anything past the largest bucket goes in it
+	void record(int64_t valueNs)
+	{
+		const uint64_t value = valueNs > 0 ? static_cast<uint64_t>(valueNs) : 0;
+		m_counts[getBucket(value)].fetch_add(1, std::memory_order_relaxed);
+		m_count.fetch_add(1, std::memory_order_relaxed);
+		m_sum.fetch_add(value, std::memory_order_relaxed);
+
+		uint64_t max = m_max.load(std::memory_order_relaxed);
+		while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	uint64_t getCount() const { return m_count.load(std::memory_order_relaxed); }
+
+	// Exact, rather than bucketed
+	int64_t getMax() const { return static_cast<int64_t>(m_max.load(std::memory_order_relaxed)); }
+
+	int64_t getMean() const;
+
+	// The value 'percentile' (0 to 100) of the recorded values are at or below, to within a bucket, 0 when empty
+	int64_t getPercentile(double percentile) const;
+
+	void reset();
+
+	// One line of count, mean, p50, p90, p99, p99.9 and max, in milliseconds
+	void print(std::FILE* file, const char* name) const;
+
+private:
+	static constexpr unsigned int s_subBucketBits = 5;
+	static constexpr uint64_t s_numSubBuckets = 1u << s_subBucketBits;
+
+	// Values from 2^s_maxBits ns (about 18 minutes) on share the last bucket
+	static constexpr unsigned int s_maxBits = 40;
+	static constexpr size_t s_numBuckets = (s_maxBits - s_subBucketBits + 1) * s_numSubBuckets;
+
+	// Values below s_numSubBuckets get a bucket each. Above, the bucket's group is the value's top bit, and its place
+	// in the group the next s_subBucketBits bits
+	static size_t getBucket(uint64_t value)
+	{
+		if (value < s_numSubBuckets)
+		{
+			return static_cast<size_t>(value);
+		}
+
+		const unsigned int topBit = 63 - static_cast<unsigned int>(__builtin_clzll(value));
+		if (topBit >= s_maxBits)
+		{
+			return s_numBuckets - 1;
+		}
+
+		const unsigned int shift = topBit - s_subBucketBits;
+		return (shift + 1) * s_numSubBuckets + ((value >> shift) & (s_numSubBuckets - 1));
+	}
+
+	// The middle of the values which fall in 'bucket'
+	static uint64_t getBucketValue(size_t bucket);
+
+	std::array<std::atomic<uint64_t>, s_numBuckets> m_counts;
+	std::atomic<uint64_t> m_count;
+	std::atomic<uint64_t> m_sum;
+	std::atomic<uint64_t> m_max;
+};
+
+// Where a block of samples has got to on its way from the capture device to the screen, each timed from when the
+// newest sample in the window was captured
+enum struct LatencyStage
+{
+	Capture, // the source's read returned, i.e. the device's own latency
+	Analysis, // the window's DFT and everything derived from it were done
+	Publish, // the frame was handed to the renderer
+	Upload, // the renderer copied the frame's spectrum into the texture
+	Swap, // the buffers were swapped with the frame on screen
+	NumStages
+};
+
+const char* toString(LatencyStage stage);
+
+// A histogram per stage, recorded by the recording thread and the renderer
+class LatencyStats
+{
+public:
+	static constexpr size_t s_numStages = static_cast<size_t>(LatencyStage::NumStages);
+
+	// Record the time from 'captureTime' until 'time'
+	void record(
+		LatencyStage stage,
+		std::chrono::steady_clock::time_point captureTime,
+		std::chrono::steady_clock::time_point time)
+	{
+		get(stage).record(std::chrono::duration_cast<std::chrono::nanoseconds>(time - captureTime).count());
+	}
+
+	LatencyHistogram& get(LatencyStage stage) { return m_histograms[static_cast<size_t>(stage)]; }
+
+	const LatencyHistogram& get(LatencyStage stage) const { return m_histograms[static_cast<size_t>(stage)]; }
+
+	void reset();
+
+	// A line per stage which has seen anything, see LatencyHistogram::print
+	void print(std::FILE* file) const;
+
+private:
+	std::array<LatencyHistogram, s_numStages> m_histograms;
+};
+
+}
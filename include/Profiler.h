@@ -0,0 +1,179 @@
+#pragma once
+
+#include "SPSCRing.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace gaz
+{
+
+// Hierarchical CPU profiler, for any thread. A scope is marked with GAZ_PROFILE_SCOPE("name"), which puts a
+// constexpr Site in static storage at the call site, so each scope is identified by its site's address: nothing is
+// registered, hashed or looked up at runtime, and the same name can be used (or nested) anywhere.
+//
+// Each thread records its scopes as they end into its own track, a lock-free SPSCRing, so recording never takes a
+// lock or allocates (besides the thread's first scope, which finds it a track). The render thread drains every track
+// once a frame in collect(), keeping the last second or so for the timeline. GPU scopes (see GLUtils/GPUProfiler.h)
+// are fed into a track of their own, on the same clock.
+//
+// A thread's track is retired when the thread exits, and taken over by the next thread of the same name (or the next
+// unnamed thread), so threads which come and go, like the recording threads, don't pile up tracks.
+//
+// Nothing is recorded until setEnabled(true), until then a scope costs a relaxed load and no track is made
+class Profiler
+{
+public:
+	// Where a scope is in the code, see GAZ_PROFILE_SCOPE
+	struct Site
+	{
+		const char* name;
+		const char* file;
+		int line;
+	};
+
+	// One run of a scope. Times are nanoseconds on the steady clock
+	struct Event
+	{
+		const Site* site = nullptr;
+		int64_t startNs = 0;
+		int64_t endNs = 0;
+		uint32_t depth = 0; // 0 for the outermost scope on the track
+
+		// GPU events only, when the CPU issued the commands, to line them up with their CPU scope
+		int64_t issuedNs = 0;
+	};
+
+	// One thread's events, or the GPU's. Written by one thread at a time, and drained by collect()
+	struct Track
+	{
+		Track(const std::string& trackName, bool isNamed) :
+			name{trackName},
+			named{isNamed},
+			alive{true},
+			ring{s_trackCapacity},
+			depth{0},
+			events{}
+		{
+		}
+
+		const std::string name;
+		const bool named;
+
+		// Cleared when the writing thread exits, the track can then be taken over by another thread
+		std::atomic<bool> alive;
+
+		SPSCRing<Event> ring;
+
+		// Writer only, scopes open on this track
+		uint32_t depth;
+
+		// collect() only, the events which ended in the last s_historyNs, in the order they ended
+		std::vector<Event> events;
+	};
+
+	// Marks a scope from its construction to its destruction, see GAZ_PROFILE_SCOPE
+	class Scope
+	{
+	public:
+		explicit Scope(const Site& site) :
+			m_site{&site},
+			m_track{isEnabled() ? getThreadTrack() : nullptr},
+			m_depth{0},
+			m_startNs{0}
+		{
+			if (m_track != nullptr)
+			{
+				m_depth = m_track->depth++;
+				m_startNs = now();
+			}
+		}
+
+		~Scope()
+		{
+			if (m_track != nullptr)
+			{
+				m_track->depth--;
+				record(*m_track, {m_site, m_startNs, now(), m_depth, 0});
+			}
+		}
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+		Scope(Scope&&) = delete;
+		Scope& operator=(Scope&&) = delete;
+
+	private:
+		const Site* m_site;
+		Track* m_track;
+		uint32_t m_depth;
+		int64_t m_startNs;
+	};
+
+	static void setEnabled(bool enabled) { s_enabled.store(enabled, std::memory_order_relaxed); }
+
+	static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+	static int64_t now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()
+		).count();
+	}
+
+	// Name the calling thread's track, e.g. when the thread starts, before its first scope. Unnamed threads are
+	// numbered
+	static void setThreadName(const std::string& name);
+
+	// The calling thread's track, found on first use
+	static Track* getThreadTrack();
+
+	// A track which isn't a thread's, e.g. the GPU's. Only one thread may record to it
+	static Track* createTrack(const std::string& name);
+
+	// Append an event to a track, from the track's one writer. Dropped if collect() has fallen behind
+	static void record(Track& track, const Event& event)
+	{
+		Event* slot = track.ring.beginWrite();
+		*slot = event;
+		track.ring.endWrite();
+	}
+
+	// Render thread only: drain every track into its events, forget the ones which ended more than s_historyNs ago,
+	// and mark the start of a frame
+	static void collect();
+
+	// Render thread only, as of the last collect(): the live tracks, and those of threads which have exited while
+	// they still have events to show. Tracks are never freed, so the pointers stay valid
+	static std::vector<const Track*> getTracks();
+
+	// Render thread only, when each collect() in the last s_historyNs ran, oldest first
+	static const std::vector<int64_t>& getFrameTimes();
+
+	// Events a track dropped because its ring was full
+	static uint64_t getDropped(const Track& track) { return track.ring.getOverrunCount(); }
+
+	// How long the timeline remembers
+	static constexpr int64_t s_historyNs = 1'000'000'000;
+
+private:
+	// A few frames' worth at the engine's highest frame rates
+	static constexpr size_t s_trackCapacity = 4096;
+
+	static std::atomic<bool> s_enabled;
+};
+
+}
+
+#define GAZ_PROFILE_CONCAT_INNER(a, b) a##b
+#define GAZ_PROFILE_CONCAT(a, b) GAZ_PROFILE_CONCAT_INNER(a, b)
+
+// Profile the rest of the enclosing block as 'name', a string literal
+#define GAZ_PROFILE_SCOPE(name) \
+	static constexpr gaz::Profiler::Site GAZ_PROFILE_CONCAT(s_profileSite, __LINE__){name, __FILE__, __LINE__}; \
+	const gaz::Profiler::Scope GAZ_PROFILE_CONCAT(profileScope, __LINE__){GAZ_PROFILE_CONCAT(s_profileSite, __LINE__)}
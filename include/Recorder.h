@@ -0,0 +1,175 @@
+#pragma once
+
+#include "RecordingFormat.h"
+#include "SPSCRing.h"
+#include "SpectrumFrame.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace gaz
+{
+
+// Streams PCM blocks and spectrum frames to a file (see RecordingFormat.h), for getting back whatever the engine
+// saw. Each stream is written by one thread into its own pool of preallocated buffers, and a dedicated I/O thread
+// writes the full buffers to disk, so writers only ever copy into memory. If the disk falls so far behind that a
+// stream has no free buffer, its chunks are dropped (and counted) rather than waiting
+class Recorder
+{
+public:
+	struct Settings
+	{
+		bool pcm = true;
+		bool spectra = true;
+
+		// Record every n'th spectrum frame, at high frame rates the spectra are much bigger than the PCM
+		unsigned int spectrumInterval = 1;
+
+		// Per stream, each buffer is grown to hold at least a few of the stream's largest chunks
+		size_t bufferSize = 1 << 20;
+		size_t numBuffers = 8;
+	};
+
+	Recorder();
+
+	~Recorder();
+
+	// Disable copy constructor and assignment operator, since we're managing a file and a thread, and it's
+	// not worth the hassle to share their ownership
+	Recorder(const Recorder&) = delete;
+	Recorder& operator=(const Recorder&) = delete;
+	// ...and move constructor, move assignment
+	Recorder(Recorder&&) = delete;
+	Recorder& operator=(Recorder&&) = delete;
+
+	// Create (or truncate) 'path', write the header, and start the I/O thread. 'header' describes the engine, its
+	// magic, version, sizes, streams and start time are filled in here. Returns false if the file can't be written
+	bool open(const std::string& path, const Recording::FileHeader& header, const Settings& settings);
+
+	// Write out everything buffered and the spectra's seek index, then close the file. The writers must have stopped
+	void close();
+
+	bool isOpen() const { return m_file >= 0; }
+
+	// Append one read's worth of interleaved samples. Only ever call from one thread, e.g. the capture thread
+	void writePCM(const char* samples, size_t size);
+
+	// Append a frame's raw planes and meters. Only ever call from one thread, e.g. the recording thread
+	void writeSpectrum(const SpectrumFrame& frame);
+
+	// Hand the partly filled buffers to the I/O thread, e.g. when recording pauses. The writers must have stopped
+	void flush();
+
+	const std::string& getPath() const { return m_path; }
+
+	// Bytes on disk so far, including the header
+	uint64_t getBytesWritten() const { return m_bytesWritten.load(std::memory_order_relaxed); }
+
+	// Chunks thrown away because a stream had no free buffer, or the file couldn't be written
+	uint64_t getDroppedChunks() const;
+
+private:
+	struct Buffer
+	{
+		std::vector<char> data;
+		size_t size = 0;
+		unsigned int numChunks = 0;
+		std::chrono::steady_clock::time_point opened{};
+	};
+
+	// One writer's buffers, filled in place and handed to the I/O thread through the ring
+	struct Stream
+	{
+		explicit Stream(size_t numBuffers) :
+			ring{numBuffers},
+			current{nullptr},
+			pendingSize{0},
+			dropped{0}
+		{
+		}
+
+		SPSCRing<Buffer> ring;
+
+		// The buffer being filled, and the size of the chunk being written into it
+		Buffer* current;
+		size_t pendingSize;
+
+		std::atomic<uint64_t> dropped;
+	};
+
+	enum StreamIndex
+	{
+		PCMStream,
+		SpectrumStream,
+		NumStreams
+	};
+
+	// Nanoseconds on the monotonic clock since open()
+	int64_t timestamp() const;
+
+	// Room for a chunk with a 'payloadSize' payload in the stream's current buffer, after its header, or nullptr
+	// if there isn't a free buffer
+	char* beginChunk(Stream& stream, Recording::ChunkType type, uint64_t sequence, size_t payloadSize);
+
+	// Keep the chunk from beginChunk(), handing the buffer over once it's been open for a while
+	void endChunk(Stream& stream);
+
+	// Hand the stream's current buffer to the I/O thread, if it has one
+	void publish(Stream& stream);
+
+	// I/O thread, writes the streams' buffers to disk until close()
+	void writeBuffers();
+
+	// Note where each of a buffer of spectrum chunks landed, the buffer starting at 'offset' in the file
+	void indexBuffer(const Buffer& buffer, uint64_t offset);
+
+	// Append the index chunk and the trailer, once the I/O thread has finished
+	bool writeIndex();
+
+	// Write all of 'size' bytes, returns false on an error
+	bool writeFile(const char* data, size_t size);
+
+	// Wake the I/O thread, it also polls, so this never takes the lock
+	void wakeWriter();
+
+	std::string m_path;
+	int m_file;
+	Settings m_settings;
+	Recording::FileHeader m_header;
+
+	std::chrono::steady_clock::time_point m_start;
+
+	std::array<std::unique_ptr<Stream>, NumStreams> m_streams;
+
+	// Reads written by writePCM(), for the chunks' sequence numbers
+	uint64_t m_pcmSequence;
+
+	std::unique_ptr<std::thread> m_ioThread;
+	std::mutex m_ioMutex;
+	std::condition_variable m_ioCondition;
+	std::atomic<bool> m_closing;
+
+	// I/O thread only, then written by close(), where every spectrum chunk went
+	std::vector<Recording::IndexEntry> m_index;
+
+	// Set by the I/O thread once a write fails, after which buffers are discarded, and their chunks counted
+	bool m_failed;
+	std::atomic<uint64_t> m_failedChunks;
+
+	std::atomic<uint64_t> m_bytesWritten;
+
+	// I/O thread only, the start of the range most recently handed to the kernel for writeback, and of the range
+	// which may still be in the page cache, see writeFile()
+	uint64_t m_writebackOffset;
+	uint64_t m_cachedOffset;
+};
+
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// On-disk layout of a recording (see Recorder), an append-only sequence of chunks after a fixed header:
+//
+//  FileHeader
+//  ChunkHeader, payload, zero padding to a multiple of 8 bytes
+//  ChunkHeader, payload, ...
+//  Index chunk, Trailer (only once the recording's been closed)
+//
+// Everything is little endian and 8 byte aligned, so a reader can mmap the file and use the chunks in place. Chunks
+// are only ever appended, so a recording which was cut short is still readable up to its last whole chunk. Each
+// stream is written in batches, so chunks are in order within a type, but the types are interleaved in runs
+
+namespace gaz
+{
+namespace Recording
+{
+constexpr char s_magic[8] = {'G', 'A', 'Z', 'R', 'E', 'C', '\0', '\0'};
+constexpr uint32_t s_version = 1;
+
+// Which streams a file contains, FileHeader::streams
+constexpr uint32_t s_pcmStream = 1u << 0;
+constexpr uint32_t s_spectrumStream = 1u << 1;
+
+enum struct ChunkType : uint32_t
+{
+	PCM = 1, // one read from the source, interleaved samples in the header's sample format
+	Spectrum = 2, // a SpectrumChunk, followed by its arrays
+	Index = 3 // an IndexEntry for every spectrum chunk, in timestamp order, followed by the Trailer
+};
+
+struct FileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize; // bytes, the first chunk starts here
+	uint32_t streams; // s_pcmStream | s_spectrumStream
+
+	// The engine's SamplingSettings
+	uint32_t sampleRate;
+	uint32_t numChannels;
+	uint32_t sampleFormat; // pa_sample_format_t
+	uint32_t framesPerRead; // frames in each PCM chunk
+	uint32_t numSamples; // DFT window
+	uint32_t hopSize;
+	uint32_t analysis; // AudioEngine::Analysis
+
+	// Sizes of the spectrum chunks' arrays
+	uint32_t numOutputBins; // per channel
+	uint32_t maxBands; // per channel, each chunk has its own count
+
+	// Wall clock time the recording started, nanoseconds since the Unix epoch. Chunk timestamps are on the
+	// monotonic clock, relative to this
+	int64_t startTimeNs;
+};
+static_assert(sizeof(FileHeader) == 64, "FileHeader is part of the file format");
+
+struct ChunkHeader
+{
+	ChunkType type;
+	uint32_t size; // payload bytes, not counting the padding
+	uint64_t sequence; // PCM: the read's index, Spectrum: SpectrumFrame::sequence
+	int64_t timestampNs; // when the samples were read or the frame was published, since the start
+};
+static_assert(sizeof(ChunkHeader) == 24, "ChunkHeader is part of the file format");
+
+// A SpectrumFrame's raw planes and meters, followed by:
+//  float spectrum[numChannels * numOutputBins]
+//  float bands[numChannels * numBands]
+//  float rms[numChannels]
+//  float truePeak[numChannels]
+struct SpectrumChunk
+{
+	uint32_t numBands;
+	uint32_t flags; // s_onsetFlag | s_beatFlag
+	float momentaryLoudness;
+	float shortTermLoudness;
+	float onsetStrength;
+	float tempo;
+	float beatPhase;
+	float stereoCorrelation;
+	float stereoWidth;
+	float reserved;
+};
+static_assert(sizeof(SpectrumChunk) == 40, "SpectrumChunk is part of the file format");
+
+constexpr uint32_t s_onsetFlag = 1u << 0;
+constexpr uint32_t s_beatFlag = 1u << 1;
+
+// Where a spectrum chunk (its ChunkHeader) starts, so a reader can seek without scanning the whole file
+struct IndexEntry
+{
+	int64_t timestampNs;
+	uint64_t offset;
+};
+static_assert(sizeof(IndexEntry) == 16, "IndexEntry is part of the file format");
+
+// The last bytes of a file which was closed properly, too small to be mistaken for a chunk. Without it, readers scan
+// the chunks instead
+constexpr char s_trailerMagic[8] = {'G', 'A', 'Z', 'I', 'D', 'X', '\0', '\0'};
+
+struct Trailer
+{
+	char magic[8];
+	uint64_t indexOffset; // of the index chunk's ChunkHeader
+};
+static_assert(sizeof(Trailer) == 16, "Trailer is part of the file format");
+
+// Bytes a payload takes up in the file, with its padding
+constexpr size_t paddedSize(size_t size)
+{
+	return (size + 7) & ~size_t(7);
+}
+
+// Payload bytes of a spectrum chunk
+constexpr size_t spectrumChunkSize(uint32_t numChannels, uint32_t numOutputBins, uint32_t numBands)
+{
+	return sizeof(SpectrumChunk) + sizeof(float) * numChannels * (size_t(numOutputBins) + numBands + 2);
+}
+
+} // namespace Recording
+} // namespace gaz
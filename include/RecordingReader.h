@@ -0,0 +1,95 @@
+#pragma once
+
+#include "RecordingFormat.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace gaz
+{
+
+// Reads a recording written by Recorder by mapping the whole file, so chunks are used in place without copying, and
+// only the pages which are actually read are loaded. The spectra are found through the file's index, so opening even
+// a multi-hour recording is instant. Files which were cut short have no index, and are scanned up to their last
+// whole chunk instead
+class RecordingReader
+{
+public:
+	// One spectrum chunk, pointing into the mapping, valid until the reader is closed
+	struct Spectrum
+	{
+		uint64_t sequence; // SpectrumFrame::sequence
+		int64_t timestampNs; // since the start of the recording
+		const Recording::SpectrumChunk* meters;
+		const float* spectrum; // [numChannels * numOutputBins]
+		const float* bands; // [numChannels * meters->numBands]
+		const float* rms; // [numChannels]
+		const float* truePeak; // [numChannels]
+	};
+
+	RecordingReader();
+
+	~RecordingReader();
+
+	// Disable copy constructor and assignment operator, since we're managing a mapping, and it's
+	// not worth the hassle to share its ownership
+	RecordingReader(const RecordingReader&) = delete;
+	RecordingReader& operator=(const RecordingReader&) = delete;
+	// ...and move constructor, move assignment
+	RecordingReader(RecordingReader&&) = delete;
+	RecordingReader& operator=(RecordingReader&&) = delete;
+
+	// Map 'path' and find its spectra. Returns false if it isn't a recording we understand
+	bool open(const std::string& path);
+
+	void close();
+
+	bool isOpen() const { return m_data != nullptr; }
+
+	const std::string& getPath() const { return m_path; }
+
+	const Recording::FileHeader& getHeader() const { return m_header; }
+
+	size_t getNumSpectra() const { return m_numSpectra; }
+
+	// Whether the spectra were found through the file's index, rather than by scanning it
+	bool isIndexed() const { return m_scannedIndex.empty() && m_numSpectra > 0; }
+
+	// The index'th spectrum. The chunks an index points at aren't checked when it's opened, since that would read the
+	// whole file, so each is checked here instead: returns false if it's malformed or runs past the spectra
+	bool getSpectrum(size_t index, Spectrum& spectrum) const;
+
+	// The first spectrum at or after 'timestampNs', or getNumSpectra() if there isn't one
+	size_t seek(int64_t timestampNs) const;
+
+	int64_t getTimestamp(size_t index) const { return m_index[index].timestampNs; }
+
+	// Timestamp of the last spectrum, 0 without any
+	int64_t getDurationNs() const { return m_numSpectra > 0 ? m_index[m_numSpectra - 1].timestampNs : 0; }
+
+private:
+	// The index at the end of the file, if it's there and consistent
+	bool findIndex();
+
+	// Otherwise walk the chunks to build one
+	void scanIndex();
+
+	std::string m_path;
+
+	const char* m_data;
+	size_t m_size;
+
+	Recording::FileHeader m_header;
+
+	// Either the file's own index, in the mapping, or m_scannedIndex
+	const Recording::IndexEntry* m_index;
+	size_t m_numSpectra;
+
+	// Where the chunks end, the index chunk if there is one
+	uint64_t m_chunksEnd;
+	std::vector<Recording::IndexEntry> m_scannedIndex;
+};
+
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace gaz
+{
+
+// Bounded, lock-free single-producer/single-consumer ring of preallocated elements.
+//
+// The producer fills a slot in place between beginWrite() and endWrite(), and endWrite() publishes it to the
+// consumer with release semantics. The consumer borrows published slots with acquire(), without copying them.
+// The slot returned by acquire() remains owned by the consumer until the next call to acquire(), so it can be
+// read for as long as needed (e.g. uploaded, then plotted later in the same frame).
+//
+// The producer never waits on the consumer: if the ring is full, beginWrite() hands out a private scratch slot
+// instead, and endWrite() discards it and counts an overrun.
+template <typename T>
+class SPSCRing
+{
+public:
+	explicit SPSCRing(size_t capacity) :
+		m_slots(roundUpToPowerOfTwo(capacity) + 1), // + 1 for the producer's scratch slot
+		m_mask{m_slots.size() - 2},
+		m_head{0},
+		m_tail{0},
+		m_writeIndex{0},
+		m_writingScratch{false},
+		m_readIndex{0},
+		m_overruns{0}
+	{
+	}
+
+	// Disable copy and move, since the slots may be borrowed by both threads
+	SPSCRing(const SPSCRing&) = delete;
+	SPSCRing& operator=(const SPSCRing&) = delete;
+	SPSCRing(SPSCRing&&) = delete;
+	SPSCRing& operator=(SPSCRing&&) = delete;
+
+	// Visit every slot (including the scratch slot), used to preallocate them up front.
+	// Only safe to call whilst neither the producer or the consumer are active
+	template <typename Fn>
+	void forEachSlot(Fn&& fn)
+	{
+		for (auto& slot : m_slots)
+		{
+			fn(slot);
+		}
+	}
+
+	size_t capacity() const { return m_mask + 1; }
+
+	// Producer: get the next slot to fill, this never returns nullptr and never blocks
+	T* beginWrite()
+	{
+		// Only the producer writes m_head, so relaxed is fine here
+		m_writeIndex = m_head.load(std::memory_order_relaxed);
+		// Acquire, so that the consumer's reads of the slot happen before we overwrite it
+		const uint64_t tail = m_tail.load(std::memory_order_acquire);
+		m_writingScratch = (m_writeIndex - tail) > m_mask;
+
+		return m_writingScratch ? &m_slots.back() : &m_slots[m_writeIndex & m_mask];
+	}
+
+	// Producer: whether every slot is published or borrowed, so beginWrite() would hand out the scratch slot.
+	// Lets a producer which would rather wait than drop a slot check first
+	bool full() const
+	{
+		return (m_head.load(std::memory_order_relaxed) - m_tail.load(std::memory_order_acquire)) > m_mask;
+	}
+
+	// Producer: publish the slot returned by beginWrite(), or discard it if the ring was full
+	void endWrite()
+	{
+		if (m_writingScratch)
+		{
+			m_overruns.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		// Release, so that the consumer sees the contents of the slot once it sees the new head
+		m_head.store(m_writeIndex + 1, std::memory_order_release);
+	}
+
+	// Consumer: borrow the oldest published slot that hasn't been acquired yet, returns nullptr if there's
+	// nothing new. Releases the previously acquired slot back to the producer
+	const T* acquire()
+	{
+		const uint64_t head = m_head.load(std::memory_order_acquire);
+		if (m_readIndex == head)
+		{
+			return nullptr;
+		}
+
+		// Hand the previously borrowed slot back to the producer
+		m_tail.store(m_readIndex, std::memory_order_release);
+
+		return &m_slots[m_readIndex++ & m_mask];
+	}
+
+	// Consumer: the slot returned by the last successful acquire(), or nullptr if nothing has been acquired
+	const T* latest() const
+	{
+		return m_readIndex != 0 ? &m_slots[(m_readIndex - 1) & m_mask] : nullptr;
+	}
+
+	// Consumer: the number of published slots waiting to be acquired
+	size_t available() const
+	{
+		return m_head.load(std::memory_order_acquire) - m_readIndex;
+	}
+
+	// The number of slots the producer had to discard because the consumer wasn't keeping up
+	uint64_t getOverrunCount() const { return m_overruns.load(std::memory_order_relaxed); }
+
+private:
+	static size_t roundUpToPowerOfTwo(size_t x)
+	{
+		size_t result = 1;
+		while (result < x)
+		{
+			result <<= 1;
+		}
+		return result;
+	}
+
+	// The last slot is the producer's scratch slot, and is never published
+	std::vector<T> m_slots;
+	const size_t m_mask;
+
+	// Keep the indices written by each thread on separate cache lines, to avoid false sharing
+
+	// Number of slots published by the producer
+	alignas(64) std::atomic<uint64_t> m_head;
+
+	// Number of slots released by the consumer
+	alignas(64) std::atomic<uint64_t> m_tail;
+
+	// Producer-only state
+	alignas(64) uint64_t m_writeIndex;
+	bool m_writingScratch;
+
+	// Consumer-only state, the number of slots acquired
+	alignas(64) uint64_t m_readIndex;
+
+	alignas(64) std::atomic<uint64_t> m_overruns;
+};
+
+}
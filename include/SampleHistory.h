@@ -0,0 +1,141 @@
+#pragma once
+
+#include "DSP/Deinterleave.h"
+#include "DSP/PCM.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace gaz
+{
+
+// The last 'windowSize' frames of every channel, as planar float ring buffers which all advance together. Incoming
+// interleaved PCM is converted and deinterleaved straight into the rings, and each DFT window is copied out of them,
+// so this is the engine's per-sample hot path.
+//
+// create() picks a FixedSampleHistory, with the channel count, window size and format baked in at compile time,
+// for the configurations we deploy, and the runtime-sized DynamicSampleHistory for everything else
+// The per-window kernels after the DFT aren't specialised the same way: they're within 2% as fast with their bin
+// counts at runtime as with them compiled in, since the fixed cost they had was their tails (see DSP_SCALAR_TAIL)
+class SampleHistory
+{
+public:
+	virtual ~SampleHistory() = default;
+
+	// Append 'numFrames' interleaved frames, which can wrap around the rings
+	virtual void push(const char* frames, size_t numFrames) = 0;
+
+	// Copy a channel's window into 'out', oldest sample first
+	virtual void copyWindow(unsigned int channel, float* out) const = 0;
+
+	// Back to a window of silence
+	virtual void clear() = 0;
+
+	// Whether the loops are specialised for this configuration
+	virtual bool isSpecialised() const = 0;
+
+	static std::unique_ptr<SampleHistory> create(
+		unsigned int numChannels,
+		unsigned int windowSize,
+		DSP::SampleFormat format
+	);
+};
+
+class DynamicSampleHistory final : public SampleHistory
+{
+public:
+	DynamicSampleHistory(unsigned int numChannels, unsigned int windowSize, DSP::SampleFormat format);
+
+	void push(const char* frames, size_t numFrames) override;
+
+	void copyWindow(unsigned int channel, float* out) const override;
+
+	void clear() override;
+
+	bool isSpecialised() const override { return false; }
+
+private:
+	const unsigned int m_numChannels;
+	const unsigned int m_windowSize;
+	const DSP::SampleFormat m_format;
+	const size_t m_frameSize;
+
+	// [numChannels * windowSize], the oldest sample of each channel is at m_writeIndex
+	std::vector<float> m_samples;
+	unsigned int m_writeIndex;
+
+	// Where each channel's next samples are written, preallocated for deinterleaving
+	std::vector<float*> m_writePointers;
+};
+
+// Every size is a compile time constant, so the storage is inline and aligned, the channel loops unroll, and the
+// conversion is the kernel for 'Format' rather than a switch on it
+template <unsigned int NumChannels, unsigned int WindowSize, DSP::SampleFormat Format>
+class FixedSampleHistory final : public SampleHistory
+{
+	static_assert(NumChannels > 0, "FixedSampleHistory needs at least one channel");
+	static_assert(WindowSize > 0 && (WindowSize & (WindowSize - 1)) == 0, "FixedSampleHistory needs a power of two");
+
+public:
+	static constexpr size_t s_frameSize = NumChannels * DSP::bytesPerSample(Format);
+
+	FixedSampleHistory() :
+		m_channels{},
+		m_writeIndex{0}
+	{
+	}
+
+	void push(const char* frames, size_t numFrames) override
+	{
+		while (numFrames > 0)
+		{
+			// Stop where the rings wrap around
+			const size_t count = std::min<size_t>(numFrames, WindowSize - m_writeIndex);
+
+			std::array<float*, NumChannels> writePointers;
+			for (unsigned int channel = 0; channel < NumChannels; ++channel)
+			{
+				writePointers[channel] = &m_channels[channel].samples[m_writeIndex];
+			}
+			DSP::PCM::deinterleave<typename DSP::PCM::FormatOf<Format>::Type, NumChannels>(
+				frames, NumChannels, count, writePointers.data());
+
+			frames += count * s_frameSize;
+			numFrames -= count;
+			m_writeIndex = (m_writeIndex + count) & (WindowSize - 1);
+		}
+	}
+
+	void copyWindow(unsigned int channel, float* out) const override
+	{
+		const auto& samples = m_channels[channel].samples;
+		std::copy(samples.begin() + m_writeIndex, samples.end(), out);
+		std::copy(samples.begin(), samples.begin() + m_writeIndex, out + (WindowSize - m_writeIndex));
+	}
+
+	void clear() override
+	{
+		for (auto& channel : m_channels)
+		{
+			channel.samples.fill(0.0f);
+		}
+		m_writeIndex = 0;
+	}
+
+	bool isSpecialised() const override { return true; }
+
+private:
+	// Each channel starts on its own cache line
+	struct alignas(64) Channel
+	{
+		std::array<float, WindowSize> samples;
+	};
+
+	std::array<Channel, NumChannels> m_channels;
+	size_t m_writeIndex;
+};
+
+}
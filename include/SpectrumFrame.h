@@ -0,0 +1,107 @@
+#pragma once
+
+#include "DSP/Descriptors.h"
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace gaz
+{
+
+// Which version of a frame's spectrum and bands to read
+enum struct SpectrumPlane
+{
+	Raw, // this frame's levels
+	Smoothed, // exponential attack / release across frames
+	Peak, // held peaks, falling at a fixed rate
+	Average // long-term average
+};
+
+// One block of analysis output, published by the recording thread to the renderer through an SPSCRing.
+// Frames are preallocated once in AudioEngine::init, and filled in place, so nothing here should be resized
+// on the recording thread
+struct SpectrumFrame
+{
+	// Monotonically increasing index of the block this frame was produced from, gaps in the sequence seen by the
+	// consumer mean that frames were dropped
+	uint64_t sequence = 0;
+
+	// Monotonic times, for the latency stats (see AudioEngine::getLatencyStats): when the newest sample in the
+	// window was captured, less the device's reported latency, when the analysis finished, and when the frame was
+	// published
+	std::chrono::steady_clock::time_point captureTime{};
+	std::chrono::steady_clock::time_point analysedTime{};
+	std::chrono::steady_clock::time_point publishedTime{};
+
+	// dB amplitude of each output bin (see AudioEngine::getNumOutputBins), relative to full scale and optionally
+	// weighted (see AudioEngine::setFrequencyWeighting). Each channel's bins are stored contiguously
+	// [numChannels * numBins]
+	std::vector<float> spectrum;
+
+	// dB level of each frequency band, see AudioEngine::setSpectrumBucketCount. Each channel's bands are stored
+	// contiguously [numChannels * numBands], the vector is sized for the largest supported band count
+	std::vector<float> bands;
+	unsigned int numBands = 0;
+
+	// Temporal smoothing of 'spectrum' and 'bands' (see AudioEngine::setSmoothing), laid out the same way
+	std::vector<float> smoothedSpectrum;
+	std::vector<float> peakSpectrum;
+	std::vector<float> averageSpectrum;
+	std::vector<float> smoothedBands;
+	std::vector<float> peakBands;
+	std::vector<float> averageBands;
+
+	// Level meters, from every sample rather than just the DFT window (see DSP::LevelMeter), clamped to the decibel
+	// floor. Loudness in LUFS, K-weighted over all channels, over the last 400ms and 3s
+	float momentaryLoudness = 0.0f;
+	float shortTermLoudness = 0.0f;
+
+	// dBFS of each channel over the last 400ms, and dBTP (4x oversampled peak) of the samples since the last frame
+	std::vector<float> rms;
+	std::vector<float> truePeak;
+
+	// Shape of each channel's linear DFT spectrum, unweighted, see DSP::SpectralDescriptors
+	std::vector<DSP::SpectralDescriptors> descriptors;
+
+	// Stereo image of the front left / right channels in each output bin, averaged over a few hundred ms, see
+	// DSP::StereoPlanes. Empty for mono. The correlation is over the whole spectrum, 1 for mono, -1 out of phase,
+	// and the width is the side energy over mid + side
+	std::vector<float> stereoCoherence;
+	std::vector<float> stereoPhase; // radians, left relative to right
+	std::vector<float> stereoSide;
+	float stereoCorrelation = 0.0f;
+	float stereoWidth = 0.0f;
+
+	// Rhythm of all channels together, see DSP::OnsetDetector and DSP::TempoTracker. The onset strength is how far
+	// the spectral flux (dB) is above its adaptive threshold, 0 when it isn't
+	float onsetStrength = 0.0f;
+	bool onset = false;
+	float tempo = 0.0f; // BPM, 0 until it's been found
+	float beatPhase = 0.0f; // [0, 1), 0 on the beat
+	bool beat = false;
+
+	const std::vector<float>& getSpectrum(SpectrumPlane plane) const
+	{
+		switch (plane)
+		{
+			case SpectrumPlane::Smoothed: return smoothedSpectrum;
+			case SpectrumPlane::Peak: return peakSpectrum;
+			case SpectrumPlane::Average: return averageSpectrum;
+			default: return spectrum;
+		}
+	}
+
+	const std::vector<float>& getBands(SpectrumPlane plane) const
+	{
+		switch (plane)
+		{
+			case SpectrumPlane::Smoothed: return smoothedBands;
+			case SpectrumPlane::Peak: return peakBands;
+			case SpectrumPlane::Average: return averageBands;
+			default: return bands;
+		}
+	}
+};
+
+}
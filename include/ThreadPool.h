@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace gaz
+{
+
+// Small fixed pool of worker threads for fork-join parallel loops, e.g. one task per channel.
+//
+// parallelFor() splits the index range evenly between the workers and the calling thread, which joins in rather
+// than sitting idle. Each participant works through its own share from the front, and once it runs out it steals
+// indices from the back of the others' shares, so uneven tasks still finish together.
+// Each share is a pair of 32 bit indices packed into one atomic, so taking or stealing a task is a single CAS
+class ThreadPool
+{
+public:
+	// 'numThreads' counts the calling thread, so 1 runs everything inline. 0 uses the hardware concurrency
+	explicit ThreadPool(unsigned int numThreads = 0);
+
+	~ThreadPool();
+
+	// Disable copy and move, the workers hold a pointer to the pool
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	ThreadPool(ThreadPool&&) = delete;
+	ThreadPool& operator=(ThreadPool&&) = delete;
+
+	// The number of threads that run tasks, including the caller of parallelFor()
+	unsigned int getNumThreads() const { return static_cast<unsigned int>(m_workers.size()) + 1; }
+
+	// Call fn(i) for every i in [0, count), and return once they've all finished. Only one thread may call this
+	// at a time, and 'fn' must not call it either
+	template <typename Fn>
+	void parallelFor(size_t count, Fn&& fn)
+	{
+		if (count == 1 || m_workers.empty())
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				fn(i);
+			}
+			return;
+		}
+
+		run(count, [](void* context, size_t i) { (*static_cast<std::remove_reference_t<Fn>*>(context))(i); }, &fn);
+	}
+
+private:
+	typedef void (*Task)(void* context, size_t index);
+
+	// A participant's share of the indices, [begin, end) packed as (end << 32) | begin
+	struct alignas(64) Share
+	{
+		std::atomic<uint64_t> range{0};
+	};
+
+	void run(size_t count, Task task, void* context);
+
+	void workerLoop(unsigned int participant);
+
+	// Run tasks from our own share, then steal from the others until there's nothing left
+	void work(unsigned int participant);
+
+	// Take the next index from the front of a share, or the last one from the back when stealing
+	bool takeFront(Share& share, size_t& index);
+	bool takeBack(Share& share, size_t& index);
+
+	std::vector<std::thread> m_workers;
+
+	// One per participant, the calling thread is the last one
+	std::unique_ptr<Share[]> m_shares;
+
+	// The current job, published to the workers by bumping m_generation
+	Task m_task;
+	void* m_context;
+	alignas(64) std::atomic<size_t> m_remaining;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	uint64_t m_generation;
+	bool m_stopping;
+};
+
+}
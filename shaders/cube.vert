@@ -8,6 +8,18 @@ uniform sampler3D dftTexture;
 uniform uint dftLastIndex;
 uniform uint dftSampleCount;
 
+// dB levels mapped to amplitudes of 0 and 1
+uniform vec2 decibelRange;
+
+// Each channel's DSP::SpectralDescriptors, updated once per render frame, see GLAudioVisApp::s_maxDescriptorChannels
+// [2 * channel]: centroid (Hz), bandwidth (Hz), rolloff (Hz), flatness
+// [2 * channel + 1]: crest (dB), flux, unused, unused
+const uint maxDescriptorChannels = 32u;
+layout(std140) uniform SpectralDescriptors
+{
+	vec4 descriptors[2u * maxDescriptorChannels];
+};
+
 out vec3 xyz;
 
 out float amplitude;
@@ -36,7 +48,7 @@ void main()
 	// uvw.y = pow(uvw.y, 8.0f);
 	// uvw.y = min(uvw.y * 100000.0f, 1.0f);
 
-	amplitude = texture(dftTexture, uvw).r / 24.0f;
+	amplitude = (texture(dftTexture, uvw).r - decibelRange.x) / (decibelRange.y - decibelRange.x);
 	// amplitude = 1.0f;
 
 	// effectively 'discard' the point if the amplitude is too small
@@ -52,5 +64,9 @@ void main()
 
 		gl_Position = transformedPos;
 		gl_PointSize = 35.0f / gl_Position.w; // shitty size attenuation
+
+		// swell each channel's points with its spectral flux, so they pulse on onsets
+		uint channel = min(uint(uvw.y * float(textureSize(dftTexture, 0).y)), maxDescriptorChannels - 1u);
+		gl_PointSize *= 1.0f + 0.5f * descriptors[2u * channel + 1u].y;
 	}
 }
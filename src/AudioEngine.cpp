@@ -1,25 +1,70 @@
 #include "AudioEngine.h"
 
-#include <imgui/imgui.h>
+#include "DSP/Decibels.h"
+#include "DSP/Deinterleave.h"
+#include "Profiler.h"
 
-#include <pulse/error.h>
-
-#include <cassert>
-#include <cmath> // log10
+#include <algorithm>
+#include <cmath>
 
 namespace
 {
-	constexpr float minBucketFreqLog = log10(20.0f);
-	constexpr float maxBucketFreqLog = log10(20000.0f);
+	// Range covered by the spectrum bands, roughly human hearing
+	constexpr float minBandFrequency = 20.0f;
+	constexpr float maxBandFrequency = 20000.0f;
 
-	// float audioProcessingTime1 = 0.0f;
-	// float audioProcessingTime2 = 0.0f;
-	// float audioProcessingTime3 = 0.0f;
+	// BS.1770 weights the surround channels by +1.5dB, and leaves out the LFE channel
+	float loudnessWeight(pa_channel_position_t position)
+	{
+		switch (position)
+		{
+			case PA_CHANNEL_POSITION_LFE:
+				return 0.0f;
+			case PA_CHANNEL_POSITION_REAR_LEFT:
+			case PA_CHANNEL_POSITION_REAR_RIGHT:
+			case PA_CHANNEL_POSITION_SIDE_LEFT:
+			case PA_CHANNEL_POSITION_SIDE_RIGHT:
+				return 1.41f;
+			default:
+				return 1.0f;
+		}
+	}
 
-	// constexpr float minBucketFreqLog = log10(20.0f);
-	// constexpr float maxBucketFreqLog = log10(20000.0f);
+	// Averaging time of the stereo analysis, about the integration time of a correlation meter
+	constexpr float stereoSeconds = 0.3f;
+
+	// The front left / right pair, or the first two channels if the map doesn't have one
+	std::array<unsigned int, 2> stereoPair(const pa_channel_map& map)
+	{
+		std::array<int, 2> pair{-1, -1};
+		for (unsigned int channel = 0; channel < map.channels; ++channel)
+		{
+			if (map.map[channel] == PA_CHANNEL_POSITION_FRONT_LEFT && pair[0] < 0)
+			{
+				pair[0] = channel;
+			}
+			else if (map.map[channel] == PA_CHANNEL_POSITION_FRONT_RIGHT && pair[1] < 0)
+			{
+				pair[1] = channel;
+			}
+		}
+
+		if (pair[0] < 0 || pair[1] < 0)
+		{
+			return {0, 1};
+		}
+		return {static_cast<unsigned int>(pair[0]), static_cast<unsigned int>(pair[1])};
+	}
 
-	// constexpr float freqBuckets[] = { 20.0f, 140.0f, 400.0f, 2600.0f, 5200.0f, std::numeric_limits<float>::max() };
+	float amplitudeToDecibels(float amplitude, float floorDb)
+	{
+		return amplitude > 0.0f ? std::max(20.0f * std::log10(amplitude), floorDb) : floorDb;
+	}
+
+	float powerToDecibels(double power, float floorDb)
+	{
+		return power > 0.0 ? std::max(static_cast<float>(10.0 * std::log10(power)), floorDb) : floorDb;
+	}
 };
 
 using namespace gaz;
@@ -28,24 +73,20 @@ AudioEngine::~AudioEngine()
 {
 	fmt::print("~AudioEngine()\n");
 
-	if (m_source != nullptr)
+	// make sure the recording and capture threads are closed before the source is
+	// TODO: this is messy, maybe use async & future?
+	m_recordingActive = false;
+	signalBlockRing();
+	if (m_recordingThread != nullptr && m_recordingThread->joinable())
 	{
-		// make sure the recording thread is closed
-		// TODO: this is messy, maybe use async & future?
-		if (m_recordingActive)
-		{
-			m_recordingActive = false;
-			m_recordingThread->join();
-		}
-
-		pa_simple_free(m_source);
+		m_recordingThread->join();
 	}
-
-	for (const auto &processedAudioData : m_fftData)
+	if (m_captureThread != nullptr && m_captureThread->joinable())
 	{
-		fftw_free(processedAudioData.fftwOutput);
-		fftw_destroy_plan(processedAudioData.fftwPlan);
+		m_captureThread->join();
 	}
+
+	closeRecorder();
 }
 
 bool AudioEngine::init()
@@ -58,73 +99,223 @@ bool AudioEngine::init()
 		.channels = m_samplingSettings.numChannels
 	};
 
-	const unsigned int bufferSize = pa_frame_size(&sampleFormat) * m_samplingSettings.numSamples;
+	// Samples are converted to float as they're deinterleaved, so any format we can convert will do
+	const auto dspFormat = toDSPSampleFormat(m_samplingSettings.sampleFormat);
+	if (!dspFormat.has_value())
+	{
+		fmt::print(
+			"AudioEngine::init: Unsupported sample format {}\n",
+			pa_sample_format_to_string(m_samplingSettings.sampleFormat)
+		);
+		return false;
+	}
+	m_sampleFormat = *dspFormat;
 
-	pa_buffer_attr bufferAttributes
+	if (m_samplingSettings.numChannels == 0 || m_samplingSettings.numChannels > PA_CHANNELS_MAX)
 	{
-		.maxlength = bufferSize, // max length of the buffer in bytes
-		.tlength = (uint32_t)-1, // target buffer length (bytes) ?  playback only?
-		.prebuf = (uint32_t)-1, // prebuffering (playback only)
-		.minreq = (uint32_t)-1, // minimum request (playback only
-		// fragment size (bytes?) (recording only)
-		// .fragsize = bufferSize // works, varying bocking times
-		.fragsize = 0 // much more consistent
-	};
+		fmt::print(
+			"AudioEngine::init: Unsupported channel count {}, must be 1 to {}\n",
+			m_samplingSettings.numChannels,
+			PA_CHANNELS_MAX
+		);
+		return false;
+	}
+
+	// The layout the PulseAudio sources record with, standard positions for up to 6 channels, then auxiliary ones
+	pa_channel_map_init_extend(&m_channelMap, m_samplingSettings.numChannels, PA_CHANNEL_MAP_DEFAULT);
+
+	const unsigned int framesPerRead = m_samplingSettings.getFramesPerRead();
+	const unsigned int bufferSize = pa_frame_size(&sampleFormat) * framesPerRead;
+
+	if (m_source == nullptr || !m_source->open(sampleFormat, framesPerRead))
+	{
+		fmt::print("AudioEngine::init: Failed to open audio source\n");
+		return false;
+	}
+
+	fmt::print("AudioEngine::init: Recording from {}\n", m_source->getName());
+
+	// resize the blocks to accomodate for the read size (bytes)
+	m_blockRing.forEachSlot([bufferSize](CapturedBlock& block)
+	{
+		block.samples.resize(bufferSize);
+	});
+	{
+		std::lock_guard<std::mutex> lock(m_lastBlockMutex);
+		m_lastBlock.clear();
+		m_lastBlock.reserve(bufferSize);
+	}
+	fmt::print("buffer size: {}\n", bufferSize);
+	fmt::print(
+		"DFT window: {} frames, hop: {} frames ({:.1f} updates/s)\n",
+		m_samplingSettings.numSamples,
+		m_samplingSettings.getHopSize(),
+		static_cast<float>(m_samplingSettings.sampleRate) / m_samplingSettings.getHopSize()
+	);
 
-	// TODO: command line option
-	// const std::string source = "alsa_input.pci-0000_00_1b.0.analog-stereo";
-	const std::string source = "alsa_output.pci-0000_00_1b.0.analog-stereo.monitor";
-
-	// connect to the PulseAudio server
-	int error;
-	m_source = pa_simple_new(
-		nullptr,			// Use the default server
-		"GLAudioVisApp",	// Our application's name
-		PA_STREAM_RECORD,	// Connection Mode
-		source.c_str(),		// Use the specified device
-		"Record",			// Description of our stream
-		&sampleFormat,		// Our sample format
-		nullptr,			// Use default channel map
-		&bufferAttributes,	// Use buffering attributes
-		&error				// Error code
+	// Start with a window of silence
+	m_history = SampleHistory::create(m_samplingSettings.numChannels, m_samplingSettings.numSamples, m_sampleFormat);
+	fmt::print(
+		"Sample history: {}\n",
+		m_history->isSpecialised() ? "specialised for this configuration" : "runtime sized"
 	);
 
-	if (m_source == nullptr)
+	// The kernel is computed with a DFT of its own, so it goes before the batch's, which may go on to hold fftw's
+	// planner in the background
+	m_numOutputBins = m_samplingSettings.numSamples / 2;
+	if (m_samplingSettings.analysis == Analysis::ConstantQ)
 	{
-		// fprintf(stderr, __FILE__": pa_simple_read() failed: %s\n", pa_strerror(error));
+		m_constantQ = std::make_unique<DSP::ConstantQKernel>(
+			m_samplingSettings.sampleRate,
+			m_samplingSettings.numSamples,
+			m_samplingSettings.minFrequency,
+			maxBandFrequency,
+			m_samplingSettings.binsPerOctave
+		);
+		if (m_constantQ->getNumBins() == 0)
+		{
+			fmt::print("AudioEngine::init: DFT window is too short for a constant-Q analysis\n");
+			return false;
+		}
+
+		m_numOutputBins = m_constantQ->getNumBins();
+		m_constantQOutput.resize(m_samplingSettings.numChannels * 2 * m_numOutputBins);
+
 		fmt::print(
-			"AudioEngine::initPulseAudioSource: Failed to connect to audio source '{}', error: {}\n",
-			source.c_str(),
-			pa_strerror(error)
+			"Constant-Q: {} bins, {} per octave, {:.1f}Hz to {:.1f}Hz\n",
+			m_numOutputBins,
+			m_samplingSettings.binsPerOctave,
+			m_constantQ->getMinFrequency(),
+			m_constantQ->getBinFrequency(m_numOutputBins - 1)
 		);
+	}
+
+	// More threads than channels would have nothing to do
+	const unsigned int numThreads = std::min<unsigned int>(
+		m_samplingSettings.numChannels,
+		m_samplingSettings.numWorkerThreads != 0 ?
+			m_samplingSettings.numWorkerThreads :
+			std::max(std::thread::hardware_concurrency(), 1u)
+	);
+	m_threadPool = std::make_unique<ThreadPool>(numThreads);
+
+	// Plan a single precision DFT for all channels, split into a group for each thread
+	m_fft = std::make_unique<DSP::FFTBatch>(
+		m_samplingSettings.numSamples,
+		m_samplingSettings.numChannels,
+		m_samplingSettings.upgradePlanInBackground ? DSP::FFTBatch::Planning::Upgrade : DSP::FFTBatch::Planning::Patient,
+		m_threadPool->getNumThreads()
+	);
+	if (!m_fft->isValid())
+	{
+		fmt::print("AudioEngine::init: Failed to plan the DFT\n");
 		return false;
 	}
 
-	// resize the buffer to accomodate for the read size (bytes)
-	m_sampleBuffer.resize(bufferSize);
-	fmt::print("buffer size: {}\n", bufferSize);
+	// Without a window, a full scale sinusoid on a bin has a magnitude of numSamples / 2, and the constant-Q kernels
+	// are scaled like a Hann window, which halves it
+	const float dftBinCalibration = -20.0f * std::log10(m_samplingSettings.numSamples / 2.0f);
+	const float outputBinCalibration = m_constantQ != nullptr ?
+		-20.0f * std::log10(m_samplingSettings.numSamples / 4.0f) :
+		dftBinCalibration;
 
-	// Since we need to keep the references passed to fftwPlan intact, default construct 'numchannels' elements,
-	// then fill them
-	m_fftData.resize(m_samplingSettings.numChannels);
-	for (size_t i = 0; i < m_samplingSettings.numChannels; ++i)
-	{
-		FFTData& data = m_fftData[i];
-		data.channelID = Channel(i);
-		// Prepare data for fftw
-		data.fftwInput.resize(m_samplingSettings.numSamples);
-		data.fftwOutput = fftw_alloc_complex(sizeof(fftw_complex) * m_samplingSettings.numSamples);
-		data.fftwPlan = fftw_plan_dft_r2c_1d(
-			m_samplingSettings.numSamples, data.fftwInput.data(), data.fftwOutput, FFTW_PATIENT | FFTW_DESTROY_INPUT
-		);
+	const unsigned int numDFTBins = m_samplingSettings.numSamples / 2;
+	const float hzPerDFTBin = static_cast<float>(m_samplingSettings.sampleRate) / m_samplingSettings.numSamples;
+	for (size_t weightingIndex = 0; weightingIndex < s_numWeightings; ++weightingIndex)
+	{
+		const auto weighting = static_cast<DSP::FrequencyWeighting>(weightingIndex);
 
-		// Allocate vectors that are used by ImGui / OpenGL
-		data.dftOutputRaw.resize(m_samplingSettings.numSamples / 2);
-		data.spectrumBuckets.resize(m_numSpectrumBuckets);
+		m_binOffsets[weightingIndex].resize(m_numOutputBins);
+		for (unsigned int bin = 0; bin < m_numOutputBins; ++bin)
+		{
+			const float frequency = m_constantQ != nullptr ? m_constantQ->getBinFrequency(bin) : bin * hzPerDFTBin;
+			m_binOffsets[weightingIndex][bin] =
+				outputBinCalibration + DSP::weightingDecibels(weighting, frequency, m_samplingSettings.sampleRate);
+		}
+
+		m_dftBinGains[weightingIndex].resize(numDFTBins);
+		for (unsigned int bin = 0; bin < numDFTBins; ++bin)
+		{
+			const float gainDb =
+				dftBinCalibration + DSP::weightingDecibels(weighting, bin * hzPerDFTBin, m_samplingSettings.sampleRate);
+			m_dftBinGains[weightingIndex][bin] = std::pow(10.0f, gainDb / 10.0f);
+		}
 	}
 
-	// this is both channels, but half of the samples since only half are usable
-	m_dftOutputCombined.resize(m_samplingSettings.numSamples);
+	// The recording thread isn't running yet, so the first band matrix can go straight in
+	m_bandMatrix = std::make_unique<DSP::BandMatrix>(buildBandMatrix());
+	m_bandPower.resize(m_samplingSettings.numChannels * s_maxSpectrumBuckets);
+	m_descriptorPower.assign(m_samplingSettings.numChannels * numDFTBins, 0.0f);
+
+	// The meters see the samples which are new in each window, which is all of them unless the hop skips some
+	const unsigned int meterBlockSize = std::min(m_samplingSettings.getHopSize(), m_samplingSettings.numSamples);
+	m_levelMeters.clear();
+	m_loudnessWeights.clear();
+	for (unsigned int channel = 0; channel < m_samplingSettings.numChannels; ++channel)
+	{
+		m_levelMeters.emplace_back(m_samplingSettings.sampleRate, meterBlockSize);
+		m_loudnessWeights.push_back(loudnessWeight(m_channelMap.map[channel]));
+	}
+
+	fmt::print(
+		"Analysis: {} thread(s), {} DFT group(s) of {} channel(s)\n",
+		m_threadPool->getNumThreads(),
+		m_fft->getNumGroups(),
+		m_fft->getChannelsPerGroup()
+	);
+
+	const float framesPerSecond = static_cast<float>(m_samplingSettings.sampleRate) / m_samplingSettings.getHopSize();
+	m_onsetDetector = std::make_unique<DSP::OnsetDetector>(
+		framesPerSecond,
+		m_samplingSettings.numChannels * s_maxSpectrumBuckets
+	);
+	m_tempoTracker = std::make_unique<DSP::TempoTracker>(framesPerSecond);
+
+	// Stereo image of the front pair, over the same bins as the spectrum
+	m_stereoAnalyser.reset();
+	if (m_samplingSettings.numChannels >= 2)
+	{
+		m_stereoChannels = stereoPair(m_channelMap);
+		m_stereoAnalyser = std::make_unique<DSP::StereoAnalyser>(
+			m_numOutputBins,
+			DSP::smoothingCoefficient(stereoSeconds, framesPerSecond)
+		);
+	}
+
+	// Preallocate the published frames, each holds all channels
+	const size_t combinedSize = m_samplingSettings.numChannels * m_numOutputBins;
+	const size_t bandsSize = m_samplingSettings.numChannels * s_maxSpectrumBuckets;
+	const unsigned int numChannels = m_samplingSettings.numChannels;
+	const size_t stereoSize = m_stereoAnalyser != nullptr ? m_numOutputBins : 0;
+	m_frameRing.forEachSlot([combinedSize, bandsSize, numChannels, stereoSize](SpectrumFrame& frame)
+	{
+		frame.rms.resize(numChannels);
+		frame.truePeak.resize(numChannels);
+		frame.descriptors.resize(numChannels);
+		frame.stereoCoherence.resize(stereoSize);
+		frame.stereoPhase.resize(stereoSize);
+		frame.stereoSide.resize(stereoSize);
+		frame.spectrum.resize(combinedSize);
+		frame.bands.resize(bandsSize);
+		for (auto* plane : {&frame.smoothedSpectrum, &frame.peakSpectrum, &frame.averageSpectrum})
+		{
+			plane->resize(combinedSize);
+		}
+		for (auto* plane : {&frame.smoothedBands, &frame.peakBands, &frame.averageBands})
+		{
+			plane->resize(bandsSize);
+		}
+	});
+
+	// Smoothing state, three planes of everything above
+	m_spectrumSmoothing.resize(3 * combinedSize);
+	m_bandSmoothing.resize(3 * bandsSize);
+	m_resetSpectrumSmoothing = true;
+	m_resetBandSmoothing = true;
+	setSmoothing(m_smoothingSettings);
+
+	// Last, since it holds fftw's planner until the patient plan is made
+	m_fft->startUpgrade();
 
 	return true;
 }
@@ -132,232 +323,555 @@ bool AudioEngine::init()
 void AudioEngine::toggleRecording()
 {
 	m_recordingActive = !m_recordingActive;
+	signalBlockRing();
+
+	// The threads may have already stopped themselves (e.g. at the end of a file), so always join before restarting
+	if (m_recordingThread != nullptr && m_recordingThread->joinable())
+	{
+		m_recordingThread->join();
+	}
+	if (m_captureThread != nullptr && m_captureThread->joinable())
+	{
+		m_captureThread->join();
+	}
+
+	// Get what's been recorded so far onto the disk while we're paused
+	if (!m_recordingActive && m_recorder != nullptr)
+	{
+		m_recorder->flush();
+	}
 
 	if (m_recordingActive)
 	{
+		m_captureFinished = false;
+		m_captureThread = std::make_unique<std::thread>(&AudioEngine::captureBlocks, this);
 		m_recordingThread = std::make_unique<std::thread>(&AudioEngine::startRecording, this);
 	}
-	else
+}
+
+uint64_t AudioEngine::analyseOffline(const FrameConsumer& consume)
+{
+	if (m_recordingActive || m_history == nullptr)
 	{
-		m_recordingThread->join();
+		fmt::print("AudioEngine::analyseOffline: Recording must be stopped, after init()\n");
+		return 0;
+	}
+
+	// There's no capture thread to overlap with, so one block is enough
+	std::vector<char> block(
+		m_samplingSettings.getFramesPerRead() * m_samplingSettings.numChannels * DSP::bytesPerSample(m_sampleFormat)
+	);
+
+	const uint64_t firstFrame = m_frameSequence;
+	m_frameConsumer = &consume;
+	while (m_source->read(block.data(), block.size()))
+	{
+		if (m_recorder != nullptr)
+		{
+			m_recorder->writePCM(block.data(), block.size());
+		}
+
+		processBlock(block.data(), std::chrono::steady_clock::now() - m_source->getReadLatency());
 	}
+	m_frameConsumer = nullptr;
+
+	if (m_recorder != nullptr)
+	{
+		m_recorder->flush();
+	}
+
+	return m_frameSequence - firstFrame;
 }
 
 void AudioEngine::startRecording()
 {
 	fmt::print("AudioEngine::startRecording::start\n");
+	Profiler::setThreadName("Recording");
 
 	while (m_recordingActive)
 	{
-		// const auto startTime = std::chrono::system_clock::now();
+		{
+			std::unique_lock<std::mutex> lock(m_blockMutex);
+			m_blockCondition.wait(lock, [this]
+			{
+				return m_blockRing.available() > 0 || m_captureFinished || !m_recordingActive;
+			});
+		}
+
+		if (!m_recordingActive)
+		{
+			break;
+		}
 
-		// This will block for a fixed amount of time
-		int error;
-		if (pa_simple_read(m_source, m_sampleBuffer.data(), m_sampleBuffer.size(), &error) < 0)
+		// This hands the previous block back to the capture thread
+		const CapturedBlock* block = m_blockRing.acquire();
+		signalBlockRing();
+
+		// The capture thread has stopped, and we've processed everything it read
+		if (block == nullptr)
 		{
-			fmt::print("AudioEngine::startRecording: Failed to read: {}\n", pa_strerror(error));
+			fmt::print("AudioEngine::startRecording: Source stopped providing samples\n");
 			m_recordingActive = false;
-			return;
+			break;
 		}
 
-		// If we have more than 1 channel, unpack into the different data channels
-		const unsigned int& numChannels = m_samplingSettings.numChannels;
-		if (numChannels > 1)
+		processBlock(block->samples.data(), block->captureTime);
+
+		// Never wait for the GUI, it's only a plot, and it can have the next one. The copy is the same size every time,
+		// so it doesn't allocate
 		{
-			// reinterpret as float array as it should match the sample size
-			assert(sizeof(float) == pa_sample_size_of_format(m_samplingSettings.sampleFormat));
-			const float* buf = reinterpret_cast<float*>(m_sampleBuffer.data());
-			for (unsigned int i = 0; i < m_samplingSettings.numSamples; ++i)
+			std::unique_lock<std::mutex> lock(m_lastBlockMutex, std::try_to_lock);
+			if (lock.owns_lock())
 			{
-				for (size_t j = 0; j < numChannels; ++j)
-				{
-					m_fftData[j].fftwInput[i] = buf[numChannels * i + j];
-				}
+				m_lastBlock.assign(block->samples.begin(), block->samples.end());
 			}
 		}
+	}
+
+	// Let the capture thread go, if it's waiting for room
+	signalBlockRing();
+
+	fmt::print("AudioEngine::startRecording::end\n");
+}
 
-		// used for determining approx frequencies from the DFT sample index
-		// static const float reciprocal = static_cast<float>(m_samplingSettings.sampleRate) / static_cast<float>(m_samplingSettings.numSamples);
+void AudioEngine::captureBlocks()
+{
+	Profiler::setThreadName("Capture");
 
-		// put these on seperate threads?
-		for (auto& fftData : m_fftData)
+	while (m_recordingActive)
+	{
+		// Wait for room rather than letting beginWrite() hand out its scratch slot, which would drop the block
 		{
-			// run the DFT
-			fftw_execute(fftData.fftwPlan);
-/*
-			// first lower the values in the buckets by the smoothing factor
-			for (auto& bucket : fftData.spectrumBuckets)
-			{
-				bucket *= m_histogramSmoothing;
-			}
-*/
-			// we only care about samples in the DFT that are below the nyquist frequency (midpoint)
-			const auto numUsableSamples = m_samplingSettings.numSamples / 2;
-			const auto channelIndexOffset = numUsableSamples * static_cast<unsigned char>(fftData.channelID);
-			for (unsigned int i = 0; i < numUsableSamples; ++i)
-			{
-				const fftw_complex& sample = fftData.fftwOutput[i];
-				const float amplitude = 10.0f * log10(sample[0] * sample[0] + sample[1] * sample[1]);
-				// const float amplitude = sqrt(sample[0] * sample[0] + sample[1] * sample[1]);
-				// const float amplitude = sample[0] + sample[1]; // no need to sqrt
-				fftData.dftOutputRaw[i] = amplitude;
-				m_dftOutputCombined[channelIndexOffset + i] = amplitude;
-/*
-				// Frequency is approximate, based on the sample size, so it never fills the buckets properly :/
-				const float freq = log10(static_cast<float>(i) * reciprocal);
-				float t = (freq - minBucketFreqLog) / (maxBucketFreqLog - minBucketFreqLog);
-				int idx = std::max(std::min(int(t * m_numSpectrumBuckets), m_numSpectrumBuckets), 0);
-				fftData.spectrumBuckets[idx] = amplitude > fftData.spectrumBuckets[idx] ?
-					amplitude :
-					fftData.spectrumBuckets[idx];
-*/
-				// for (int j = 0; j < m_numSpectrumBuckets; ++j)
-				// {
-				// 	// freqBuckets is sized m_numSpectrumBuckets + 1, so this is safe
-				// 	if (freq > m_spectrumBuckets[j] && freq < m_spectrumBuckets[j + 1])
-				// 	{
-				// 		fftData.spectrumBuckets[j] = amplitude > fftData.spectrumBuckets[j] ?
-				// 			amplitude :
-				// 			fftData.spectrumBuckets[j];
-				// 		break;
-				// 	}
-				// }
-			}
+			std::unique_lock<std::mutex> lock(m_blockMutex);
+			m_blockCondition.wait(lock, [this] { return !m_blockRing.full() || !m_recordingActive; });
 		}
 
-		m_dftOutputReady = true;
+		if (!m_recordingActive)
+		{
+			break;
+		}
 
-		// std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+		// This may block, e.g. for a fixed amount of time on a capture device
+		CapturedBlock* block = m_blockRing.beginWrite();
+		bool read;
+		{
+			GAZ_PROFILE_SCOPE("AudioSource::read");
+			read = m_source->read(block->samples.data(), block->samples.size());
+		}
+		if (!read)
+		{
+			break;
+		}
+
+		const auto readTime = std::chrono::steady_clock::now();
+		block->captureTime = readTime - m_source->getReadLatency();
+		m_latencyStats.record(LatencyStage::Capture, block->captureTime, readTime);
+
+		if (m_recorder != nullptr)
+		{
+			m_recorder->writePCM(block->samples.data(), block->samples.size());
+		}
 
-		// const auto endTime = std::chrono::system_clock::now();
-		// fmt::print("AudioEngine::startRecording::elapsed: recorded {} bytes ({}ms)\n",
-		// 	m_sampleBuffer.size(),
-		// 	std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count()
-		// );
+		m_blockRing.endWrite();
+		signalBlockRing();
 	}
 
-	fmt::print("AudioEngine::startRecording::end\n");
+	m_captureFinished = true;
+	signalBlockRing();
 }
 
-/*
-// returns a vector of size numBuckets + 1, fist and last will be min/max above
-std::vector<float> GLAudioVisApp::calculateBuckets(int numBuckets, float powerCurve)
+void AudioEngine::signalBlockRing()
 {
-	// set this according to human hearing ranges, or something
-	constexpr float minBucketFreq = 20.0f;
-	constexpr float maxBucketFreq = 20000.0f;
+	// Take the lock so the notification can't slip in between a waiting thread checking the ring and going to sleep
+	{
+		std::lock_guard<std::mutex> lock(m_blockMutex);
+	}
+	m_blockCondition.notify_all();
+}
+
+void AudioEngine::processBlock(const char* block, std::chrono::steady_clock::time_point captureTime)
+{
+	GAZ_PROFILE_SCOPE("AudioEngine::processBlock");
+
+	const unsigned int& numChannels = m_samplingSettings.numChannels;
+	const unsigned int hopSize = m_samplingSettings.getHopSize();
+	const unsigned int framesPerRead = m_samplingSettings.getFramesPerRead();
 
-	std::vector<float> buckets(numBuckets + 1);
-	buckets.front() = minBucketFreq;
-	buckets.back() = maxBucketFreq;
+	const size_t frameSize = numChannels * DSP::bytesPerSample(m_sampleFormat);
 
-	for (int i = 1; i < numBuckets; ++i)
+	// Split the block at each hop boundary, and analyse the window as we reach them
+	unsigned int frameIndex = 0;
+	while (frameIndex < framesPerRead)
 	{
-		float t = static_cast<float>(i) / static_cast<float>(numBuckets);
-		// t = pow(t, powerCurve);
-		buckets[i] = minBucketFreq + (maxBucketFreq - minBucketFreq) * t;
+		// Stop at the hop boundary
+		const unsigned int numFrames = std::min(framesPerRead - frameIndex, hopSize - m_framesSinceHop);
+
+		// Convert and unpack the interleaved samples into the different channel histories, in one pass
+		m_history->push(&block[frameSize * frameIndex], numFrames);
+
+		frameIndex += numFrames;
+		m_framesSinceHop += numFrames;
+
+		if (m_framesSinceHop == hopSize)
+		{
+			// The window ends part way through the block, so its newest frame was captured a little earlier
+			const double framesLater = framesPerRead - frameIndex;
+			m_windowCaptureTime = captureTime - std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				std::chrono::duration<double>(framesLater / m_samplingSettings.sampleRate)
+			);
+
+			analyseWindow();
+			m_framesSinceHop = 0;
+		}
 	}
-	fmt::print("buckets: {}\n", buckets);
+}
+
+void AudioEngine::analyseWindow()
+{
+	GAZ_PROFILE_SCOPE("AudioEngine::analyseWindow");
 
-	// std::vector<float> logBuckets = buckets;
-	std::for_each(buckets.begin(), buckets.end(), [](float& x){ x = log10(x); });
-	fmt::print("log buckets: {}\n", buckets);
+	// Pick up a new band matrix if the GUI has made one, but never wait for it
+	{
+		std::unique_lock<std::mutex> lock(m_pendingBandMatrixMutex, std::try_to_lock);
+		if (lock.owns_lock() && m_hasPendingBandMatrix)
+		{
+			std::swap(m_bandMatrix, m_pendingBandMatrix);
+			m_hasPendingBandMatrix = false;
 
+			// The bands have moved, so their history means nothing
+			m_resetBandSmoothing = true;
+		}
+	}
 
-	return buckets;
+	// Fill the next frame in place, if the renderer isn't keeping up this will be dropped rather than blocking
+	SpectrumFrame* frame = m_frameRing.beginWrite();
+	frame->sequence = m_frameSequence++;
+	frame->captureTime = m_windowCaptureTime;
+	frame->numBands = m_bandMatrix->getNumBands();
+
+	// A new weighting shifts every bin, so the smoothing starts again rather than gliding over to it
+	const DSP::FrequencyWeighting weighting = m_frequencyWeighting;
+	if (weighting != m_windowWeighting)
+	{
+		m_windowWeighting = weighting;
+		m_resetSpectrumSmoothing = true;
+	}
+
+	const WindowParameters parameters{
+		m_decibelFloor,
+		m_binOffsets[static_cast<size_t>(weighting)].data(),
+		{m_attackCoefficient, m_releaseCoefficient, m_peakFall, m_averageCoefficient},
+		m_resetSpectrumSmoothing,
+		m_resetBandSmoothing
+	};
+	m_resetSpectrumSmoothing = false;
+	m_resetBandSmoothing = false;
+
+	// Each group of channels is independent, so fan them out over the pool, which joins before we publish
+	m_threadPool->parallelFor(m_fft->getNumGroups(), [this, frame, &parameters](size_t group)
+	{
+		analyseGroup(static_cast<unsigned int>(group), *frame, parameters);
+	});
+
+	// Loudness sums the channels' power, so it waits for all of them
+	double momentaryPower = 0.0;
+	double shortTermPower = 0.0;
+	for (unsigned int channel = 0; channel < m_samplingSettings.numChannels; ++channel)
+	{
+		momentaryPower += m_loudnessWeights[channel] * m_levelMeters[channel].getMomentaryPower();
+		shortTermPower += m_loudnessWeights[channel] * m_levelMeters[channel].getShortTermPower();
+	}
+	frame->momentaryLoudness = std::max(DSP::loudness(momentaryPower), parameters.decibelFloor);
+	frame->shortTermLoudness = std::max(DSP::loudness(shortTermPower), parameters.decibelFloor);
+
+	// Rhythm from the flux of every channel's bands together, which would spike if the bands had just moved
+	if (parameters.resetBandSmoothing)
+	{
+		m_onsetDetector->reset();
+	}
+	m_onsetDetector->process(frame->bands.data(), m_samplingSettings.numChannels * frame->numBands);
+	m_tempoTracker->process(m_onsetDetector->getEnvelope(), m_onsetDetector->isOnset());
+
+	frame->onsetStrength = m_onsetDetector->getStrength();
+	frame->onset = m_onsetDetector->isOnset();
+	frame->tempo = m_tempoTracker->getTempo();
+	frame->beatPhase = m_tempoTracker->getBeatPhase();
+	frame->beat = m_tempoTracker->isBeat();
+
+	// The pair may be in different groups, so this waits for both, their outputs are still warm from the pool
+	if (m_stereoAnalyser != nullptr)
+	{
+		GAZ_PROFILE_SCOPE("StereoAnalyser::process");
+		m_stereoAnalyser->process(
+			getComplexOutput(m_stereoChannels[0]),
+			getComplexOutput(m_stereoChannels[1]),
+			{frame->stereoCoherence.data(), frame->stereoPhase.data(), frame->stereoSide.data()}
+		);
+		frame->stereoCorrelation = m_stereoAnalyser->getCorrelation();
+		frame->stereoWidth = m_stereoAnalyser->getSide();
+	}
+
+	frame->analysedTime = std::chrono::steady_clock::now();
+	m_latencyStats.record(LatencyStage::Analysis, frame->captureTime, frame->analysedTime);
+
+	// Even a frame the renderer will drop is recorded
+	if (m_recorder != nullptr)
+	{
+		m_recorder->writeSpectrum(*frame);
+	}
+
+	// Offline, the frame goes to the caller instead, and its slot is simply filled again next time
+	if (m_frameConsumer != nullptr)
+	{
+		(*m_frameConsumer)(*frame);
+		return;
+	}
+
+	// Publish the frame to the renderer
+	frame->publishedTime = std::chrono::steady_clock::now();
+	m_latencyStats.record(LatencyStage::Publish, frame->captureTime, frame->publishedTime);
+	m_frameRing.endWrite();
 }
-*/
-
-// ImGui Helper Functions
-void AudioEngine::plotInputPCM(
-	const Channel& channel,
-	const char* label,
-	const char* overlay,
-	const ImVec2& size
-)
+
+void AudioEngine::analyseGroup(unsigned int group, SpectrumFrame& frame, const WindowParameters& parameters)
 {
-	// Cast the start of the buffer to a float array, since that's what ImGui needs to plot lines, and sizeof(float)
-	// matches m_bytesPerSample
-	assert(sizeof(float) == pa_sample_size_of_format(m_samplingSettings.sampleFormat));
-	const float* buf = reinterpret_cast<float*>(m_sampleBuffer.data());
-
-	ImGui::PlotLines(
-		label,
-		&buf[static_cast<unsigned char>(channel)], // start index
-		m_samplingSettings.numSamples / m_samplingSettings.numChannels,
-		0,
-		overlay,
-		-1.0f,
-		1.0f,
-		size,
-		sizeof(float) * m_samplingSettings.numChannels // stride
+	GAZ_PROFILE_SCOPE("AudioEngine::analyseGroup");
+
+	const unsigned int firstChannel = group * m_fft->getChannelsPerGroup();
+	const unsigned int lastChannel = std::min<unsigned int>(
+		firstChannel + m_fft->getChannelsPerGroup(),
+		m_samplingSettings.numChannels
 	);
+
+	// Copy the window out of each channel's history, oldest sample first (the DFT destroys its input), and meter
+	// the samples at the end which are new since the last window while they're there
+	for (unsigned int channel = firstChannel; channel < lastChannel; ++channel)
+	{
+		float* window = m_fft->getInput(channel);
+		m_history->copyWindow(channel, window);
+
+		DSP::LevelMeter& meter = m_levelMeters[channel];
+		meter.process(window + m_samplingSettings.numSamples - std::min(
+			m_samplingSettings.getHopSize(),
+			m_samplingSettings.numSamples
+		));
+		frame.rms[channel] = powerToDecibels(meter.getMeanSquare(), parameters.decibelFloor);
+		frame.truePeak[channel] = amplitudeToDecibels(meter.getTruePeak(), parameters.decibelFloor);
+	}
+
+	// run the DFT for this group's channels
+	{
+		GAZ_PROFILE_SCOPE("DFT");
+		m_fft->execute(group);
+	}
+
+	for (unsigned int channel = firstChannel; channel < lastChannel; ++channel)
+	{
+		const fftwf_complex* fftOutput = m_fft->getOutput(channel);
+
+		const auto channelIndexOffset = m_numOutputBins * channel;
+
+		// Descriptors of the linear spectrum, unweighted, while the DFT output is still in cache
+		const unsigned int numDFTBins = m_samplingSettings.numSamples / 2;
+		frame.descriptors[channel] = DSP::spectralDescriptors(
+			reinterpret_cast<const float*>(fftOutput),
+			numDFTBins,
+			static_cast<float>(m_samplingSettings.sampleRate) / m_samplingSettings.numSamples,
+			&m_descriptorPower[numDFTBins * channel]
+		);
+
+		// Power in dB, written straight into this channel's plane of the frame. For a linear analysis we only
+		// care about the samples in the DFT that are below the nyquist frequency (midpoint)
+		const float* spectrum = reinterpret_cast<const float*>(fftOutput);
+		if (m_constantQ != nullptr)
+		{
+			float* constantQOutput = &m_constantQOutput[2 * channelIndexOffset];
+			m_constantQ->apply(spectrum, constantQOutput);
+			spectrum = constantQOutput;
+		}
+
+		DSP::powerToDecibels(
+			spectrum,
+			m_numOutputBins,
+			parameters.decibelFloor,
+			parameters.binOffsets,
+			&frame.spectrum[channelIndexOffset]
+		);
+
+		// Band levels, from the linear power of the bins so that quiet bins don't drag a band down
+		float* bandPower = &m_bandPower[s_maxSpectrumBuckets * channel];
+		m_bandMatrix->apply(reinterpret_cast<const float*>(fftOutput), bandPower);
+		const auto bandIndexOffset = frame.numBands * channel;
+		DSP::powerToDecibelsReal(bandPower, frame.numBands, parameters.decibelFloor, &frame.bands[bandIndexOffset]);
+
+		// Smooth both in one pass each, straight into the frame's other planes
+		const DSP::SmoothingPlanes spectrumState = getSmoothingState(m_spectrumSmoothing, channel, m_numOutputBins);
+		if (parameters.resetSpectrumSmoothing)
+		{
+			DSP::resetSmoothing(&frame.spectrum[channelIndexOffset], m_numOutputBins, spectrumState);
+		}
+		DSP::smoothSpectrum(
+			&frame.spectrum[channelIndexOffset],
+			m_numOutputBins,
+			parameters.smoothing,
+			spectrumState,
+			{
+				&frame.smoothedSpectrum[channelIndexOffset],
+				&frame.peakSpectrum[channelIndexOffset],
+				&frame.averageSpectrum[channelIndexOffset]
+			}
+		);
+
+		const DSP::SmoothingPlanes bandState = getSmoothingState(m_bandSmoothing, channel, s_maxSpectrumBuckets);
+		if (parameters.resetBandSmoothing)
+		{
+			DSP::resetSmoothing(&frame.bands[bandIndexOffset], frame.numBands, bandState);
+		}
+		DSP::smoothSpectrum(
+			&frame.bands[bandIndexOffset],
+			frame.numBands,
+			parameters.smoothing,
+			bandState,
+			{
+				&frame.smoothedBands[bandIndexOffset],
+				&frame.peakBands[bandIndexOffset],
+				&frame.averageBands[bandIndexOffset]
+			}
+		);
+	}
 }
 
-void AudioEngine::plotDFT(
-	const Channel& channel,
-	const char* label,
-	const char* overlay,
-	const ImVec2& size
-)
+const float* AudioEngine::getComplexOutput(unsigned int channel) const
 {
-	ImGui::PlotLines(
-		label,
-		m_fftData[static_cast<unsigned char>(channel)].dftOutputRaw.data(),
-		m_fftData[static_cast<unsigned char>(channel)].dftOutputRaw.size(),
-		0,
-		overlay,
-		0.0f,
-		48.0f,
-		size
-	);
+	return m_constantQ != nullptr ?
+		&m_constantQOutput[2 * m_numOutputBins * channel] :
+		reinterpret_cast<const float*>(m_fft->getOutput(channel));
 }
 
-void AudioEngine::plotSpectrum(
-	const Channel& channel,
-	const char* label,
-	const char* overlay,
-	const ImVec2& size
-)
+DSP::SmoothingPlanes AudioEngine::getSmoothingState(std::vector<float>& state, unsigned int channel, size_t planeSize)
 {
-	ImGui::PlotHistogram(
-		label,
-		m_fftData[static_cast<unsigned char>(channel)].spectrumBuckets.data(),
-		m_numSpectrumBuckets,
-		0,
-		overlay,
-		0.0f,
-		48.0f,
-		size
-	);
+	// Each plane holds every channel, like the frame
+	const size_t channelsSize = m_samplingSettings.numChannels * planeSize;
+	float* channelState = &state[channel * planeSize];
+	return {channelState, channelState + channelsSize, channelState + 2 * channelsSize};
 }
 
-void AudioEngine::setSpectrumBucketCount(unsigned int bucketCount)
+void AudioEngine::setSmoothing(const SmoothingSettings& settings)
+{
+	m_smoothingSettings = settings;
+
+	const float framesPerSecond = static_cast<float>(m_samplingSettings.sampleRate) / m_samplingSettings.getHopSize();
+	m_attackCoefficient = DSP::smoothingCoefficient(settings.attackSeconds, framesPerSecond);
+	m_releaseCoefficient = DSP::smoothingCoefficient(settings.releaseSeconds, framesPerSecond);
+	m_peakFall = settings.peakFallDecibelsPerSecond / framesPerSecond;
+	m_averageCoefficient = DSP::smoothingCoefficient(settings.averageSeconds, framesPerSecond);
+}
+
+bool AudioEngine::openRecorder(const std::string& path, const Recorder::Settings& settings)
+{
+	if (m_recordingActive || m_numOutputBins == 0)
+	{
+		fmt::print("AudioEngine::openRecorder: Recording must be stopped, after init()\n");
+		return false;
+	}
+
+	Recording::FileHeader header{};
+	header.sampleRate = m_samplingSettings.sampleRate;
+	header.numChannels = m_samplingSettings.numChannels;
+	header.sampleFormat = static_cast<uint32_t>(m_samplingSettings.sampleFormat);
+	header.framesPerRead = m_samplingSettings.getFramesPerRead();
+	header.numSamples = m_samplingSettings.numSamples;
+	header.hopSize = m_samplingSettings.getHopSize();
+	header.analysis = static_cast<uint32_t>(m_samplingSettings.analysis);
+	header.numOutputBins = m_numOutputBins;
+	header.maxBands = s_maxSpectrumBuckets;
+
+	closeRecorder();
+	m_recorder = std::make_unique<Recorder>();
+	if (!m_recorder->open(path, header, settings))
+	{
+		m_recorder.reset();
+		return false;
+	}
+	return true;
+}
+
+void AudioEngine::closeRecorder()
 {
-	m_numSpectrumBuckets = bucketCount;
+	if (m_recordingActive)
+	{
+		fmt::print("AudioEngine::closeRecorder: Recording must be stopped\n");
+		return;
+	}
+
+	m_recorder.reset();
+}
 
-	for (auto& fftData : m_fftData)
+std::string AudioEngine::getChannelName(unsigned int channel) const
+{
+	if (channel >= m_channelMap.channels)
 	{
-		fftData.spectrumBuckets.clear();
-		fftData.spectrumBuckets.resize(bucketCount);
+		return fmt::format("Channel {}", channel);
 	}
+
+	return pa_channel_position_to_pretty_string(m_channelMap.map[channel]);
 }
 
-const std::vector<float>& AudioEngine::getDFT(const Channel& channel) const
+void AudioEngine::setSpectrumBucketCount(unsigned int bucketCount)
 {
-	return m_fftData[static_cast<unsigned char>(channel)].dftOutputRaw;
+	m_numSpectrumBuckets = std::clamp(bucketCount, 1u, s_maxSpectrumBuckets);
+	m_customBandEdges.clear();
+	submitBandMatrix(buildBandMatrix());
 }
 
-const std::optional<const std::vector<float>> AudioEngine::requestDFT(/*const Channel& channel*/)
+void AudioEngine::setSpectrumBandScale(DSP::BandScale scale)
 {
-	// auto& fftData = m_fftData[static_cast<unsigned char>(channel)];
+	m_spectrumBandScale = scale;
+	setSpectrumBucketCount(m_numSpectrumBuckets);
+}
 
-	if (m_dftOutputReady)
+void AudioEngine::setSpectrumBandEdges(const std::vector<float>& edgesHz)
+{
+	if (edgesHz.size() < 2 || edgesHz.size() > s_maxSpectrumBuckets + 1)
 	{
-		const auto dftCopy = m_dftOutputCombined;
-		m_dftOutputReady = false;
-		return dftCopy;
+		fmt::print("AudioEngine::setSpectrumBandEdges: Need between 2 and {} edges\n", s_maxSpectrumBuckets + 1);
+		return;
 	}
 
-	return {};
+	m_numSpectrumBuckets = edgesHz.size() - 1;
+	m_customBandEdges = edgesHz;
+	submitBandMatrix(buildBandMatrix());
+}
+
+void AudioEngine::setFrequencyWeighting(DSP::FrequencyWeighting weighting)
+{
+	m_frequencyWeighting = weighting;
+	submitBandMatrix(buildBandMatrix());
+}
+
+DSP::BandMatrix AudioEngine::buildBandMatrix() const
+{
+	DSP::BandMatrix matrix = m_customBandEdges.empty() ?
+		DSP::BandMatrix::fromScale(
+			m_spectrumBandScale,
+			m_numSpectrumBuckets,
+			minBandFrequency,
+			maxBandFrequency,
+			m_samplingSettings.sampleRate,
+			m_samplingSettings.numSamples
+		) :
+		DSP::BandMatrix::fromEdges(m_customBandEdges, m_samplingSettings.sampleRate, m_samplingSettings.numSamples);
+
+	matrix.scaleBins(m_dftBinGains[static_cast<size_t>(m_frequencyWeighting.load())]);
+	return matrix;
+}
+
+void AudioEngine::submitBandMatrix(DSP::BandMatrix matrix)
+{
+	// Build outside the lock, so the recording thread is never kept from its try_lock for long
+	auto newMatrix = std::make_unique<DSP::BandMatrix>(std::move(matrix));
+
+	std::lock_guard<std::mutex> lock(m_pendingBandMatrixMutex);
+	m_pendingBandMatrix = std::move(newMatrix);
+	m_hasPendingBandMatrix = true;
 }
@@ -0,0 +1,239 @@
+#include "AudioEngine.h"
+
+#include <imgui/imgui.h>
+
+#include "DSP/Deinterleave.h"
+
+// The engine's ImGui helpers, apart from the analysis so the headless tools build without ImGui
+
+using namespace gaz;
+
+void AudioEngine::plotInputPCM(
+	unsigned int channel,
+	const char* label,
+	const char* overlay,
+	const ImVec2& size
+)
+{
+	// The buffer holds samples in the capture format, so convert them one at a time as ImGui asks for them
+	struct PlotData
+	{
+		const char* firstSample;
+		DSP::SampleFormat format;
+		size_t frameSize;
+	};
+
+	// Held while plotting, the recording thread skips its copy rather than wait for us
+	std::lock_guard<std::mutex> lock(m_lastBlockMutex);
+	if (m_lastBlock.empty())
+	{
+		return;
+	}
+	const char* block = m_lastBlock.data();
+
+	const size_t bytesPerSample = DSP::bytesPerSample(m_sampleFormat);
+	PlotData plotData{
+		&block[bytesPerSample * channel],
+		m_sampleFormat,
+		bytesPerSample * m_samplingSettings.numChannels
+	};
+
+	ImGui::PlotLines(
+		label,
+		[](void* data, int index)
+		{
+			const PlotData& plot = *static_cast<const PlotData*>(data);
+			float value = 0.0f;
+			float* out = &value;
+			DSP::deinterleave(plot.firstSample + index * plot.frameSize, plot.format, 1, 1, &out);
+			return value;
+		},
+		&plotData,
+		m_samplingSettings.getFramesPerRead(),
+		0,
+		overlay,
+		-1.0f,
+		1.0f,
+		size
+	);
+}
+
+void AudioEngine::plotDFT(
+	unsigned int channel,
+	const char* label,
+	const char* overlay,
+	const ImVec2& size
+)
+{
+	// Plot the frame the renderer consumed most recently, it stays valid until the next acquireFrame()
+	const SpectrumFrame* frame = m_frameRing.latest();
+	if (frame == nullptr)
+	{
+		return;
+	}
+
+	ImGui::PlotLines(
+		label,
+		&frame->getSpectrum(m_displayPlane)[m_numOutputBins * channel],
+		m_numOutputBins,
+		0,
+		overlay,
+		m_decibelFloor,
+		0.0f,
+		size
+	);
+}
+
+void AudioEngine::plotSpectrum(
+	unsigned int channel,
+	const char* label,
+	const char* overlay,
+	const ImVec2& size
+)
+{
+	const SpectrumFrame* frame = m_frameRing.latest();
+	if (frame == nullptr)
+	{
+		return;
+	}
+
+	ImGui::PlotHistogram(
+		label,
+		&frame->getBands(m_displayPlane)[frame->numBands * channel],
+		frame->numBands,
+		0,
+		overlay,
+		m_decibelFloor,
+		0.0f,
+		size
+	);
+}
+
+void AudioEngine::showLevelMeters(unsigned int channel)
+{
+	const SpectrumFrame* frame = m_frameRing.latest();
+	if (frame == nullptr)
+	{
+		return;
+	}
+
+	ImGui::Text("RMS: %.1f dBFS, True Peak: %.1f dBTP", frame->rms[channel], frame->truePeak[channel]);
+}
+
+void AudioEngine::showLoudness()
+{
+	const SpectrumFrame* frame = m_frameRing.latest();
+	if (frame == nullptr)
+	{
+		return;
+	}
+
+	ImGui::Text(
+		"Loudness: %.1f LUFS momentary, %.1f LUFS short-term",
+		frame->momentaryLoudness,
+		frame->shortTermLoudness
+	);
+}
+
+void AudioEngine::showRhythm()
+{
+	const SpectrumFrame* frame = m_frameRing.latest();
+	if (frame == nullptr)
+	{
+		return;
+	}
+
+	ImGui::Text("Tempo: %.1f BPM, Onset Strength: %.2f dB", frame->tempo, frame->onsetStrength);
+	ImGui::ProgressBar(frame->beatPhase, ImVec2(-1.0f, 0.0f), "Beat Phase");
+}
+
+void AudioEngine::showStereo(const ImVec2& plotSize)
+{
+	const SpectrumFrame* frame = m_frameRing.latest();
+	if (frame == nullptr || frame->stereoCoherence.empty())
+	{
+		return;
+	}
+
+	ImGui::Text(
+		"Stereo (%s / %s): Correlation %+.2f, Width %.2f",
+		getChannelName(m_stereoChannels[0]).c_str(),
+		getChannelName(m_stereoChannels[1]).c_str(),
+		frame->stereoCorrelation,
+		frame->stereoWidth
+	);
+
+	// -1 (out of phase) on the left, +1 (mono) on the right
+	ImGui::ProgressBar(0.5f * (frame->stereoCorrelation + 1.0f), ImVec2(-1.0f, 0.0f), "Correlation");
+
+	ImGui::PlotLines(
+		"##StereoCoherence",
+		frame->stereoCoherence.data(),
+		static_cast<int>(frame->stereoCoherence.size()),
+		0,
+		"Coherence",
+		0.0f,
+		1.0f,
+		plotSize
+	);
+	ImGui::PlotLines(
+		"##StereoSide",
+		frame->stereoSide.data(),
+		static_cast<int>(frame->stereoSide.size()),
+		0,
+		"Side / (Mid + Side)",
+		0.0f,
+		1.0f,
+		plotSize
+	);
+}
+
+void AudioEngine::showRecorder()
+{
+	if (m_recorder == nullptr)
+	{
+		return;
+	}
+
+	ImGui::Text(
+		"Recording to %s: %.1f MB, %llu chunk(s) dropped",
+		m_recorder->getPath().c_str(),
+		static_cast<double>(m_recorder->getBytesWritten()) / (1 << 20),
+		static_cast<unsigned long long>(m_recorder->getDroppedChunks())
+	);
+}
+
+void AudioEngine::showLatency()
+{
+	ImGui::Text("Latency from capture (ms):");
+
+	// One row per stage, in columns so the percentiles line up
+	ImGui::Columns(5, "##Latency", false);
+	for (const char* heading : {"Stage", "p50", "p99", "max", "count"})
+	{
+		ImGui::Text("%s", heading);
+		ImGui::NextColumn();
+	}
+
+	constexpr double nsToMs = 1e-6;
+	for (size_t stage = 0; stage < LatencyStats::s_numStages; ++stage)
+	{
+		const LatencyHistogram& histogram = m_latencyStats.get(static_cast<LatencyStage>(stage));
+		ImGui::Text("%s", toString(static_cast<LatencyStage>(stage)));
+		ImGui::NextColumn();
+		ImGui::Text("%.2f", histogram.getPercentile(50.0) * nsToMs);
+		ImGui::NextColumn();
+		ImGui::Text("%.2f", histogram.getPercentile(99.0) * nsToMs);
+		ImGui::NextColumn();
+		ImGui::Text("%.2f", histogram.getMax() * nsToMs);
+		ImGui::NextColumn();
+		ImGui::Text("%llu", static_cast<unsigned long long>(histogram.getCount()));
+		ImGui::NextColumn();
+	}
+	ImGui::Columns(1);
+
+	if (ImGui::Button("Reset Latency"))
+	{
+		m_latencyStats.reset();
+	}
+}
@@ -0,0 +1,119 @@
+#include "AudioSource.h"
+
+#include "AudioSources/FileAudioSource.h"
+#include "AudioSources/PulseAudioSource.h"
+#include "AudioSources/PulseStreamAudioSource.h"
+#include "AudioSources/SyntheticAudioSource.h"
+
+#include <fmt/core.h>
+
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+using namespace gaz;
+
+std::unique_ptr<AudioSource> AudioSource::create(const std::string& description)
+{
+	// Split '<type>[:<argument>][,<option>...]'
+	std::vector<std::string> options;
+	{
+		std::istringstream stream(description);
+		std::string option;
+		while (std::getline(stream, option, ','))
+		{
+			options.push_back(option);
+		}
+	}
+
+	if (options.empty())
+	{
+		return nullptr;
+	}
+
+	const std::string head = options.front();
+	options.erase(options.begin());
+
+	const auto separator = head.find(':');
+	const std::string type = head.substr(0, separator);
+	const std::string argument = separator != std::string::npos ? head.substr(separator + 1) : "";
+
+	bool realTime = false;
+	bool loop = false;
+	std::optional<float> duration;
+	float latencyMs = 5.0f;
+	for (const auto& option : options)
+	{
+		if (option == "realtime")
+		{
+			realTime = true;
+		}
+		else if (option == "loop")
+		{
+			loop = true;
+		}
+		else if (option.rfind("duration=", 0) == 0)
+		{
+			duration = std::strtof(option.c_str() + 9, nullptr);
+		}
+		else if (option.rfind("latency=", 0) == 0)
+		{
+			latencyMs = std::strtof(option.c_str() + 8, nullptr);
+			if (latencyMs <= 0.0f)
+			{
+				fmt::print("AudioSource::create: Invalid latency in '{}'\n", description);
+				return nullptr;
+			}
+		}
+		else
+		{
+			fmt::print("AudioSource::create: Unknown option '{}' in '{}'\n", option, description);
+			return nullptr;
+		}
+	}
+
+	if (type == "pulse")
+	{
+		return std::make_unique<PulseStreamAudioSource>(argument, latencyMs);
+	}
+	else if (type == "pulse-simple")
+	{
+		return std::make_unique<PulseAudioSource>(argument);
+	}
+	else if (type == "file" && !argument.empty())
+	{
+		return std::make_unique<FileAudioSource>(argument, realTime, loop);
+	}
+	else if (type == "synth")
+	{
+		const auto components = SyntheticAudioSource::parseSignal(argument.empty() ? "sine@440" : argument);
+		if (!components.has_value())
+		{
+			fmt::print("AudioSource::create: Invalid synthetic signal '{}'\n", argument);
+			return nullptr;
+		}
+		return std::make_unique<SyntheticAudioSource>(*components, realTime, duration);
+	}
+
+	fmt::print("AudioSource::create: Unrecognised audio source '{}'\n", description);
+	return nullptr;
+}
+
+std::optional<DSP::SampleFormat> gaz::toDSPSampleFormat(pa_sample_format_t format)
+{
+	switch (format)
+	{
+		case PA_SAMPLE_FLOAT32LE:
+			return DSP::SampleFormat::Float32;
+		case PA_SAMPLE_S16LE:
+			return DSP::SampleFormat::S16;
+		case PA_SAMPLE_S24LE:
+			return DSP::SampleFormat::S24;
+		case PA_SAMPLE_S24_32LE:
+			return DSP::SampleFormat::S24In32;
+		case PA_SAMPLE_S32LE:
+			return DSP::SampleFormat::S32;
+		default:
+			return {};
+	}
+}
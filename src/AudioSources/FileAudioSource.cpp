@@ -0,0 +1,262 @@
+#include "AudioSources/FileAudioSource.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+	// WAVE format tags
+	constexpr uint16_t WAVE_FORMAT_PCM = 0x0001;
+	constexpr uint16_t WAVE_FORMAT_IEEE_FLOAT = 0x0003;
+	constexpr uint16_t WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+
+	// WAV is little endian, as are all of the hosts we care about
+	template <typename T>
+	T readLE(const unsigned char* bytes)
+	{
+		T value;
+		std::memcpy(&value, bytes, sizeof(T));
+		return value;
+	}
+
+	// Map a WAV 'fmt ' description onto a PulseAudio sample format
+	pa_sample_format_t toSampleFormat(uint16_t formatTag, uint16_t containerBits)
+	{
+		if (formatTag == WAVE_FORMAT_IEEE_FLOAT && containerBits == 32)
+		{
+			return PA_SAMPLE_FLOAT32LE;
+		}
+
+		if (formatTag == WAVE_FORMAT_PCM)
+		{
+			switch (containerBits)
+			{
+				case 16: return PA_SAMPLE_S16LE;
+				case 24: return PA_SAMPLE_S24LE;
+				// Fewer valid bits in a 32 bit container (e.g. 24 in WAVE_FORMAT_EXTENSIBLE) are MSB aligned with
+				// zeroed padding below, so they decode exactly as S32. That's not PulseAudio's S24_32LE, which holds
+				// the sample in the low 3 bytes
+				case 32: return PA_SAMPLE_S32LE;
+				default: break;
+			}
+		}
+
+		return PA_SAMPLE_INVALID;
+	}
+
+	bool operator!=(const pa_sample_spec& a, const pa_sample_spec& b)
+	{
+		return a.format != b.format || a.rate != b.rate || a.channels != b.channels;
+	}
+};
+
+using namespace gaz;
+
+FileAudioSource::~FileAudioSource()
+{
+	if (m_file != nullptr)
+	{
+		std::fclose(m_file);
+	}
+}
+
+bool FileAudioSource::open(const pa_sample_spec& sampleSpec, unsigned int /*framesPerRead*/)
+{
+	m_file = std::fopen(m_path.c_str(), "rb");
+	if (m_file == nullptr)
+	{
+		fmt::print("FileAudioSource::open: Failed to open '{}': {}\n", m_path, std::strerror(errno));
+		return false;
+	}
+
+	if (const auto wavInfo = readWavHeader(m_file))
+	{
+		// We don't resample or remix here, so the file has to match what the engine was configured for
+		if (wavInfo->sampleSpec != sampleSpec)
+		{
+			fmt::print(
+				"FileAudioSource::open: '{}' is {} {}ch {}Hz, but {} {}ch {}Hz was requested\n",
+				m_path,
+				pa_sample_format_to_string(wavInfo->sampleSpec.format),
+				wavInfo->sampleSpec.channels,
+				wavInfo->sampleSpec.rate,
+				pa_sample_format_to_string(sampleSpec.format),
+				sampleSpec.channels,
+				sampleSpec.rate
+			);
+			return false;
+		}
+
+		m_dataOffset = wavInfo->dataOffset;
+		m_dataSize = wavInfo->dataSize;
+	}
+	else
+	{
+		// Not a WAV file, so treat the whole thing as raw PCM in the requested format
+		std::fseek(m_file, 0, SEEK_END);
+		m_dataOffset = 0;
+		m_dataSize = std::ftell(m_file);
+	}
+
+	// Only whole frames are usable
+	m_dataSize -= m_dataSize % pa_frame_size(&sampleSpec);
+	if (m_dataSize == 0)
+	{
+		fmt::print("FileAudioSource::open: '{}' contains no samples\n", m_path);
+		return false;
+	}
+
+	m_sampleSpec = sampleSpec;
+	m_dataRemaining = m_dataSize;
+	std::fseek(m_file, m_dataOffset, SEEK_SET);
+
+	return true;
+}
+
+bool FileAudioSource::read(char* buffer, size_t size)
+{
+	if (m_dataRemaining == 0)
+	{
+		return false;
+	}
+
+	size_t bytesRead = 0;
+	while (bytesRead < size)
+	{
+		if (m_dataRemaining == 0)
+		{
+			if (!m_loop)
+			{
+				// Pad the final partial block with silence, the next read will report the end of the file
+				std::fill(buffer + bytesRead, buffer + size, 0);
+				break;
+			}
+
+			std::fseek(m_file, m_dataOffset, SEEK_SET);
+			m_dataRemaining = m_dataSize;
+		}
+
+		const size_t toRead = std::min(size - bytesRead, m_dataRemaining);
+		const size_t result = std::fread(buffer + bytesRead, 1, toRead, m_file);
+		if (result != toRead)
+		{
+			fmt::print("FileAudioSource::read: Failed to read from '{}'\n", m_path);
+			m_dataRemaining = 0;
+			return false;
+		}
+
+		bytesRead += toRead;
+		m_dataRemaining -= toRead;
+	}
+
+	if (m_realTime)
+	{
+		m_pacer.wait(size / pa_frame_size(&m_sampleSpec), m_sampleSpec.rate);
+	}
+
+	return true;
+}
+
+std::string FileAudioSource::getName() const
+{
+	return fmt::format("File ({})", m_path);
+}
+
+std::optional<pa_sample_spec> FileAudioSource::probe(const std::string& path)
+{
+	std::FILE* file = std::fopen(path.c_str(), "rb");
+	if (file == nullptr)
+	{
+		return {};
+	}
+
+	const auto wavInfo = readWavHeader(file);
+	std::fclose(file);
+
+	if (!wavInfo)
+	{
+		return {};
+	}
+
+	return wavInfo->sampleSpec;
+}
+
+std::optional<FileAudioSource::WavInfo> FileAudioSource::readWavHeader(std::FILE* file)
+{
+	std::fseek(file, 0, SEEK_SET);
+
+	unsigned char riffHeader[12];
+	if (std::fread(riffHeader, 1, sizeof(riffHeader), file) != sizeof(riffHeader) ||
+		std::memcmp(riffHeader, "RIFF", 4) != 0 ||
+		std::memcmp(riffHeader + 8, "WAVE", 4) != 0)
+	{
+		return {};
+	}
+
+	std::optional<pa_sample_spec> sampleSpec;
+
+	// Walk the chunks until we find the sample data, the 'fmt ' chunk has to come before it
+	unsigned char chunkHeader[8];
+	while (std::fread(chunkHeader, 1, sizeof(chunkHeader), file) == sizeof(chunkHeader))
+	{
+		const uint32_t chunkSize = readLE<uint32_t>(chunkHeader + 4);
+
+		if (std::memcmp(chunkHeader, "fmt ", 4) == 0)
+		{
+			unsigned char fmtChunk[40] = {};
+			const size_t fmtSize = std::min<size_t>(chunkSize, sizeof(fmtChunk));
+			if (chunkSize < 16 || std::fread(fmtChunk, 1, fmtSize, file) != fmtSize)
+			{
+				return {};
+			}
+
+			uint16_t formatTag = readLE<uint16_t>(fmtChunk);
+			const uint16_t channels = readLE<uint16_t>(fmtChunk + 2);
+			const uint32_t sampleRate = readLE<uint32_t>(fmtChunk + 4);
+			const uint16_t containerBits = readLE<uint16_t>(fmtChunk + 14);
+
+			// WAVEFORMATEXTENSIBLE stores the real format tag at the start of the sub format GUID
+			if (formatTag == WAVE_FORMAT_EXTENSIBLE && fmtSize >= 40)
+			{
+				formatTag = readLE<uint16_t>(fmtChunk + 24);
+			}
+
+			const pa_sample_format_t format = toSampleFormat(formatTag, containerBits);
+			if (format == PA_SAMPLE_INVALID || channels == 0 || channels > 255)
+			{
+				fmt::print("FileAudioSource: Unsupported WAV format (tag {}, {} bits)\n", formatTag, containerBits);
+				return {};
+			}
+
+			sampleSpec = pa_sample_spec{format, sampleRate, static_cast<uint8_t>(channels)};
+
+			// Skip anything we didn't read, chunks are padded to an even size
+			std::fseek(file, static_cast<long>(chunkSize + (chunkSize & 1) - fmtSize), SEEK_CUR);
+		}
+		else if (std::memcmp(chunkHeader, "data", 4) == 0)
+		{
+			if (!sampleSpec)
+			{
+				return {};
+			}
+
+			const long dataOffset = std::ftell(file);
+
+			// Some writers leave the size as 0 or 0xFFFFFFFF when streaming, so clamp it to the file
+			std::fseek(file, 0, SEEK_END);
+			const size_t available = static_cast<size_t>(std::ftell(file) - dataOffset);
+
+			return WavInfo{*sampleSpec, dataOffset, chunkSize == 0 ? available : std::min<size_t>(chunkSize, available)};
+		}
+		else
+		{
+			std::fseek(file, static_cast<long>(chunkSize + (chunkSize & 1)), SEEK_CUR);
+		}
+	}
+
+	return {};
+}
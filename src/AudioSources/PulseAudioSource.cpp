@@ -0,0 +1,85 @@
+#include "AudioSources/PulseAudioSource.h"
+
+#include <pulse/error.h>
+
+#include <fmt/core.h>
+
+using namespace gaz;
+
+PulseAudioSource::~PulseAudioSource()
+{
+	if (m_stream != nullptr)
+	{
+		pa_simple_free(m_stream);
+	}
+}
+
+bool PulseAudioSource::open(const pa_sample_spec& sampleSpec, unsigned int framesPerRead)
+{
+	const unsigned int bufferSize = pa_frame_size(&sampleSpec) * framesPerRead;
+
+	pa_buffer_attr bufferAttributes
+	{
+		.maxlength = bufferSize, // max length of the buffer in bytes
+		.tlength = (uint32_t)-1, // target buffer length (bytes) ?  playback only?
+		.prebuf = (uint32_t)-1, // prebuffering (playback only)
+		.minreq = (uint32_t)-1, // minimum request (playback only
+		// fragment size (bytes?) (recording only)
+		// .fragsize = bufferSize // works, varying bocking times
+		.fragsize = 0 // much more consistent
+	};
+
+	// PulseAudio only has default channel maps for up to 6 channels, so extend them with auxiliary channels
+	pa_channel_map channelMap;
+	pa_channel_map_init_extend(&channelMap, sampleSpec.channels, PA_CHANNEL_MAP_DEFAULT);
+
+	// connect to the PulseAudio server
+	int error;
+	m_stream = pa_simple_new(
+		nullptr,			// Use the default server
+		"GLAudioVisApp",	// Our application's name
+		PA_STREAM_RECORD,	// Connection Mode
+		m_device.empty() ? nullptr : m_device.c_str(), // Use the specified device
+		"Record",			// Description of our stream
+		&sampleSpec,		// Our sample format
+		&channelMap,		// Our channel map
+		&bufferAttributes,	// Use buffering attributes
+		&error				// Error code
+	);
+
+	if (m_stream == nullptr)
+	{
+		fmt::print(
+			"PulseAudioSource::open: Failed to connect to audio source '{}', error: {}\n",
+			m_device,
+			pa_strerror(error)
+		);
+		return false;
+	}
+
+	return true;
+}
+
+bool PulseAudioSource::read(char* buffer, size_t size)
+{
+	// This will block for a fixed amount of time
+	int error;
+	if (pa_simple_read(m_stream, buffer, size, &error) < 0)
+	{
+		fmt::print("PulseAudioSource::read: Failed to read: {}\n", pa_strerror(error));
+		return false;
+	}
+
+	// The samples still in the server's buffer are newer than the ones we've just read, so this is how old they are
+	const pa_usec_t latency = pa_simple_get_latency(m_stream, &error);
+	m_readLatency = latency != static_cast<pa_usec_t>(-1) ?
+		std::chrono::nanoseconds{std::chrono::microseconds{latency}} :
+		std::chrono::nanoseconds{0};
+
+	return true;
+}
+
+std::string PulseAudioSource::getName() const
+{
+	return fmt::format("PulseAudio ({})", m_device.empty() ? "default" : m_device);
+}
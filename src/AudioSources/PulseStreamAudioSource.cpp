@@ -0,0 +1,379 @@
+#include "AudioSources/PulseStreamAudioSource.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	// Record from whatever the server has, rather than waiting for a full target buffer, and let it reconfigure the
+	// source's latency to match our fragment size
+	constexpr pa_stream_flags_t streamFlags = static_cast<pa_stream_flags_t>(
+		PA_STREAM_ADJUST_LATENCY | PA_STREAM_INTERPOLATE_TIMING | PA_STREAM_AUTO_TIMING_UPDATE
+	);
+
+	uint64_t toMicroseconds(std::chrono::steady_clock::duration duration)
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+	}
+};
+
+using namespace gaz;
+
+PulseStreamAudioSource::~PulseStreamAudioSource()
+{
+	close();
+}
+
+bool PulseStreamAudioSource::open(const pa_sample_spec& sampleSpec, unsigned int framesPerRead)
+{
+	m_sampleSpec = sampleSpec;
+
+	const size_t frameSize = pa_frame_size(&sampleSpec);
+	const size_t readSize = frameSize * framesPerRead;
+
+	// Ask for fragments of the target latency, in whole frames
+	size_t fragmentSize = pa_usec_to_bytes(static_cast<pa_usec_t>(m_latencyMs * 1000.0f), &sampleSpec);
+	fragmentSize = std::max(fragmentSize - fragmentSize % frameSize, frameSize);
+
+	// Enough room for a few reads, so the recording thread can be late (e.g. on a slow DFT) without losing anything.
+	// The server's buffer is the same size, past that it overflows and we'll hear about it
+	const size_t bufferSize = std::max(4 * readSize, 8 * fragmentSize);
+	m_fifo.assign(bufferSize, 0);
+	m_fifoReadIndex = 0;
+	m_fifoSize = 0;
+
+	m_mainloop = pa_threaded_mainloop_new();
+	if (m_mainloop == nullptr)
+	{
+		fmt::print("PulseStreamAudioSource::open: Failed to create mainloop\n");
+		return false;
+	}
+
+	m_context = pa_context_new(pa_threaded_mainloop_get_api(m_mainloop), "GLAudioVisApp");
+	if (m_context == nullptr)
+	{
+		fmt::print("PulseStreamAudioSource::open: Failed to create context\n");
+		close();
+		return false;
+	}
+
+	pa_context_set_state_callback(m_context, &PulseStreamAudioSource::onContextState, this);
+
+	// connect to the default PulseAudio server
+	if (pa_context_connect(m_context, nullptr, PA_CONTEXT_NOFLAGS, nullptr) < 0)
+	{
+		fmt::print(
+			"PulseStreamAudioSource::open: Failed to connect to server, error: {}\n",
+			pa_strerror(pa_context_errno(m_context))
+		);
+		close();
+		return false;
+	}
+
+	pa_threaded_mainloop_lock(m_mainloop);
+
+	if (pa_threaded_mainloop_start(m_mainloop) < 0)
+	{
+		fmt::print("PulseStreamAudioSource::open: Failed to start mainloop\n");
+		pa_threaded_mainloop_unlock(m_mainloop);
+		close();
+		return false;
+	}
+
+	// Wait for the connection, the state callback signals us on every change
+	for (pa_context_state_t state = pa_context_get_state(m_context); state != PA_CONTEXT_READY;
+		state = pa_context_get_state(m_context))
+	{
+		if (!PA_CONTEXT_IS_GOOD(state))
+		{
+			fmt::print(
+				"PulseStreamAudioSource::open: Connection failed, error: {}\n",
+				pa_strerror(pa_context_errno(m_context))
+			);
+			pa_threaded_mainloop_unlock(m_mainloop);
+			close();
+			return false;
+		}
+
+		pa_threaded_mainloop_wait(m_mainloop);
+	}
+
+	// PulseAudio only has default channel maps for up to 6 channels, so extend them with auxiliary channels
+	pa_channel_map channelMap;
+	pa_channel_map_init_extend(&channelMap, sampleSpec.channels, PA_CHANNEL_MAP_DEFAULT);
+
+	m_stream = pa_stream_new(m_context, "Record", &sampleSpec, &channelMap);
+	if (m_stream == nullptr)
+	{
+		fmt::print(
+			"PulseStreamAudioSource::open: Failed to create stream, error: {}\n",
+			pa_strerror(pa_context_errno(m_context))
+		);
+		pa_threaded_mainloop_unlock(m_mainloop);
+		close();
+		return false;
+	}
+
+	pa_stream_set_state_callback(m_stream, &PulseStreamAudioSource::onStreamState, this);
+	pa_stream_set_read_callback(m_stream, &PulseStreamAudioSource::onStreamRead, this);
+	pa_stream_set_overflow_callback(m_stream, &PulseStreamAudioSource::onStreamOverflow, this);
+
+	pa_buffer_attr bufferAttributes
+	{
+		.maxlength = static_cast<uint32_t>(bufferSize), // max length of the server's buffer in bytes
+		.tlength = (uint32_t)-1, // playback only
+		.prebuf = (uint32_t)-1, // playback only
+		.minreq = (uint32_t)-1, // playback only
+		.fragsize = static_cast<uint32_t>(fragmentSize) // bytes delivered to us at a time, i.e. the latency
+	};
+
+	if (pa_stream_connect_record(m_stream, m_device.empty() ? nullptr : m_device.c_str(), &bufferAttributes, streamFlags) < 0)
+	{
+		fmt::print(
+			"PulseStreamAudioSource::open: Failed to connect to audio source '{}', error: {}\n",
+			m_device,
+			pa_strerror(pa_context_errno(m_context))
+		);
+		pa_threaded_mainloop_unlock(m_mainloop);
+		close();
+		return false;
+	}
+
+	for (pa_stream_state_t state = pa_stream_get_state(m_stream); state != PA_STREAM_READY;
+		state = pa_stream_get_state(m_stream))
+	{
+		if (!PA_STREAM_IS_GOOD(state))
+		{
+			fmt::print(
+				"PulseStreamAudioSource::open: Failed to record from '{}', error: {}\n",
+				m_device,
+				pa_strerror(pa_context_errno(m_context))
+			);
+			pa_threaded_mainloop_unlock(m_mainloop);
+			close();
+			return false;
+		}
+
+		pa_threaded_mainloop_wait(m_mainloop);
+	}
+
+	// The server may not give us exactly what we asked for
+	if (const pa_buffer_attr* attributes = pa_stream_get_buffer_attr(m_stream))
+	{
+		fmt::print(
+			"PulseStreamAudioSource::open: Fragments of {:.1f}ms ({} bytes), buffer of {:.1f}ms\n",
+			pa_bytes_to_usec(attributes->fragsize, &sampleSpec) / 1000.0f,
+			attributes->fragsize,
+			pa_bytes_to_usec(attributes->maxlength, &sampleSpec) / 1000.0f
+		);
+	}
+
+	pa_threaded_mainloop_unlock(m_mainloop);
+
+	return true;
+}
+
+bool PulseStreamAudioSource::read(char* buffer, size_t size)
+{
+	std::unique_lock<std::mutex> lock(m_fifoMutex);
+	m_fifoCondition.wait(lock, [this, size] { return m_fifoSize >= size || m_failed; });
+
+	if (m_fifoSize < size)
+	{
+		fmt::print("PulseStreamAudioSource::read: Stream failed\n");
+		return false;
+	}
+
+	// Copy out in up to two parts, where the FIFO wraps around
+	const size_t firstPart = std::min(size, m_fifo.size() - m_fifoReadIndex);
+	std::memcpy(buffer, &m_fifo[m_fifoReadIndex], firstPart);
+	std::memcpy(buffer + firstPart, m_fifo.data(), size - firstPart);
+
+	m_fifoReadIndex = (m_fifoReadIndex + size) % m_fifo.size();
+	m_fifoSize -= size;
+
+	// The server's latency was for the newest sample in the last fragment, whatever's left in the FIFO is newer
+	// than what we've just read. This leaves out the time since the fragment arrived, which we usually wake up for
+	m_readLatency = std::chrono::microseconds{m_latencyUs.load() + pa_bytes_to_usec(m_fifoSize, &m_sampleSpec)};
+
+	return true;
+}
+
+std::string PulseStreamAudioSource::getName() const
+{
+	return fmt::format("PulseAudio stream ({}, {}ms)", m_device.empty() ? "default" : m_device, m_latencyMs);
+}
+
+CaptureStats PulseStreamAudioSource::getCaptureStats() const
+{
+	CaptureStats stats;
+	stats.latencyMs = m_latencyUs / 1000.0f;
+	stats.fragmentIntervalMs = m_fragmentIntervalUs / 1000.0f;
+	stats.maxFragmentIntervalMs = m_maxFragmentIntervalUs / 1000.0f;
+	stats.fragments = m_fragments;
+	stats.serverOverflows = m_serverOverflows;
+	stats.droppedFrames = m_droppedFrames;
+	return stats;
+}
+
+void PulseStreamAudioSource::close()
+{
+	// Stop the mainloop thread first, so no callbacks run while we tear everything down
+	if (m_mainloop != nullptr)
+	{
+		pa_threaded_mainloop_stop(m_mainloop);
+	}
+
+	if (m_stream != nullptr)
+	{
+		pa_stream_disconnect(m_stream);
+		pa_stream_unref(m_stream);
+		m_stream = nullptr;
+	}
+
+	if (m_context != nullptr)
+	{
+		pa_context_disconnect(m_context);
+		pa_context_unref(m_context);
+		m_context = nullptr;
+	}
+
+	if (m_mainloop != nullptr)
+	{
+		pa_threaded_mainloop_free(m_mainloop);
+		m_mainloop = nullptr;
+	}
+}
+
+void PulseStreamAudioSource::onContextState(pa_context* context, void* userData)
+{
+	auto* source = static_cast<PulseStreamAudioSource*>(userData);
+	if (!PA_CONTEXT_IS_GOOD(pa_context_get_state(context)))
+	{
+		source->fail();
+	}
+
+	// Wake open(), if it's waiting
+	pa_threaded_mainloop_signal(source->m_mainloop, 0);
+}
+
+void PulseStreamAudioSource::onStreamState(pa_stream* stream, void* userData)
+{
+	auto* source = static_cast<PulseStreamAudioSource*>(userData);
+	if (!PA_STREAM_IS_GOOD(pa_stream_get_state(stream)))
+	{
+		source->fail();
+	}
+
+	pa_threaded_mainloop_signal(source->m_mainloop, 0);
+}
+
+void PulseStreamAudioSource::onStreamRead(pa_stream* stream, size_t /*numBytes*/, void* userData)
+{
+	auto* source = static_cast<PulseStreamAudioSource*>(userData);
+
+	// Fragment timing, to see how evenly the server is delivering
+	const auto now = std::chrono::steady_clock::now();
+	if (source->m_fragments > 0)
+	{
+		const uint64_t interval = toMicroseconds(now - source->m_lastFragmentTime);
+		source->m_fragmentIntervalUs = interval;
+		source->m_maxFragmentIntervalUs = std::max<uint64_t>(source->m_maxFragmentIntervalUs, interval);
+	}
+	source->m_lastFragmentTime = now;
+	++source->m_fragments;
+
+	pa_usec_t latency = 0;
+	int negative = 0;
+	if (pa_stream_get_latency(stream, &latency, &negative) == 0)
+	{
+		source->m_latencyUs = negative ? 0 : latency;
+	}
+
+	// Take everything that's ready, which may be more than one fragment
+	while (pa_stream_readable_size(stream) > 0)
+	{
+		const void* data = nullptr;
+		size_t size = 0;
+		if (pa_stream_peek(stream, &data, &size) < 0)
+		{
+			fmt::print("PulseStreamAudioSource: Failed to read: {}\n", pa_strerror(pa_context_errno(source->m_context)));
+			source->fail();
+			return;
+		}
+
+		if (size == 0)
+		{
+			break;
+		}
+
+		source->pushToFifo(static_cast<const char*>(data), size);
+		pa_stream_drop(stream);
+	}
+}
+
+void PulseStreamAudioSource::onStreamOverflow(pa_stream* /*stream*/, void* userData)
+{
+	auto* source = static_cast<PulseStreamAudioSource*>(userData);
+	++source->m_serverOverflows;
+}
+
+void PulseStreamAudioSource::pushToFifo(const char* data, size_t size)
+{
+	const size_t frameSize = pa_frame_size(&m_sampleSpec);
+	const size_t capacity = m_fifo.size();
+
+	// Only the newest samples are worth keeping if this is bigger than the whole FIFO
+	if (size > capacity)
+	{
+		m_droppedFrames += (size - capacity) / frameSize;
+		if (data != nullptr)
+		{
+			data += size - capacity;
+		}
+		size = capacity;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_fifoMutex);
+
+		// Make room by dropping the oldest samples, the recording thread has fallen behind
+		if (m_fifoSize + size > capacity)
+		{
+			const size_t excess = m_fifoSize + size - capacity;
+			m_fifoReadIndex = (m_fifoReadIndex + excess) % capacity;
+			m_fifoSize -= excess;
+			m_droppedFrames += excess / frameSize;
+		}
+
+		// Write in up to two parts, where the FIFO wraps around, holes in the stream are silence
+		const size_t writeIndex = (m_fifoReadIndex + m_fifoSize) % capacity;
+		const size_t firstPart = std::min(size, capacity - writeIndex);
+		if (data != nullptr)
+		{
+			std::memcpy(&m_fifo[writeIndex], data, firstPart);
+			std::memcpy(m_fifo.data(), data + firstPart, size - firstPart);
+		}
+		else
+		{
+			std::memset(&m_fifo[writeIndex], 0, firstPart);
+			std::memset(m_fifo.data(), 0, size - firstPart);
+		}
+
+		m_fifoSize += size;
+	}
+
+	m_fifoCondition.notify_one();
+}
+
+void PulseStreamAudioSource::fail()
+{
+	{
+		// Hold the FIFO lock so read() can't miss the wake up between checking and waiting
+		std::lock_guard<std::mutex> lock(m_fifoMutex);
+		m_failed = true;
+	}
+	m_fifoCondition.notify_all();
+}
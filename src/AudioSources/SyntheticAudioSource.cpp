@@ -0,0 +1,209 @@
+#include "AudioSources/SyntheticAudioSource.h"
+
+#include <fmt/core.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+namespace
+{
+	constexpr double twoPi = 6.283185307179586;
+
+	// xorshift32, cheap and deterministic, returns noise in [-1, 1)
+	float nextNoise(uint32_t& state)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return static_cast<float>(state) * (2.0f / 4294967296.0f) - 1.0f;
+	}
+};
+
+using namespace gaz;
+
+SyntheticAudioSource::SyntheticAudioSource(
+	const std::vector<Component>& components,
+	bool realTime,
+	std::optional<float> duration
+) :
+	m_components{components},
+	m_realTime{realTime},
+	m_duration{duration},
+	m_sampleSpec{},
+	m_sampleFormat{DSP::SampleFormat::Float32},
+	m_output{},
+	m_frameIndex{0},
+	m_frameLimit{},
+	m_phases(components.size(), 0.0),
+	m_noiseState{},
+	m_pacer{}
+{
+}
+
+bool SyntheticAudioSource::open(const pa_sample_spec& sampleSpec, unsigned int /*framesPerRead*/)
+{
+	const auto format = toDSPSampleFormat(sampleSpec.format);
+	if (!format.has_value())
+	{
+		fmt::print(
+			"SyntheticAudioSource::open: Can't generate {}\n",
+			pa_sample_format_to_string(sampleSpec.format)
+		);
+		return false;
+	}
+
+	m_sampleSpec = sampleSpec;
+	m_sampleFormat = *format;
+	m_frameIndex = 0;
+
+	if (m_duration.has_value())
+	{
+		m_frameLimit = static_cast<uint64_t>(*m_duration * sampleSpec.rate);
+	}
+
+	// Fixed seeds, so every run produces the same signal
+	m_noiseState.resize(sampleSpec.channels);
+	for (size_t i = 0; i < m_noiseState.size(); ++i)
+	{
+		m_noiseState[i] = 0x9E3779B9u * static_cast<uint32_t>(i + 1);
+	}
+
+	return true;
+}
+
+bool SyntheticAudioSource::read(char* buffer, size_t size)
+{
+	if (m_frameLimit.has_value() && m_frameIndex >= *m_frameLimit)
+	{
+		return false;
+	}
+
+	const unsigned int numChannels = m_sampleSpec.channels;
+	const double sampleRate = m_sampleSpec.rate;
+	const size_t numFrames = size / pa_frame_size(&m_sampleSpec);
+
+	// Generate floats, and convert them to the requested format at the end
+	m_output.resize(numFrames * numChannels);
+	float* output = m_output.data();
+
+	for (size_t frame = 0; frame < numFrames; ++frame, ++m_frameIndex)
+	{
+		// Sum the tonal components, these are shared by every channel
+		float tone = 0.0f;
+		for (size_t c = 0; c < m_components.size(); ++c)
+		{
+			const Component& component = m_components[c];
+			double frequency = component.frequency;
+
+			switch (component.type)
+			{
+				case Component::Type::Noise:
+					continue;
+				case Component::Type::Sweep:
+				{
+					// Exponential sweep, so it spends equal time in each octave
+					const double t = std::fmod(m_frameIndex / sampleRate, component.period) / component.period;
+					frequency = component.frequency * std::pow(component.frequencyEnd / component.frequency, t);
+					break;
+				}
+				case Component::Type::Sine:
+					break;
+			}
+
+			tone += component.amplitude * static_cast<float>(std::sin(twoPi * m_phases[c]));
+
+			m_phases[c] += frequency / sampleRate;
+			m_phases[c] -= std::floor(m_phases[c]);
+		}
+
+		for (unsigned int channel = 0; channel < numChannels; ++channel)
+		{
+			float sample = tone;
+			for (const auto& component : m_components)
+			{
+				if (component.type == Component::Type::Noise)
+				{
+					sample += component.amplitude * nextNoise(m_noiseState[channel]);
+				}
+			}
+
+			output[frame * numChannels + channel] = sample;
+		}
+	}
+
+	DSP::encodeSamples(output, m_sampleFormat, m_output.size(), buffer);
+
+	if (m_realTime)
+	{
+		m_pacer.wait(numFrames, m_sampleSpec.rate);
+	}
+
+	return true;
+}
+
+std::string SyntheticAudioSource::getName() const
+{
+	return fmt::format("Synthetic ({} components)", m_components.size());
+}
+
+std::optional<std::vector<SyntheticAudioSource::Component>> SyntheticAudioSource::parseSignal(
+	const std::string& description
+)
+{
+	std::vector<Component> components;
+
+	std::istringstream stream(description);
+	std::string token;
+	while (std::getline(stream, token, '+'))
+	{
+		Component component{Component::Type::Sine, 0.25f, 440.0f, 0.0f, 10.0f};
+
+		// Split off the amplitude
+		const auto amplitudePos = token.find('*');
+		if (amplitudePos != std::string::npos)
+		{
+			char* end = nullptr;
+			component.amplitude = std::strtof(token.c_str() + amplitudePos + 1, &end);
+			if (*end != '\0')
+			{
+				fmt::print("SyntheticAudioSource::parseSignal: Invalid amplitude in '{}'\n", token);
+				return {};
+			}
+			token.resize(amplitudePos);
+		}
+
+		if (token == "noise")
+		{
+			component.type = Component::Type::Noise;
+		}
+		else if (std::sscanf(token.c_str(), "sweep@%f-%f/%f",
+			&component.frequency, &component.frequencyEnd, &component.period) >= 2)
+		{
+			component.type = Component::Type::Sweep;
+			if (component.frequency <= 0.0f || component.frequencyEnd <= 0.0f || component.period <= 0.0f)
+			{
+				return {};
+			}
+		}
+		else if (std::sscanf(token.c_str(), "sine@%f", &component.frequency) == 1)
+		{
+			component.type = Component::Type::Sine;
+		}
+		else
+		{
+			fmt::print("SyntheticAudioSource::parseSignal: Unrecognised component '{}'\n", token);
+			return {};
+		}
+
+		components.push_back(component);
+	}
+
+	if (components.empty())
+	{
+		return {};
+	}
+
+	return components;
+}
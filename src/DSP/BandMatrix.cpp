@@ -0,0 +1,239 @@
+#include "DSP/BandMatrix.h"
+
+#include "DSP/SIMD.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+// Map between Hz and the (monotonic) scale the bands are evenly spaced on
+float hzToScale(DSP::BandScale scale, float hz)
+{
+	switch(scale)
+	{
+	case DSP::BandScale::Log:
+		return std::log2(hz);
+	case DSP::BandScale::Mel:
+		return 2595.0f * std::log10(1.0f + hz / 700.0f);
+	case DSP::BandScale::Bark:
+		return 26.81f * hz / (1960.0f + hz) - 0.53f;
+	}
+	return hz;
+}
+
+float scaleToHz(DSP::BandScale scale, float value)
+{
+	switch(scale)
+	{
+	case DSP::BandScale::Log:
+		return std::exp2(value);
+	case DSP::BandScale::Mel:
+		return 700.0f * (std::pow(10.0f, value / 2595.0f) - 1.0f);
+	case DSP::BandScale::Bark:
+		return 1960.0f * (value + 0.53f) / (26.28f - value);
+	}
+	return value;
+}
+
+// Σ weights[i] * (re[i]² + im[i]²), over 'count' interleaved complex values
+DSP_SCALAR_TAIL float weightedPowerScalar(const float* in, const float* weights, size_t count)
+{
+	// A few independent accumulators, so the adds don't serialise
+	float sum[4] = {};
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		for(size_t j = 0; j < 4; ++j)
+		{
+			const float re = in[2 * (i + j)];
+			const float im = in[2 * (i + j) + 1];
+			sum[j] += weights[i + j] * (re * re + im * im);
+		}
+	}
+	for(; i < count; ++i)
+	{
+		sum[0] += weights[i] * (in[2 * i] * in[2 * i] + in[2 * i + 1] * in[2 * i + 1]);
+	}
+	return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+}
+
+#if defined(__x86_64__)
+float weightedPowerSSE2(const float* in, const float* weights, size_t count)
+{
+	__m128 sum = _mm_setzero_ps();
+
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		const __m128 a = _mm_loadu_ps(in + 2 * i);
+		const __m128 b = _mm_loadu_ps(in + 2 * i + 4);
+		const __m128 sa = _mm_mul_ps(a, a);
+		const __m128 sb = _mm_mul_ps(b, b);
+		const __m128 power = _mm_add_ps(
+			_mm_shuffle_ps(sa, sb, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(sa, sb, _MM_SHUFFLE(3, 1, 3, 1)));
+		sum = _mm_add_ps(sum, _mm_mul_ps(power, _mm_loadu_ps(weights + i)));
+	}
+
+	float lanes[4];
+	_mm_storeu_ps(lanes, sum);
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + weightedPowerScalar(in + 2 * i, weights + i, count - i);
+}
+
+__attribute__((target("avx2,fma"))) float weightedPowerAVX2(const float* in, const float* weights, size_t count)
+{
+	__m256 sum = _mm256_setzero_ps();
+
+	size_t i = 0;
+	for(; i + 8 <= count; i += 8)
+	{
+		const __m256 a = _mm256_loadu_ps(in + 2 * i);
+		const __m256 b = _mm256_loadu_ps(in + 2 * i + 8);
+		// hadd pairs up (re², im²) within each 128 bit lane, giving bins 0 1 4 5 2 3 6 7, so put them back in order
+		const __m256 power = _mm256_castpd_ps(_mm256_permute4x64_pd(
+			_mm256_castps_pd(_mm256_hadd_ps(_mm256_mul_ps(a, a), _mm256_mul_ps(b, b))), _MM_SHUFFLE(3, 1, 2, 0)));
+		sum = _mm256_fmadd_ps(power, _mm256_loadu_ps(weights + i), sum);
+	}
+
+	const __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+	float lanes[4];
+	_mm_storeu_ps(lanes, half);
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + weightedPowerScalar(in + 2 * i, weights + i, count - i);
+}
+#endif
+
+typedef float (*WeightedPowerKernel)(const float*, const float*, size_t);
+
+WeightedPowerKernel selectKernel()
+{
+	switch(DSP::getSIMDLevel())
+	{
+#if defined(__x86_64__)
+	case DSP::SIMDLevel::AVX512:
+	case DSP::SIMDLevel::AVX2:
+		return weightedPowerAVX2;
+	case DSP::SIMDLevel::SSE2:
+		return weightedPowerSSE2;
+#endif
+	default:
+		return weightedPowerScalar;
+	}
+}
+} // namespace
+
+const char* DSP::toString(BandScale scale)
+{
+	switch(scale)
+	{
+	case BandScale::Log:
+		return "log";
+	case BandScale::Mel:
+		return "mel";
+	case BandScale::Bark:
+		return "Bark";
+	}
+	return "unknown";
+}
+
+DSP::BandMatrix DSP::BandMatrix::fromScale(
+	BandScale scale,
+	unsigned int numBands,
+	float minHz,
+	float maxHz,
+	unsigned int sampleRate,
+	unsigned int fftSize
+)
+{
+	// The log scale can't include 0Hz
+	minHz = std::max(minHz, 1.0f);
+	maxHz = std::max(maxHz, minHz);
+
+	const float minScale = hzToScale(scale, minHz);
+	const float maxScale = hzToScale(scale, maxHz);
+
+	std::vector<float> edges(numBands + 1);
+	for(unsigned int i = 0; i <= numBands; ++i)
+	{
+		edges[i] = scaleToHz(scale, minScale + (maxScale - minScale) * i / numBands);
+	}
+
+	// Avoid rounding error in the round trip at the ends
+	edges.front() = minHz;
+	edges.back() = maxHz;
+
+	return fromEdges(edges, sampleRate, fftSize);
+}
+
+DSP::BandMatrix DSP::BandMatrix::fromEdges(
+	const std::vector<float>& edgesHz,
+	unsigned int sampleRate,
+	unsigned int fftSize
+)
+{
+	BandMatrix matrix;
+	if(edgesHz.size() < 2)
+	{
+		return matrix;
+	}
+
+	// Bin k covers [k - 0.5, k + 0.5) in units of bins, only the first fftSize / 2 are usable
+	const unsigned int numBins = fftSize / 2;
+	const float binsPerHz = static_cast<float>(fftSize) / sampleRate;
+	const float maxBin = numBins - 0.5f;
+
+	matrix.m_bands.reserve(edgesHz.size() - 1);
+	for(size_t b = 0; b + 1 < edgesHz.size(); ++b)
+	{
+		const float low = std::clamp(edgesHz[b] * binsPerHz, -0.5f, maxBin);
+		const float high = std::clamp(edgesHz[b + 1] * binsPerHz, low, maxBin);
+
+		Band band{0, 0, matrix.m_weights.size()};
+
+		if(high > low)
+		{
+			const unsigned int first = static_cast<unsigned int>(std::floor(low + 0.5f));
+			const unsigned int last = std::min(static_cast<unsigned int>(std::ceil(high + 0.5f)), numBins);
+
+			// Fraction of each bin inside the band, normalised so the band reports the mean power of its bins
+			const float width = high - low;
+			for(unsigned int k = first; k < last; ++k)
+			{
+				const float overlap = std::min(high, k + 0.5f) - std::max(low, k - 0.5f);
+				matrix.m_weights.push_back(std::max(overlap, 0.0f) / width);
+			}
+
+			band.firstBin = first;
+			band.numBins = last - first;
+		}
+
+		matrix.m_bands.push_back(band);
+	}
+
+	return matrix;
+}
+
+void DSP::BandMatrix::scaleBins(const std::vector<float>& binGains)
+{
+	for(const Band& band : m_bands)
+	{
+		for(unsigned int i = 0; i < band.numBins && band.firstBin + i < binGains.size(); ++i)
+		{
+			m_weights[band.weightOffset + i] *= binGains[band.firstBin + i];
+		}
+	}
+}
+
+void DSP::BandMatrix::apply(const float* complexIn, float* out) const
+{
+	static const WeightedPowerKernel s_kernel = selectKernel();
+
+	for(size_t b = 0; b < m_bands.size(); ++b)
+	{
+		const Band& band = m_bands[b];
+		out[b] = s_kernel(complexIn + 2 * band.firstBin, m_weights.data() + band.weightOffset, band.numBins);
+	}
+}
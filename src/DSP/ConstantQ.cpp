@@ -0,0 +1,245 @@
+#include "DSP/ConstantQ.h"
+
+#include "DSP/FFTWisdom.h"
+#include "DSP/SIMD.h"
+
+#include <fftw3.h>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstring>
+#include <mutex>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+constexpr double twoPi = 6.283185307179586;
+
+// Spectral kernel values below this fraction of the kernel's peak are dropped, from Brown & Puckette
+constexpr float sparsityThreshold = 0.0054f;
+
+// Σ in[i] * weights[i], over 'count' interleaved complex values, into out[0] (re) and out[1] (im)
+DSP_SCALAR_TAIL void complexDotScalar(const float* in, const float* weights, size_t count, float* out)
+{
+	float re = 0.0f;
+	float im = 0.0f;
+	for(size_t i = 0; i < count; ++i)
+	{
+		const float xr = in[2 * i];
+		const float xi = in[2 * i + 1];
+		const float wr = weights[2 * i];
+		const float wi = weights[2 * i + 1];
+		re += xr * wr - xi * wi;
+		im += xr * wi + xi * wr;
+	}
+	out[0] = re;
+	out[1] = im;
+}
+
+#if defined(__x86_64__)
+// Accumulate (xr wr, xi wi) and (xr wi, xi wr) lane-wise, and only combine them into re / im at the end
+void complexDotSSE2(const float* in, const float* weights, size_t count, float* out)
+{
+	__m128 direct = _mm_setzero_ps();
+	__m128 crossed = _mm_setzero_ps();
+
+	size_t i = 0;
+	for(; i + 2 <= count; i += 2)
+	{
+		const __m128 x = _mm_loadu_ps(in + 2 * i);
+		const __m128 w = _mm_loadu_ps(weights + 2 * i);
+		direct = _mm_add_ps(direct, _mm_mul_ps(x, w));
+		crossed = _mm_add_ps(crossed, _mm_mul_ps(x, _mm_shuffle_ps(w, w, _MM_SHUFFLE(2, 3, 0, 1))));
+	}
+
+	float d[4];
+	float c[4];
+	_mm_storeu_ps(d, direct);
+	_mm_storeu_ps(c, crossed);
+
+	complexDotScalar(in + 2 * i, weights + 2 * i, count - i, out);
+	out[0] += (d[0] + d[2]) - (d[1] + d[3]);
+	out[1] += (c[0] + c[1]) + (c[2] + c[3]);
+}
+
+__attribute__((target("avx2,fma"))) void complexDotAVX2(
+	const float* in, const float* weights, size_t count, float* out)
+{
+	__m256 direct = _mm256_setzero_ps();
+	__m256 crossed = _mm256_setzero_ps();
+
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		const __m256 x = _mm256_loadu_ps(in + 2 * i);
+		const __m256 w = _mm256_loadu_ps(weights + 2 * i);
+		direct = _mm256_fmadd_ps(x, w, direct);
+		crossed = _mm256_fmadd_ps(x, _mm256_permute_ps(w, _MM_SHUFFLE(2, 3, 0, 1)), crossed);
+	}
+
+	float d[8];
+	float c[8];
+	_mm256_storeu_ps(d, direct);
+	_mm256_storeu_ps(c, crossed);
+
+	complexDotScalar(in + 2 * i, weights + 2 * i, count - i, out);
+	out[0] += ((d[0] + d[2]) + (d[4] + d[6])) - ((d[1] + d[3]) + (d[5] + d[7]));
+	out[1] += ((c[0] + c[1]) + (c[2] + c[3])) + ((c[4] + c[5]) + (c[6] + c[7]));
+}
+#endif
+
+typedef void (*ComplexDotKernel)(const float*, const float*, size_t, float*);
+
+ComplexDotKernel selectKernel()
+{
+	switch(DSP::getSIMDLevel())
+	{
+#if defined(__x86_64__)
+	case DSP::SIMDLevel::AVX512:
+	case DSP::SIMDLevel::AVX2:
+		return complexDotAVX2;
+	case DSP::SIMDLevel::SSE2:
+		return complexDotSSE2;
+#endif
+	default:
+		return complexDotScalar;
+	}
+}
+} // namespace
+
+using namespace DSP;
+
+ConstantQKernel::ConstantQKernel(
+	unsigned int sampleRate,
+	unsigned int fftSize,
+	float minHz,
+	float maxHz,
+	unsigned int binsPerOctave
+)
+	: m_binsPerOctave(std::max(binsPerOctave, 1u))
+	, m_minFrequency(minHz)
+	, m_bins()
+	, m_weights()
+{
+	// Each bin's bandwidth is the gap to the next one, so the kernel has to be Q cycles long
+	const double q = 1.0 / (std::exp2(1.0 / m_binsPerOctave) - 1.0);
+
+	// Raise the lowest bin, in whole steps so bins still land on the requested grid, until its kernel fits
+	const double lowestFit = q * sampleRate / fftSize;
+	if(m_minFrequency < lowestFit)
+	{
+		const double steps = std::ceil(m_binsPerOctave * std::log2(lowestFit / m_minFrequency));
+		m_minFrequency = static_cast<float>(m_minFrequency * std::exp2(steps / m_binsPerOctave));
+	}
+
+	// Stop before a bin's upper band edge passes the top of the range
+	const double topFrequency = std::min<double>(maxHz, sampleRate / 2.0);
+	const double halfStep = std::exp2(0.5 / m_binsPerOctave);
+	unsigned int numBins = 0;
+	while(m_minFrequency * std::exp2(static_cast<double>(numBins) / m_binsPerOctave) * halfStep <= topFrequency)
+	{
+		++numBins;
+	}
+
+	if(numBins == 0)
+	{
+		return;
+	}
+
+	// Kernels are computed with a complex DFT, they're only needed once so an estimated plan will do
+	fftwf_complex* kernel = fftwf_alloc_complex(fftSize);
+	fftwf_plan plan = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(fftwPlannerMutex());
+		plan = fftwf_plan_dft_1d(fftSize, kernel, kernel, FFTW_FORWARD, FFTW_ESTIMATE);
+	}
+
+	if(plan == nullptr)
+	{
+		fmt::print("DSP::ConstantQKernel: Failed to plan the kernel DFT\n");
+		fftwf_free(kernel);
+		return;
+	}
+
+	const unsigned int numUsableBins = fftSize / 2;
+	m_bins.reserve(numBins);
+	for(unsigned int k = 0; k < numBins; ++k)
+	{
+		const double frequency = getBinFrequency(k);
+		const unsigned int length = std::min(
+			static_cast<unsigned int>(std::ceil(q * sampleRate / frequency)), fftSize);
+
+		// Hann windowed complex sinusoid of exactly Q cycles, aligned to the end of the DFT window so every bin
+		// reflects the most recent samples
+		std::memset(kernel, 0, sizeof(fftwf_complex) * fftSize);
+		const unsigned int offset = fftSize - length;
+		for(unsigned int n = 0; n < length; ++n)
+		{
+			const double window = 0.5 - 0.5 * std::cos(twoPi * n / length);
+			const std::complex<double> value = std::polar(window / length, twoPi * q * n / length);
+			kernel[offset + n][0] = static_cast<float>(value.real());
+			kernel[offset + n][1] = static_cast<float>(value.imag());
+		}
+
+		fftwf_execute(plan);
+
+		// Keep the span around the peak, the kernel's negative frequencies are negligible
+		float peak = 0.0f;
+		for(unsigned int j = 0; j < numUsableBins; ++j)
+		{
+			peak = std::max(peak, std::hypot(kernel[j][0], kernel[j][1]));
+		}
+
+		unsigned int first = numUsableBins;
+		unsigned int last = 0;
+		for(unsigned int j = 0; j < numUsableBins; ++j)
+		{
+			if(std::hypot(kernel[j][0], kernel[j][1]) >= peak * sparsityThreshold)
+			{
+				first = std::min(first, j);
+				last = j + 1;
+			}
+		}
+
+		Bin bin{std::min(first, last), 0, m_weights.size()};
+		bin.numBins = last - bin.firstBin;
+
+		// By Parseval, Σ X[j] conj(K[j]) = fftSize * Σ x[n] conj(k[n]), which puts a sinusoid of amplitude A at
+		// A * fftSize / 4, the same as a Hann windowed DFT of the whole window
+		for(unsigned int j = bin.firstBin; j < last; ++j)
+		{
+			m_weights.push_back(kernel[j][0]);
+			m_weights.push_back(-kernel[j][1]);
+		}
+
+		m_bins.push_back(bin);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(fftwPlannerMutex());
+		fftwf_destroy_plan(plan);
+	}
+	fftwf_free(kernel);
+}
+
+float ConstantQKernel::getBinFrequency(unsigned int bin) const
+{
+	return m_minFrequency * std::exp2(static_cast<float>(bin) / m_binsPerOctave);
+}
+
+void ConstantQKernel::apply(const float* complexIn, float* out) const
+{
+	static const ComplexDotKernel s_kernel = selectKernel();
+
+	for(size_t k = 0; k < m_bins.size(); ++k)
+	{
+		const Bin& bin = m_bins[k];
+		s_kernel(complexIn + 2 * bin.firstBin, m_weights.data() + bin.weightOffset, bin.numBins, out + 2 * k);
+	}
+}
@@ -0,0 +1,210 @@
+#include "DSP/Decibels.h"
+
+#include "DSP/FastLog.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+// 10 * log10(x) = (10 * log10(2)) * log2(x)
+constexpr float decibelsPerLog2 = 3.01029995663981f;
+
+// The floor as a power, so that the log never sees zero or a denormal
+float floorPower(float floorDb)
+{
+	return std::max(std::pow(10.0f, floorDb / 10.0f), FLT_MIN);
+}
+
+// With offsets a bin below the floor could be lifted back over it, so only the log's own limit applies to the power
+template <bool Offsets>
+float minPower(float floorDb)
+{
+	return Offsets ? FLT_MIN : floorPower(floorDb);
+}
+
+// The tail of 'offsets' from 'i', which is nullptr without them
+template <bool Offsets>
+const float* offsetsFrom(const float* offsets, size_t i)
+{
+	return Offsets ? offsets + i : nullptr;
+}
+
+template <bool Offsets>
+DSP_SCALAR_TAIL void powerToDecibelsScalar(
+	const float* in, size_t count, float floorDb, const float* offsets, float* out)
+{
+	const float minimum = minPower<Offsets>(floorDb);
+	for(size_t i = 0; i < count; ++i)
+	{
+		const float re = in[2 * i];
+		const float im = in[2 * i + 1];
+		const float power = std::max(re * re + im * im, minimum);
+		float decibels = decibelsPerLog2 * DSP::FastLog::log2(power);
+		if constexpr(Offsets)
+		{
+			decibels += offsets[i];
+		}
+		out[i] = std::max(decibels, floorDb);
+	}
+}
+
+#if defined(__x86_64__)
+template <bool Offsets>
+void powerToDecibelsSSE2(const float* in, size_t count, float floorDb, const float* offsets, float* out)
+{
+	const __m128 minimum = _mm_set1_ps(minPower<Offsets>(floorDb));
+	const __m128 floor = _mm_set1_ps(floorDb);
+	const __m128 scale = _mm_set1_ps(decibelsPerLog2);
+
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		// re0 im0 re1 im1 | re2 im2 re3 im3 -> power of bins 0..3
+		const __m128 a = _mm_loadu_ps(in + 2 * i);
+		const __m128 b = _mm_loadu_ps(in + 2 * i + 4);
+		const __m128 sa = _mm_mul_ps(a, a);
+		const __m128 sb = _mm_mul_ps(b, b);
+		__m128 power = _mm_add_ps(
+			_mm_shuffle_ps(sa, sb, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(sa, sb, _MM_SHUFFLE(3, 1, 3, 1)));
+		power = _mm_max_ps(power, minimum);
+
+		const __m128 log2 = DSP::FastLog::log2SSE2(power);
+
+		__m128 decibels = _mm_mul_ps(log2, scale);
+		if constexpr(Offsets)
+		{
+			decibels = _mm_add_ps(decibels, _mm_loadu_ps(offsets + i));
+		}
+
+		_mm_storeu_ps(out + i, _mm_max_ps(decibels, floor));
+	}
+
+	powerToDecibelsScalar<Offsets>(in + 2 * i, count - i, floorDb, offsetsFrom<Offsets>(offsets, i), out + i);
+}
+
+template <bool Offsets>
+__attribute__((target("avx2,fma"))) void powerToDecibelsAVX2(
+	const float* in, size_t count, float floorDb, const float* offsets, float* out)
+{
+	const __m256 minimum = _mm256_set1_ps(minPower<Offsets>(floorDb));
+	const __m256 floor = _mm256_set1_ps(floorDb);
+	const __m256 scale = _mm256_set1_ps(decibelsPerLog2);
+
+	size_t i = 0;
+	for(; i + 8 <= count; i += 8)
+	{
+		const __m256 a = _mm256_loadu_ps(in + 2 * i);
+		const __m256 b = _mm256_loadu_ps(in + 2 * i + 8);
+		const __m256 sa = _mm256_mul_ps(a, a);
+		const __m256 sb = _mm256_mul_ps(b, b);
+		// Shuffles stay within 128 bit lanes, giving bins 0 1 4 5 2 3 6 7, so swap the middle 64 bit pairs
+		const __m256 shuffled = _mm256_add_ps(
+			_mm256_shuffle_ps(sa, sb, _MM_SHUFFLE(2, 0, 2, 0)), _mm256_shuffle_ps(sa, sb, _MM_SHUFFLE(3, 1, 3, 1)));
+		__m256 power = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(shuffled), _MM_SHUFFLE(3, 1, 2, 0)));
+		power = _mm256_max_ps(power, minimum);
+
+		const __m256 log2 = DSP::FastLog::log2AVX2(power);
+
+		// The offset folds into the scaling for free
+		const __m256 decibels = Offsets ?
+			_mm256_fmadd_ps(log2, scale, _mm256_loadu_ps(offsets + i)) :
+			_mm256_mul_ps(log2, scale);
+
+		_mm256_storeu_ps(out + i, _mm256_max_ps(decibels, floor));
+	}
+
+	powerToDecibelsScalar<Offsets>(in + 2 * i, count - i, floorDb, offsetsFrom<Offsets>(offsets, i), out + i);
+}
+
+// GCC 12's AVX-512 intrinsics trip a false positive in -Wmaybe-uninitialized (GCC bug 105593)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+template <bool Offsets>
+__attribute__((target("avx512f"))) void powerToDecibelsAVX512(
+	const float* in, size_t count, float floorDb, const float* offsets, float* out)
+{
+	const __m512 minimum = _mm512_set1_ps(minPower<Offsets>(floorDb));
+	const __m512 floor = _mm512_set1_ps(floorDb);
+	const __m512 scale = _mm512_set1_ps(decibelsPerLog2);
+	// Gather the real / imaginary parts across both registers, in bin order
+	const __m512i evenIndices = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+	const __m512i oddIndices = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31);
+
+	size_t i = 0;
+	for(; i + 16 <= count; i += 16)
+	{
+		const __m512 a = _mm512_loadu_ps(in + 2 * i);
+		const __m512 b = _mm512_loadu_ps(in + 2 * i + 16);
+		const __m512 sa = _mm512_mul_ps(a, a);
+		const __m512 sb = _mm512_mul_ps(b, b);
+		__m512 power = _mm512_add_ps(
+			_mm512_permutex2var_ps(sa, evenIndices, sb), _mm512_permutex2var_ps(sa, oddIndices, sb));
+		power = _mm512_max_ps(power, minimum);
+
+		const __m512 log2 = DSP::FastLog::log2AVX512(power);
+
+		const __m512 decibels = Offsets ?
+			_mm512_fmadd_ps(log2, scale, _mm512_loadu_ps(offsets + i)) :
+			_mm512_mul_ps(log2, scale);
+
+		_mm512_storeu_ps(out + i, _mm512_max_ps(decibels, floor));
+	}
+
+	powerToDecibelsScalar<Offsets>(in + 2 * i, count - i, floorDb, offsetsFrom<Offsets>(offsets, i), out + i);
+}
+#pragma GCC diagnostic pop
+#endif
+
+typedef void (*DecibelKernel)(const float*, size_t, float, const float*, float*);
+
+template <bool Offsets>
+DecibelKernel selectKernel(DSP::SIMDLevel level)
+{
+	switch(std::min(level, DSP::getSIMDLevel()))
+	{
+#if defined(__x86_64__)
+	case DSP::SIMDLevel::AVX512:
+		return powerToDecibelsAVX512<Offsets>;
+	case DSP::SIMDLevel::AVX2:
+		return powerToDecibelsAVX2<Offsets>;
+	case DSP::SIMDLevel::SSE2:
+		return powerToDecibelsSSE2<Offsets>;
+#endif
+	default:
+		return powerToDecibelsScalar<Offsets>;
+	}
+}
+
+DecibelKernel selectKernel(DSP::SIMDLevel level, const float* offsetsDb)
+{
+	return offsetsDb != nullptr ? selectKernel<true>(level) : selectKernel<false>(level);
+}
+} // namespace
+
+void DSP::powerToDecibels(const float* complexIn, size_t count, float floorDb, const float* offsetsDb, float* out)
+{
+	static const DecibelKernel s_kernel = selectKernel<false>(getSIMDLevel());
+	static const DecibelKernel s_offsetKernel = selectKernel<true>(getSIMDLevel());
+	(offsetsDb != nullptr ? s_offsetKernel : s_kernel)(complexIn, count, floorDb, offsetsDb, out);
+}
+
+void DSP::powerToDecibels(
+	SIMDLevel level, const float* complexIn, size_t count, float floorDb, const float* offsetsDb, float* out)
+{
+	selectKernel(level, offsetsDb)(complexIn, count, floorDb, offsetsDb, out);
+}
+
+void DSP::powerToDecibelsReal(const float* power, size_t count, float floorDb, float* out)
+{
+	const float minPower = floorPower(floorDb);
+	for(size_t i = 0; i < count; ++i)
+	{
+		out[i] = std::max(decibelsPerLog2 * DSP::FastLog::log2(std::max(power[i], minPower)), floorDb);
+	}
+}
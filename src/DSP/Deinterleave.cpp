@@ -0,0 +1,87 @@
+#include "DSP/Deinterleave.h"
+
+#include "DSP/PCM.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+// Round to the nearest integer sample, with 'fullScale' = 2^(bits - 1)
+int32_t quantise(float value, double fullScale)
+{
+	const double scaled = std::nearbyint(static_cast<double>(value) * fullScale);
+	return static_cast<int32_t>(std::clamp(scaled, -fullScale, fullScale - 1.0));
+}
+} // namespace
+
+void DSP::deinterleave(
+	const void* in, SampleFormat format, unsigned int numChannels, size_t numFrames, float* const* out)
+{
+	const char* bytes = static_cast<const char*>(in);
+
+	switch(format)
+	{
+	case SampleFormat::Float32:
+		PCM::deinterleave<PCM::Float32>(bytes, numChannels, numFrames, out);
+		break;
+	case SampleFormat::S16:
+		PCM::deinterleave<PCM::S16>(bytes, numChannels, numFrames, out);
+		break;
+	case SampleFormat::S24:
+		PCM::deinterleave<PCM::S24>(bytes, numChannels, numFrames, out);
+		break;
+	case SampleFormat::S24In32:
+		PCM::deinterleave<PCM::S24In32>(bytes, numChannels, numFrames, out);
+		break;
+	case SampleFormat::S32:
+		PCM::deinterleave<PCM::S32>(bytes, numChannels, numFrames, out);
+		break;
+	}
+}
+
+void DSP::encodeSamples(const float* in, SampleFormat format, size_t count, void* out)
+{
+	char* bytes = static_cast<char*>(out);
+
+	for(size_t i = 0; i < count; ++i)
+	{
+		switch(format)
+		{
+		case SampleFormat::Float32:
+		{
+			const float value = std::clamp(in[i], -1.0f, 1.0f);
+			std::memcpy(bytes + i * sizeof(value), &value, sizeof(value));
+			break;
+		}
+		case SampleFormat::S16:
+		{
+			const int16_t value = static_cast<int16_t>(quantise(in[i], 32768.0));
+			std::memcpy(bytes + i * sizeof(value), &value, sizeof(value));
+			break;
+		}
+		case SampleFormat::S24:
+		{
+			const uint32_t value = static_cast<uint32_t>(quantise(in[i], 8388608.0));
+			bytes[i * 3] = static_cast<char>(value & 0xFF);
+			bytes[i * 3 + 1] = static_cast<char>((value >> 8) & 0xFF);
+			bytes[i * 3 + 2] = static_cast<char>((value >> 16) & 0xFF);
+			break;
+		}
+		case SampleFormat::S24In32:
+		{
+			const int32_t value = quantise(in[i], 8388608.0);
+			std::memcpy(bytes + i * sizeof(value), &value, sizeof(value));
+			break;
+		}
+		case SampleFormat::S32:
+		{
+			const int32_t value = quantise(in[i], 2147483648.0);
+			std::memcpy(bytes + i * sizeof(value), &value, sizeof(value));
+			break;
+		}
+		}
+	}
+}
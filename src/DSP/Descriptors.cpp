@@ -0,0 +1,266 @@
+#include "DSP/Descriptors.h"
+
+#include "DSP/FastLog.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+using DSP::SpectralDescriptors;
+
+// Everything the descriptors need from one pass over the bins. The moments are in double, since the bandwidth is the
+// difference of two of them, which are each up to count² times larger
+struct Sums
+{
+	double power = 0.0; // Σp
+	double weighted = 0.0; // Σk p
+	double weightedSquares = 0.0; // Σk² p
+	double logPower = 0.0; // Σlog2 p, with p clamped to FLT_MIN
+	double rise = 0.0; // Σmax(p - p', 0)
+	float peak = 0.0f; // max p
+};
+
+// Accumulate bins 'begin' to 'count' into 'sums'
+DSP_SCALAR_TAIL void accumulateScalar(const float* in, size_t begin, size_t count, float* power, Sums& sums)
+{
+	for(size_t i = begin; i < count; ++i)
+	{
+		const float re = in[2 * i];
+		const float im = in[2 * i + 1];
+		const float p = re * re + im * im;
+
+		sums.rise += std::max(p - power[i], 0.0f);
+		power[i] = p;
+
+		const double k = static_cast<double>(i);
+		sums.power += p;
+		sums.weighted += k * p;
+		sums.weightedSquares += k * k * p;
+		sums.logPower += DSP::FastLog::log2(std::max(p, FLT_MIN));
+		sums.peak = std::max(sums.peak, p);
+	}
+}
+
+#if defined(__x86_64__)
+double horizontalSum(__m128d x)
+{
+	return _mm_cvtsd_f64(_mm_add_sd(x, _mm_unpackhi_pd(x, x)));
+}
+
+double horizontalSum(__m128 x)
+{
+	return horizontalSum(_mm_add_pd(_mm_cvtps_pd(x), _mm_cvtps_pd(_mm_movehl_ps(x, x))));
+}
+
+float horizontalMax(__m128 x)
+{
+	x = _mm_max_ps(x, _mm_movehl_ps(x, x));
+	return _mm_cvtss_f32(_mm_max_ss(x, _mm_shuffle_ps(x, x, _MM_SHUFFLE(1, 1, 1, 1))));
+}
+
+void accumulateSSE2(const float* in, size_t count, float* power, Sums& sums)
+{
+	const __m128 minimum = _mm_set1_ps(FLT_MIN);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 four = _mm_set1_ps(4.0f);
+
+	__m128 bins = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+	__m128d total = _mm_setzero_pd();
+	__m128d weighted = _mm_setzero_pd();
+	__m128d weightedSquares = _mm_setzero_pd();
+	__m128 logPower = zero;
+	__m128 rise = zero;
+	__m128 peak = zero;
+
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		const __m128 a = _mm_loadu_ps(in + 2 * i);
+		const __m128 b = _mm_loadu_ps(in + 2 * i + 4);
+		const __m128 sa = _mm_mul_ps(a, a);
+		const __m128 sb = _mm_mul_ps(b, b);
+		const __m128 p = _mm_add_ps(
+			_mm_shuffle_ps(sa, sb, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(sa, sb, _MM_SHUFFLE(3, 1, 3, 1)));
+
+		rise = _mm_add_ps(rise, _mm_max_ps(_mm_sub_ps(p, _mm_loadu_ps(power + i)), zero));
+		_mm_storeu_ps(power + i, p);
+
+		peak = _mm_max_ps(peak, p);
+		logPower = _mm_add_ps(logPower, DSP::FastLog::log2SSE2(_mm_max_ps(p, minimum)));
+
+		const __m128d pLow = _mm_cvtps_pd(p);
+		const __m128d pHigh = _mm_cvtps_pd(_mm_movehl_ps(p, p));
+		const __m128d kLow = _mm_cvtps_pd(bins);
+		const __m128d kHigh = _mm_cvtps_pd(_mm_movehl_ps(bins, bins));
+		const __m128d kpLow = _mm_mul_pd(kLow, pLow);
+		const __m128d kpHigh = _mm_mul_pd(kHigh, pHigh);
+		total = _mm_add_pd(total, _mm_add_pd(pLow, pHigh));
+		weighted = _mm_add_pd(weighted, _mm_add_pd(kpLow, kpHigh));
+		weightedSquares = _mm_add_pd(weightedSquares, _mm_add_pd(_mm_mul_pd(kLow, kpLow), _mm_mul_pd(kHigh, kpHigh)));
+
+		bins = _mm_add_ps(bins, four);
+	}
+
+	sums.power = horizontalSum(total);
+	sums.weighted = horizontalSum(weighted);
+	sums.weightedSquares = horizontalSum(weightedSquares);
+	sums.logPower = horizontalSum(logPower);
+	sums.rise = horizontalSum(rise);
+	sums.peak = horizontalMax(peak);
+
+	accumulateScalar(in, i, count, power, sums);
+}
+
+__attribute__((target("avx2,fma"))) double horizontalSum(__m256d x)
+{
+	return horizontalSum(_mm_add_pd(_mm256_castpd256_pd128(x), _mm256_extractf128_pd(x, 1)));
+}
+
+__attribute__((target("avx2,fma"))) __m256d lowToDouble(__m256 x)
+{
+	return _mm256_cvtps_pd(_mm256_castps256_ps128(x));
+}
+
+__attribute__((target("avx2,fma"))) __m256d highToDouble(__m256 x)
+{
+	return _mm256_cvtps_pd(_mm256_extractf128_ps(x, 1));
+}
+
+__attribute__((target("avx2,fma"))) void accumulateAVX2(const float* in, size_t count, float* power, Sums& sums)
+{
+	const __m256 minimum = _mm256_set1_ps(FLT_MIN);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 eight = _mm256_set1_ps(8.0f);
+
+	__m256 bins = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+	__m256d total = _mm256_setzero_pd();
+	__m256d weighted = _mm256_setzero_pd();
+	__m256d weightedSquares = _mm256_setzero_pd();
+	__m256 logPower = zero;
+	__m256 rise = zero;
+	__m256 peak = zero;
+
+	size_t i = 0;
+	for(; i + 8 <= count; i += 8)
+	{
+		const __m256 a = _mm256_loadu_ps(in + 2 * i);
+		const __m256 b = _mm256_loadu_ps(in + 2 * i + 8);
+		const __m256 sa = _mm256_mul_ps(a, a);
+		const __m256 sb = _mm256_mul_ps(b, b);
+		// Shuffles stay within 128 bit lanes, giving bins 0 1 4 5 2 3 6 7, so swap the middle 64 bit pairs
+		const __m256 shuffled = _mm256_add_ps(
+			_mm256_shuffle_ps(sa, sb, _MM_SHUFFLE(2, 0, 2, 0)), _mm256_shuffle_ps(sa, sb, _MM_SHUFFLE(3, 1, 3, 1)));
+		const __m256 p = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(shuffled), _MM_SHUFFLE(3, 1, 2, 0)));
+
+		rise = _mm256_add_ps(rise, _mm256_max_ps(_mm256_sub_ps(p, _mm256_loadu_ps(power + i)), zero));
+		_mm256_storeu_ps(power + i, p);
+
+		peak = _mm256_max_ps(peak, p);
+		logPower = _mm256_add_ps(logPower, DSP::FastLog::log2AVX2(_mm256_max_ps(p, minimum)));
+
+		const __m256d pLow = lowToDouble(p);
+		const __m256d pHigh = highToDouble(p);
+		const __m256d kLow = lowToDouble(bins);
+		const __m256d kHigh = highToDouble(bins);
+		const __m256d kpLow = _mm256_mul_pd(kLow, pLow);
+		const __m256d kpHigh = _mm256_mul_pd(kHigh, pHigh);
+		total = _mm256_add_pd(total, _mm256_add_pd(pLow, pHigh));
+		weighted = _mm256_add_pd(weighted, _mm256_add_pd(kpLow, kpHigh));
+		weightedSquares = _mm256_fmadd_pd(kLow, kpLow, _mm256_fmadd_pd(kHigh, kpHigh, weightedSquares));
+
+		bins = _mm256_add_ps(bins, eight);
+	}
+
+	const __m128 peak128 = _mm_max_ps(_mm256_castps256_ps128(peak), _mm256_extractf128_ps(peak, 1));
+	sums.power = horizontalSum(total);
+	sums.weighted = horizontalSum(weighted);
+	sums.weightedSquares = horizontalSum(weightedSquares);
+	sums.logPower = horizontalSum(_mm_add_ps(_mm256_castps256_ps128(logPower), _mm256_extractf128_ps(logPower, 1)));
+	sums.rise = horizontalSum(_mm_add_ps(_mm256_castps256_ps128(rise), _mm256_extractf128_ps(rise, 1)));
+	sums.peak = horizontalMax(peak128);
+
+	accumulateScalar(in, i, count, power, sums);
+}
+#endif
+
+void accumulate(const float* in, size_t count, float* power, Sums& sums)
+{
+	accumulateScalar(in, 0, count, power, sums);
+}
+
+typedef void (*DescriptorKernel)(const float*, size_t, float*, Sums&);
+
+DescriptorKernel selectKernel(DSP::SIMDLevel level)
+{
+	switch(std::min(level, DSP::getSIMDLevel()))
+	{
+#if defined(__x86_64__)
+	case DSP::SIMDLevel::AVX512:
+	case DSP::SIMDLevel::AVX2:
+		return accumulateAVX2;
+	case DSP::SIMDLevel::SSE2:
+		return accumulateSSE2;
+#endif
+	default:
+		return accumulate;
+	}
+}
+
+SpectralDescriptors describe(const Sums& sums, const float* power, size_t count, float hzPerBin)
+{
+	SpectralDescriptors descriptors;
+	if(count == 0 || !(sums.power > 0.0))
+	{
+		return descriptors;
+	}
+
+	const double mean = sums.power / count;
+	const double centroid = sums.weighted / sums.power;
+	const double variance = std::max(sums.weightedSquares / sums.power - centroid * centroid, 0.0);
+
+	descriptors.centroid = static_cast<float>(centroid * hzPerBin);
+	descriptors.bandwidth = static_cast<float>(std::sqrt(variance) * hzPerBin);
+	descriptors.flatness = static_cast<float>(std::min(std::exp2(sums.logPower / count) / mean, 1.0));
+	descriptors.crest = static_cast<float>(10.0 * std::log10(sums.peak / mean));
+	descriptors.flux = static_cast<float>(std::min(sums.rise / sums.power, 1.0));
+
+	// A running total doesn't vectorise, so the rolloff is a second pass over the powers while they're still in
+	// cache. Most of the power of real signals is in the low bins, so it rarely scans far
+	const double target = DSP::s_rolloffFraction * sums.power;
+	double cumulative = 0.0;
+	size_t bin = 0;
+	for(; bin + 1 < count; ++bin)
+	{
+		cumulative += power[bin];
+		if(cumulative >= target)
+		{
+			break;
+		}
+	}
+	descriptors.rolloff = bin * hzPerBin;
+
+	return descriptors;
+}
+} // namespace
+
+DSP::SpectralDescriptors DSP::spectralDescriptors(const float* complexIn, size_t count, float hzPerBin, float* power)
+{
+	static const DescriptorKernel s_kernel = selectKernel(getSIMDLevel());
+	Sums sums;
+	s_kernel(complexIn, count, power, sums);
+	return describe(sums, power, count, hzPerBin);
+}
+
+DSP::SpectralDescriptors DSP::spectralDescriptors(
+	SIMDLevel level, const float* complexIn, size_t count, float hzPerBin, float* power)
+{
+	Sums sums;
+	selectKernel(level)(complexIn, count, power, sums);
+	return describe(sums, power, count, hzPerBin);
+}
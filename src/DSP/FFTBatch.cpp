@@ -0,0 +1,269 @@
+#include "DSP/FFTBatch.h"
+
+#include "DSP/FFTWisdom.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace
+{
+// Pad each channel to a multiple of 64 bytes, enough for AVX-512 loads
+constexpr size_t alignmentBytes = 64;
+
+size_t alignedStride(size_t count, size_t elementSize)
+{
+	const size_t elementsPerAlignment = alignmentBytes / elementSize;
+	return (count + elementsPerAlignment - 1) / elementsPerAlignment * elementsPerAlignment;
+}
+
+// Channels in each group, when they're split as evenly as they can be into at most 'numGroups'
+unsigned int groupSize(unsigned int numChannels, unsigned int numGroups)
+{
+	const unsigned int groups = std::clamp(numGroups, 1u, std::max(numChannels, 1u));
+	return std::max((numChannels + groups - 1) / groups, 1u);
+}
+
+// Rounding the group size up can leave fewer groups needed, e.g. 6 channels in 4 groups is 3 groups of 2, rather
+// than a 4th group of nothing but padding
+unsigned int groupsNeeded(unsigned int numChannels, unsigned int numGroups)
+{
+	const unsigned int size = groupSize(numChannels, numGroups);
+	return std::max((numChannels + size - 1) / size, 1u);
+}
+
+// A plan for one group of channels, laid out like FFTBatch's. Takes the planner lock, for as long as planning takes
+fftwf_plan planGroup(
+	unsigned int size,
+	unsigned int channelsPerGroup,
+	size_t inputStride,
+	size_t outputStride,
+	float* input,
+	fftwf_complex* output,
+	unsigned int flags)
+{
+	const int n[] = { static_cast<int>(size) };
+
+	std::lock_guard<std::mutex> lock(DSP::fftwPlannerMutex());
+
+	// Each channel is contiguous (stride 1) and 'stride' elements after the last
+	return fftwf_plan_many_dft_r2c(
+		1, // rank
+		n,
+		static_cast<int>(channelsPerGroup), // howmany
+		input,
+		nullptr, // inembed, same as n
+		1, // istride
+		static_cast<int>(inputStride), // idist
+		output,
+		nullptr, // onembed, same as n / 2 + 1
+		1, // ostride
+		static_cast<int>(outputStride), // odist
+		flags | FFTW_DESTROY_INPUT);
+}
+} // namespace
+
+using namespace DSP;
+
+struct FFTBatch::Upgrade
+{
+	// Guards the rest. 'batch' is cleared when it's destroyed, and if that's mid upgrade, its plan is handed over
+	// to be destroyed once the planner is free
+	std::mutex mutex;
+	FFTBatch* batch = nullptr;
+	bool started = false;
+	bool finished = false;
+	fftwf_plan abandonedPlan = nullptr;
+
+	// Copied, so the thread doesn't need the batch to plan
+	unsigned int size = 0;
+	unsigned int channelsPerGroup = 0;
+	size_t inputStride = 0;
+	size_t outputStride = 0;
+	std::string wisdomPath;
+};
+
+FFTBatch::FFTBatch(unsigned int size, unsigned int numChannels, Planning planning, unsigned int numGroups)
+	: m_size(size)
+	, m_numChannels(numChannels)
+	, m_numGroups(groupsNeeded(numChannels, numGroups))
+	, m_channelsPerGroup(groupSize(numChannels, numGroups))
+	, m_inputStride(alignedStride(size, sizeof(float)))
+	, m_outputStride(alignedStride(size / 2 + 1, sizeof(fftwf_complex)))
+	, m_input(fftwf_alloc_real(m_inputStride * m_channelsPerGroup * m_numGroups))
+	, m_output(fftwf_alloc_complex(m_outputStride * m_channelsPerGroup * m_numGroups))
+	, m_initialPlan(nullptr)
+	, m_upgradedPlan(nullptr)
+	, m_activePlan(nullptr)
+	, m_isOptimal(false)
+	, m_upgrade()
+{
+	// The padding channels are never read, but they're zeroed so the DFT doesn't chew on garbage
+	std::fill(m_input, m_input + m_inputStride * m_channelsPerGroup * m_numGroups, 0.0f);
+
+	const std::string wisdomPath = wisdomCachePath(m_size, m_channelsPerGroup);
+	{
+		std::lock_guard<std::mutex> lock(fftwPlannerMutex());
+		loadWisdom(wisdomPath);
+	}
+
+	// If we've planned this before, the patient plan is instant
+	m_initialPlan = makePlan(m_input, m_output, FFTW_PATIENT | FFTW_WISDOM_ONLY);
+	if(m_initialPlan != nullptr)
+	{
+		fmt::print("DSP::FFTBatch: Using cached plan from '{}'\n", wisdomPath);
+		m_isOptimal = true;
+	}
+	else if(planning == Planning::Patient)
+	{
+		m_initialPlan = makePlan(m_input, m_output, FFTW_PATIENT);
+		m_isOptimal = true;
+
+		std::lock_guard<std::mutex> lock(fftwPlannerMutex());
+		saveWisdom(wisdomPath);
+	}
+	else if(planning == Planning::Measure)
+	{
+		m_initialPlan = makePlan(m_input, m_output, FFTW_MEASURE);
+	}
+	else
+	{
+		m_initialPlan = makePlan(m_input, m_output, FFTW_ESTIMATE);
+		if(m_initialPlan != nullptr)
+		{
+			m_upgrade = std::make_shared<Upgrade>();
+			m_upgrade->batch = this;
+			m_upgrade->size = m_size;
+			m_upgrade->channelsPerGroup = m_channelsPerGroup;
+			m_upgrade->inputStride = m_inputStride;
+			m_upgrade->outputStride = m_outputStride;
+			m_upgrade->wisdomPath = wisdomPath;
+		}
+	}
+
+	m_activePlan.store(m_initialPlan, std::memory_order_release);
+}
+
+FFTBatch::~FFTBatch()
+{
+	// Patient planning can take minutes and can't be interrupted, so leave the thread to finish it, and save the
+	// wisdom for next time, without us. It has the planner until then, so it destroys our plan too
+	if(m_upgrade != nullptr)
+	{
+		std::lock_guard<std::mutex> lock(m_upgrade->mutex);
+		m_upgrade->batch = nullptr;
+		if(m_upgrade->started && !m_upgrade->finished)
+		{
+			m_upgrade->abandonedPlan = m_initialPlan;
+			m_initialPlan = nullptr;
+		}
+	}
+
+	if(m_initialPlan != nullptr || m_upgradedPlan != nullptr)
+	{
+		std::lock_guard<std::mutex> lock(fftwPlannerMutex());
+		if(m_initialPlan != nullptr)
+		{
+			fftwf_destroy_plan(m_initialPlan);
+		}
+		if(m_upgradedPlan != nullptr)
+		{
+			fftwf_destroy_plan(m_upgradedPlan);
+		}
+	}
+
+	fftwf_free(m_output);
+	fftwf_free(m_input);
+}
+
+void FFTBatch::startUpgrade()
+{
+	if(m_upgrade == nullptr)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_upgrade->mutex);
+	if(!m_upgrade->started)
+	{
+		m_upgrade->started = true;
+		std::thread(&FFTBatch::upgradePlan, m_upgrade).detach();
+	}
+}
+
+fftwf_plan FFTBatch::makePlan(float* input, fftwf_complex* output, unsigned int flags) const
+{
+	return planGroup(m_size, m_channelsPerGroup, m_inputStride, m_outputStride, input, output, flags);
+}
+
+void FFTBatch::upgradePlan(std::shared_ptr<Upgrade> upgrade)
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	// Patient planning scribbles over the buffers, so don't use the live ones
+	float* scratchInput = fftwf_alloc_real(upgrade->inputStride * upgrade->channelsPerGroup);
+	fftwf_complex* scratchOutput = fftwf_alloc_complex(upgrade->outputStride * upgrade->channelsPerGroup);
+
+	fftwf_plan plan = planGroup(
+		upgrade->size,
+		upgrade->channelsPerGroup,
+		upgrade->inputStride,
+		upgrade->outputStride,
+		scratchInput,
+		scratchOutput,
+		FFTW_PATIENT);
+
+	fftwf_free(scratchOutput);
+	fftwf_free(scratchInput);
+
+	fftwf_plan abandonedPlan = nullptr;
+	fftwf_plan abandonedUpgrade = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(upgrade->mutex);
+		upgrade->finished = true;
+		if(upgrade->batch == nullptr)
+		{
+			abandonedPlan = upgrade->abandonedPlan;
+			abandonedUpgrade = plan;
+		}
+		else if(plan != nullptr)
+		{
+			// Hot swap, the next execute() picks it up, and the batch destroys it
+			upgrade->batch->m_upgradedPlan = plan;
+			upgrade->batch->m_activePlan.store(plan, std::memory_order_release);
+			upgrade->batch->m_isOptimal = true;
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(fftwPlannerMutex());
+		for(fftwf_plan abandoned : {abandonedPlan, abandonedUpgrade})
+		{
+			if(abandoned != nullptr)
+			{
+				fftwf_destroy_plan(abandoned);
+			}
+		}
+
+		// Even if the batch has gone, the wisdom's worth keeping
+		if(plan != nullptr)
+		{
+			saveWisdom(upgrade->wisdomPath);
+		}
+	}
+
+	if(plan == nullptr)
+	{
+		fmt::print("DSP::FFTBatch: Failed to make a patient plan, keeping the estimated one\n");
+		return;
+	}
+
+	fmt::print(
+		"DSP::FFTBatch: Made a patient plan after {}ms, saved to '{}'\n",
+		std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count(),
+		upgrade->wisdomPath);
+}
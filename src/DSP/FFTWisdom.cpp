@@ -0,0 +1,112 @@
+#include "DSP/FFTWisdom.h"
+
+#include <fftw3.h>
+
+#include <fmt/core.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <system_error>
+
+namespace
+{
+// The widest SIMD extension fftw could be using, wisdom planned on one CPU isn't valid for another
+const char* cpuFeatures()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	if(__builtin_cpu_supports("avx512f"))
+	{
+		return "avx512";
+	}
+	if(__builtin_cpu_supports("avx2"))
+	{
+		return "avx2";
+	}
+	if(__builtin_cpu_supports("avx"))
+	{
+		return "avx";
+	}
+	if(__builtin_cpu_supports("sse2"))
+	{
+		return "sse2";
+	}
+#endif
+	return "generic";
+}
+
+std::filesystem::path cacheDirectory()
+{
+	if(const char* xdgCache = std::getenv("XDG_CACHE_HOME"); xdgCache != nullptr && *xdgCache != '\0')
+	{
+		return std::filesystem::path(xdgCache) / "gaz";
+	}
+	if(const char* home = std::getenv("HOME"); home != nullptr && *home != '\0')
+	{
+		return std::filesystem::path(home) / ".cache" / "gaz";
+	}
+	return {};
+}
+} // namespace
+
+std::mutex& DSP::fftwPlannerMutex()
+{
+	static std::mutex s_mutex;
+	return s_mutex;
+}
+
+std::string DSP::wisdomCachePath(unsigned int size, unsigned int numChannels)
+{
+	const std::filesystem::path directory = cacheDirectory();
+	if(directory.empty())
+	{
+		return {};
+	}
+
+	// 'f32' is the precision, only the single precision library is linked
+	return (directory / fmt::format("fftw-f32-n{}-c{}-{}.wisdom", size, numChannels, cpuFeatures())).string();
+}
+
+bool DSP::loadWisdom(const std::string& path)
+{
+	if(path.empty() || !std::filesystem::exists(path))
+	{
+		return false;
+	}
+
+	return fftwf_import_wisdom_from_filename(path.c_str()) != 0;
+}
+
+bool DSP::saveWisdom(const std::string& path)
+{
+	if(path.empty())
+	{
+		return false;
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+	if(error)
+	{
+		fmt::print("DSP::saveWisdom: Failed to create cache directory for '{}': {}\n", path, error.message());
+		return false;
+	}
+
+	// Written alongside and renamed over, so a process exiting mid-write (e.g. under an abandoned upgrade) can't
+	// leave a truncated cache behind
+	const std::string temporaryPath = path + ".tmp";
+	if(fftwf_export_wisdom_to_filename(temporaryPath.c_str()) == 0)
+	{
+		fmt::print("DSP::saveWisdom: Failed to write '{}'\n", temporaryPath);
+		return false;
+	}
+
+	std::filesystem::rename(temporaryPath, path, error);
+	if(error)
+	{
+		fmt::print("DSP::saveWisdom: Failed to replace '{}': {}\n", path, error.message());
+		std::filesystem::remove(temporaryPath, error);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,140 @@
+#include "DSP/LevelMeter.h"
+
+#include <cmath>
+
+namespace
+{
+constexpr double pi = 3.14159265358979323846;
+
+// Whole blocks covering 'seconds', at least one
+unsigned int blocksFor(float seconds, unsigned int sampleRate, unsigned int blockSize)
+{
+	return std::max(static_cast<unsigned int>(std::lround(seconds * sampleRate / blockSize)), 1u);
+}
+
+// sinc(x) = sin(πx) / (πx)
+double sinc(double x)
+{
+	return x == 0.0 ? 1.0 : std::sin(pi * x) / (pi * x);
+}
+} // namespace
+
+using DSP::LevelMeter;
+
+LevelMeter::Window::Window(unsigned int numBlocks, unsigned int blockSize)
+	: m_blockSums(numBlocks, 0.0)
+	, m_next(0)
+	, m_sum(0.0)
+	, m_numSamples(static_cast<double>(numBlocks) * blockSize)
+{
+}
+
+void LevelMeter::Window::push(double blockSum)
+{
+	m_sum += blockSum - m_blockSums[m_next];
+	m_blockSums[m_next] = blockSum;
+	m_next = (m_next + 1) % m_blockSums.size();
+
+	// Resum once per lap, so rounding error in the running sum can't build up (e.g. after a loud passage)
+	if(m_next == 0)
+	{
+		m_sum = 0.0;
+		for(const double sum : m_blockSums)
+		{
+			m_sum += sum;
+		}
+	}
+}
+
+void LevelMeter::Window::reset()
+{
+	std::fill(m_blockSums.begin(), m_blockSums.end(), 0.0);
+	m_next = 0;
+	m_sum = 0.0;
+}
+
+LevelMeter::LevelMeter(unsigned int sampleRate, unsigned int blockSize)
+	: m_blockSize(blockSize)
+	, m_filter(kWeightingFilter(sampleRate))
+	, m_shelfState()
+	, m_highPassState()
+	, m_momentary(blocksFor(s_momentarySeconds, sampleRate, blockSize), blockSize)
+	, m_shortTerm(blocksFor(s_shortTermSeconds, sampleRate, blockSize), blockSize)
+	, m_rms(blocksFor(s_momentarySeconds, sampleRate, blockSize), blockSize)
+	, m_interpolator()
+	, m_recent()
+	, m_recentIndex(0)
+	, m_truePeak(0.0f)
+{
+	// Blackman windowed sinc, centred on a sample so phase 0 passes the samples straight through and the others
+	// fall a quarter, a half and three quarters of the way to the next one
+	constexpr unsigned int length = s_oversampling * s_tapsPerPhase;
+	constexpr double centre = length / 2;
+	for(unsigned int phase = 0; phase < s_oversampling; ++phase)
+	{
+		for(unsigned int tap = 0; tap < s_tapsPerPhase; ++tap)
+		{
+			const double n = s_oversampling * tap + phase;
+			const double window =
+				0.42 + 0.5 * std::cos(pi * (n - centre) / centre) + 0.08 * std::cos(2.0 * pi * (n - centre) / centre);
+			m_interpolator[phase][s_tapsPerPhase - 1 - tap] =
+				static_cast<float>(sinc((n - centre) / s_oversampling) * window);
+		}
+	}
+}
+
+void LevelMeter::process(const float* samples)
+{
+	double weightedSum = 0.0;
+	double sum = 0.0;
+	float peak = 0.0f;
+
+	for(unsigned int i = 0; i < m_blockSize; ++i)
+	{
+		const float x = samples[i];
+
+		const double weighted = m_highPassState.process(m_filter.highPass, m_shelfState.process(m_filter.shelf, x));
+		weightedSum += weighted * weighted;
+		sum += static_cast<double>(x) * x;
+
+		m_recent[m_recentIndex] = x;
+		m_recent[m_recentIndex + s_tapsPerPhase] = x;
+		m_recentIndex = (m_recentIndex + 1) % s_tapsPerPhase;
+
+		// The samples themselves count too, the interpolation is only ever a few samples behind them
+		peak = std::max(peak, std::fabs(x));
+		const float* recent = &m_recent[m_recentIndex];
+		for(const auto& taps : m_interpolator)
+		{
+			float value = 0.0f;
+			for(unsigned int tap = 0; tap < s_tapsPerPhase; ++tap)
+			{
+				value += taps[tap] * recent[tap];
+			}
+			peak = std::max(peak, std::fabs(value));
+		}
+	}
+
+	m_momentary.push(weightedSum);
+	m_shortTerm.push(weightedSum);
+	m_rms.push(sum);
+	m_truePeak = peak;
+}
+
+void LevelMeter::reset()
+{
+	m_shelfState = {};
+	m_highPassState = {};
+	m_momentary.reset();
+	m_shortTerm.reset();
+	m_rms.reset();
+	m_recent.fill(0.0f);
+	m_recentIndex = 0;
+	m_truePeak = 0.0f;
+}
+
+float DSP::loudness(double weightedPowerSum)
+{
+	// BS.1770's offset makes a 997Hz sine at 0dBFS in one front channel read -3.01 LUFS, like its RMS level
+	return static_cast<float>(-0.691 + 10.0 * std::log10(weightedPowerSum));
+}
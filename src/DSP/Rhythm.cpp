@@ -0,0 +1,215 @@
+#include "DSP/Rhythm.h"
+
+#include "DSP/Smoothing.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// Time constant of the onset threshold, long enough to span a few beats
+constexpr float thresholdSeconds = 1.0f;
+
+// An onset needs the flux this many mean deviations above its mean, and at least 'minimumFlux' dB over it
+constexpr float thresholdDeviations = 1.5f;
+constexpr float minimumFlux = 0.1f;
+
+// ...and at least this fraction of the recent peak flux, which decays with this time constant, so the small
+// onsets around a strong beat don't count
+constexpr float relativeThreshold = 0.3f;
+constexpr float peakSeconds = 2.0f;
+
+// Levels this far below the frame's loudest band are raised to it, since in dB a quiet band's noise rises just as far
+// as a loud band's attack
+constexpr float fluxDynamicRange = 48.0f;
+
+// How long the tempo's autocorrelation remembers, a few bars
+constexpr float tempoSeconds = 8.0f;
+
+// The envelope is smoothed first, so its peaks are wider than a frame, otherwise at high frame rates a period which
+// isn't a whole number of frames splits its peak between two lags, and a multiple of it can look stronger
+constexpr float envelopeSeconds = 0.02f;
+
+// Lags are weighted by a log-Gaussian over tempo (Ellis, 2007), an octave wide, centred on a typical tempo
+constexpr float preferredBPM = 120.0f;
+constexpr float tempoOctaves = 1.0f;
+
+// Fraction of the phase error each onset corrects
+constexpr float phaseCorrection = 0.2f;
+
+float framesPerBeat(float framesPerSecond, float bpm)
+{
+	return 60.0f * framesPerSecond / bpm;
+}
+} // namespace
+
+using DSP::OnsetDetector;
+using DSP::TempoTracker;
+
+OnsetDetector::OnsetDetector(float framesPerSecond, size_t maxLevels)
+	: m_previousLevels(maxLevels, 0.0f)
+	, m_count(0)
+	, m_adaptation(smoothingCoefficient(thresholdSeconds, framesPerSecond))
+	, m_peakDecay(1.0f - smoothingCoefficient(peakSeconds, framesPerSecond))
+	, m_refractoryFrames(std::max(static_cast<unsigned int>(std::lround(s_minOnsetInterval * framesPerSecond)), 1u))
+	, m_mean(0.0f)
+	, m_deviation(0.0f)
+	, m_peak(0.0f)
+	, m_framesSinceOnset(m_refractoryFrames)
+	, m_strength(0.0f)
+	, m_onset(false)
+	, m_envelope(0.0f)
+{
+}
+
+void OnsetDetector::process(const float* levels, size_t count)
+{
+	count = std::min(count, m_previousLevels.size());
+
+	// Nothing to compare against yet
+	if(count != m_count)
+	{
+		std::copy(levels, levels + count, m_previousLevels.begin());
+		m_count = count;
+		m_strength = 0.0f;
+		m_onset = false;
+		m_envelope = 0.0f;
+		return;
+	}
+
+	const float gate = *std::max_element(levels, levels + count) - fluxDynamicRange;
+
+	// Only rises count, so a sound stopping isn't an onset
+	float flux = 0.0f;
+	for(size_t i = 0; i < count; ++i)
+	{
+		const float level = std::max(levels[i], gate);
+		flux += std::max(level - m_previousLevels[i], 0.0f);
+		m_previousLevels[i] = level;
+	}
+	flux /= std::max<size_t>(count, 1);
+
+	const bool wasAboveThreshold = m_strength > 0.0f;
+	m_peak = std::max(flux, m_peak * m_peakDecay);
+	const float threshold =
+		std::max(m_mean + thresholdDeviations * m_deviation + minimumFlux, relativeThreshold * m_peak);
+	m_strength = std::max(flux - threshold, 0.0f);
+	m_envelope = std::max(flux - m_mean, 0.0f);
+
+	// One onset per crossing of the threshold, and not too close to the last
+	m_onset = m_strength > 0.0f && !wasAboveThreshold && m_framesSinceOnset >= m_refractoryFrames;
+	m_framesSinceOnset = m_onset ? 0 : std::min(m_framesSinceOnset + 1, m_refractoryFrames);
+
+	m_mean += m_adaptation * (flux - m_mean);
+	m_deviation += m_adaptation * (std::fabs(flux - m_mean) - m_deviation);
+}
+
+void OnsetDetector::reset()
+{
+	m_count = 0;
+}
+
+TempoTracker::TempoTracker(float framesPerSecond, float minBPM, float maxBPM)
+	: m_framesPerSecond(framesPerSecond)
+	, m_minLag(std::max(static_cast<unsigned int>(std::floor(framesPerBeat(framesPerSecond, maxBPM))), 1u))
+	, m_maxLag(std::max(static_cast<unsigned int>(std::ceil(framesPerBeat(framesPerSecond, minBPM))), m_minLag + 2))
+	, m_envelope(m_maxLag + 1, 0.0f)
+	, m_envelopeIndex(0)
+	, m_numFrames(0)
+	, m_autocorrelation(m_maxLag - m_minLag + 1, 0.0f)
+	, m_tempoWeights(m_maxLag - m_minLag + 1)
+	, m_decay(smoothingCoefficient(tempoSeconds, framesPerSecond))
+	, m_envelopeSmoothing(smoothingCoefficient(envelopeSeconds, framesPerSecond))
+	, m_smoothedEnvelope(0.0f)
+	, m_tempo(0.0f)
+	, m_phase(0.0f)
+	, m_beat(false)
+{
+	for(unsigned int lag = m_minLag; lag <= m_maxLag; ++lag)
+	{
+		const float octaves = std::log2(framesPerBeat(framesPerSecond, preferredBPM) / lag) / tempoOctaves;
+		m_tempoWeights[lag - m_minLag] = std::exp(-0.5f * octaves * octaves);
+	}
+}
+
+void TempoTracker::process(float envelope, bool onset)
+{
+	const size_t length = m_envelope.size();
+	m_smoothedEnvelope += m_envelopeSmoothing * (envelope - m_smoothedEnvelope);
+	envelope = m_smoothedEnvelope;
+	m_envelope[m_envelopeIndex] = envelope;
+
+	// Fold this frame into the autocorrelation at every lag, and find the strongest (weighted) period
+	size_t best = 0;
+	float bestValue = 0.0f;
+	for(size_t i = 0; i < m_autocorrelation.size(); ++i)
+	{
+		const size_t lag = m_minLag + i;
+		const float delayed = m_envelope[(m_envelopeIndex + length - lag) % length];
+		m_autocorrelation[i] += m_decay * (envelope * delayed - m_autocorrelation[i]);
+
+		const float value = m_autocorrelation[i] * m_tempoWeights[i];
+		if(value > bestValue)
+		{
+			best = i;
+			bestValue = value;
+		}
+	}
+
+	m_envelopeIndex = (m_envelopeIndex + 1) % length;
+	m_numFrames = std::min(m_numFrames + 1, length);
+
+	// Wait for every lag to have seen some history, and for something to have happened
+	if(m_numFrames == length && bestValue > 0.0f)
+	{
+		// Refine the period between lags with a parabola through the peak and its neighbours
+		float period = static_cast<float>(m_minLag + best);
+		if(best > 0 && best + 1 < m_autocorrelation.size())
+		{
+			const float before = m_autocorrelation[best - 1] * m_tempoWeights[best - 1];
+			const float after = m_autocorrelation[best + 1] * m_tempoWeights[best + 1];
+			const float curvature = before - 2.0f * bestValue + after;
+			if(curvature < 0.0f)
+			{
+				period += 0.5f * (before - after) / curvature;
+			}
+		}
+
+		m_tempo = 60.0f * m_framesPerSecond / period;
+	}
+
+	m_beat = false;
+	if(m_tempo > 0.0f)
+	{
+		m_phase += m_tempo / (60.0f * m_framesPerSecond);
+		if(m_phase >= 1.0f)
+		{
+			m_phase -= std::floor(m_phase);
+			m_beat = true;
+		}
+
+		// Pull the phase towards 0 (on the beat) at each onset, from whichever side is closer. It never overshoots,
+		// so it only reaches 1 by rounding
+		if(onset)
+		{
+			const float error = m_phase > 0.5f ? m_phase - 1.0f : m_phase;
+			m_phase -= phaseCorrection * error;
+			if(m_phase >= 1.0f)
+			{
+				m_phase -= 1.0f;
+			}
+		}
+	}
+}
+
+void TempoTracker::reset()
+{
+	std::fill(m_envelope.begin(), m_envelope.end(), 0.0f);
+	std::fill(m_autocorrelation.begin(), m_autocorrelation.end(), 0.0f);
+	m_envelopeIndex = 0;
+	m_numFrames = 0;
+	m_smoothedEnvelope = 0.0f;
+	m_tempo = 0.0f;
+	m_phase = 0.0f;
+	m_beat = false;
+}
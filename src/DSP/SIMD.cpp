@@ -0,0 +1,46 @@
+#include "DSP/SIMD.h"
+
+namespace
+{
+DSP::SIMDLevel detectSIMDLevel()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512f"))
+	{
+		return DSP::SIMDLevel::AVX512;
+	}
+	if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+	{
+		return DSP::SIMDLevel::AVX2;
+	}
+	if(__builtin_cpu_supports("sse2"))
+	{
+		return DSP::SIMDLevel::SSE2;
+	}
+#endif
+	return DSP::SIMDLevel::Scalar;
+}
+} // namespace
+
+DSP::SIMDLevel DSP::getSIMDLevel()
+{
+	static const SIMDLevel s_level = detectSIMDLevel();
+	return s_level;
+}
+
+const char* DSP::toString(SIMDLevel level)
+{
+	switch(level)
+	{
+	case SIMDLevel::Scalar:
+		return "scalar";
+	case SIMDLevel::SSE2:
+		return "SSE2";
+	case SIMDLevel::AVX2:
+		return "AVX2";
+	case SIMDLevel::AVX512:
+		return "AVX-512";
+	}
+	return "unknown";
+}
@@ -0,0 +1,159 @@
+#include "DSP/Smoothing.h"
+
+#include "DSP/SIMD.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+using DSP::SmoothingCoefficients;
+using DSP::SmoothingPlanes;
+
+DSP_SCALAR_TAIL void smoothScalar(
+	const float* in, size_t count, const SmoothingCoefficients& c, const SmoothingPlanes& state, const SmoothingPlanes& out)
+{
+	for(size_t i = 0; i < count; ++i)
+	{
+		const float x = in[i];
+
+		const float smoothed = state.smoothed[i];
+		const float k = x > smoothed ? c.attack : c.release;
+		state.smoothed[i] = out.smoothed[i] = smoothed + k * (x - smoothed);
+
+		state.peak[i] = out.peak[i] = std::max(x, state.peak[i] - c.peakFall);
+
+		const float average = state.average[i];
+		state.average[i] = out.average[i] = average + c.average * (x - average);
+	}
+}
+
+#if defined(__x86_64__)
+void smoothSSE2(
+	const float* in, size_t count, const SmoothingCoefficients& c, const SmoothingPlanes& state, const SmoothingPlanes& out)
+{
+	const __m128 attack = _mm_set1_ps(c.attack);
+	const __m128 release = _mm_set1_ps(c.release);
+	const __m128 peakFall = _mm_set1_ps(c.peakFall);
+	const __m128 averageCoefficient = _mm_set1_ps(c.average);
+
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		const __m128 x = _mm_loadu_ps(in + i);
+
+		// No blend in SSE2, so select the coefficient with masks
+		const __m128 smoothed = _mm_loadu_ps(state.smoothed + i);
+		const __m128 rising = _mm_cmpgt_ps(x, smoothed);
+		const __m128 k = _mm_or_ps(_mm_and_ps(rising, attack), _mm_andnot_ps(rising, release));
+		const __m128 newSmoothed = _mm_add_ps(smoothed, _mm_mul_ps(k, _mm_sub_ps(x, smoothed)));
+		_mm_storeu_ps(state.smoothed + i, newSmoothed);
+		_mm_storeu_ps(out.smoothed + i, newSmoothed);
+
+		const __m128 peak = _mm_max_ps(x, _mm_sub_ps(_mm_loadu_ps(state.peak + i), peakFall));
+		_mm_storeu_ps(state.peak + i, peak);
+		_mm_storeu_ps(out.peak + i, peak);
+
+		const __m128 average = _mm_loadu_ps(state.average + i);
+		const __m128 newAverage = _mm_add_ps(average, _mm_mul_ps(averageCoefficient, _mm_sub_ps(x, average)));
+		_mm_storeu_ps(state.average + i, newAverage);
+		_mm_storeu_ps(out.average + i, newAverage);
+	}
+
+	smoothScalar(
+		in + i,
+		count - i,
+		c,
+		{state.smoothed + i, state.peak + i, state.average + i},
+		{out.smoothed + i, out.peak + i, out.average + i});
+}
+
+__attribute__((target("avx2,fma"))) void smoothAVX2(
+	const float* in, size_t count, const SmoothingCoefficients& c, const SmoothingPlanes& state, const SmoothingPlanes& out)
+{
+	const __m256 attack = _mm256_set1_ps(c.attack);
+	const __m256 release = _mm256_set1_ps(c.release);
+	const __m256 peakFall = _mm256_set1_ps(c.peakFall);
+	const __m256 averageCoefficient = _mm256_set1_ps(c.average);
+
+	size_t i = 0;
+	for(; i + 8 <= count; i += 8)
+	{
+		const __m256 x = _mm256_loadu_ps(in + i);
+
+		const __m256 smoothed = _mm256_loadu_ps(state.smoothed + i);
+		const __m256 k = _mm256_blendv_ps(release, attack, _mm256_cmp_ps(x, smoothed, _CMP_GT_OQ));
+		const __m256 newSmoothed = _mm256_fmadd_ps(k, _mm256_sub_ps(x, smoothed), smoothed);
+		_mm256_storeu_ps(state.smoothed + i, newSmoothed);
+		_mm256_storeu_ps(out.smoothed + i, newSmoothed);
+
+		const __m256 peak = _mm256_max_ps(x, _mm256_sub_ps(_mm256_loadu_ps(state.peak + i), peakFall));
+		_mm256_storeu_ps(state.peak + i, peak);
+		_mm256_storeu_ps(out.peak + i, peak);
+
+		const __m256 average = _mm256_loadu_ps(state.average + i);
+		const __m256 newAverage = _mm256_fmadd_ps(averageCoefficient, _mm256_sub_ps(x, average), average);
+		_mm256_storeu_ps(state.average + i, newAverage);
+		_mm256_storeu_ps(out.average + i, newAverage);
+	}
+
+	smoothScalar(
+		in + i,
+		count - i,
+		c,
+		{state.smoothed + i, state.peak + i, state.average + i},
+		{out.smoothed + i, out.peak + i, out.average + i});
+}
+#endif
+
+typedef void (*SmoothingKernel)(
+	const float*, size_t, const SmoothingCoefficients&, const SmoothingPlanes&, const SmoothingPlanes&);
+
+SmoothingKernel selectKernel()
+{
+	switch(DSP::getSIMDLevel())
+	{
+#if defined(__x86_64__)
+	case DSP::SIMDLevel::AVX512:
+	case DSP::SIMDLevel::AVX2:
+		return smoothAVX2;
+	case DSP::SIMDLevel::SSE2:
+		return smoothSSE2;
+#endif
+	default:
+		return smoothScalar;
+	}
+}
+} // namespace
+
+float DSP::smoothingCoefficient(float seconds, float framesPerSecond)
+{
+	if(seconds <= 0.0f || framesPerSecond <= 0.0f)
+	{
+		return 1.0f;
+	}
+
+	return 1.0f - std::exp(-1.0f / (seconds * framesPerSecond));
+}
+
+void DSP::smoothSpectrum(
+	const float* in,
+	size_t count,
+	const SmoothingCoefficients& coefficients,
+	const SmoothingPlanes& state,
+	const SmoothingPlanes& out)
+{
+	static const SmoothingKernel s_kernel = selectKernel();
+	s_kernel(in, count, coefficients, state, out);
+}
+
+void DSP::resetSmoothing(const float* in, size_t count, const SmoothingPlanes& state)
+{
+	std::copy(in, in + count, state.smoothed);
+	std::copy(in, in + count, state.peak);
+	std::copy(in, in + count, state.average);
+}
@@ -0,0 +1,389 @@
+#include "DSP/Stereo.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+using DSP::StereoPlanes;
+
+constexpr float pi = 3.14159265358979f;
+constexpr float halfPi = 1.57079632679490f;
+
+// atan(a) ~= a (a0 + a1 a² + a2 a⁴ + a3 a⁶ + a4 a⁸ + a5 a¹⁰) for a in [0, 1], minimax fit, max error 1e-5 radians
+constexpr float a0 = 0.99997726f;
+constexpr float a1 = -0.33262347f;
+constexpr float a2 = 0.19354346f;
+constexpr float a3 = -0.11643287f;
+constexpr float a4 = 0.05265332f;
+constexpr float a5 = -0.01172120f;
+
+// Reduce to the first octant, where the ratio is in [0, 1], and unfold the result. 0 for (0, 0)
+float fastAtan2(float y, float x)
+{
+	const float ax = std::fabs(x);
+	const float ay = std::fabs(y);
+	const float a = std::min(ax, ay) / std::max(std::max(ax, ay), FLT_MIN);
+	const float s = a * a;
+
+	float angle = a * (a0 + s * (a1 + s * (a2 + s * (a3 + s * (a4 + s * a5)))));
+	if(ay > ax)
+	{
+		angle = halfPi - angle;
+	}
+	if(x < 0.0f)
+	{
+		angle = pi - angle;
+	}
+	return std::copysign(angle, y);
+}
+
+// Sums over every bin of the averages, for the whole spectrum meters
+struct Sums
+{
+	double left = 0.0;
+	double right = 0.0;
+	double cross = 0.0;
+};
+
+// Where each plane of the averages starts
+struct Averages
+{
+	float* left;
+	float* right;
+	float* crossRe;
+	float* crossIm;
+};
+
+Averages planesOf(float* averages, size_t numBins)
+{
+	return {averages, averages + numBins, averages + 2 * numBins, averages + 3 * numBins};
+}
+
+// Bins 'begin' to 'count'
+DSP_SCALAR_TAIL void processScalar(
+	const float* left,
+	const float* right,
+	size_t begin,
+	size_t count,
+	float k,
+	const Averages& averages,
+	const StereoPlanes& out,
+	Sums& sums)
+{
+	for(size_t i = begin; i < count; ++i)
+	{
+		const float lr = left[2 * i];
+		const float li = left[2 * i + 1];
+		const float rr = right[2 * i];
+		const float ri = right[2 * i + 1];
+
+		// L R* = (lr rr + li ri) + i (li rr - lr ri)
+		const float l = averages.left[i] += k * (lr * lr + li * li - averages.left[i]);
+		const float r = averages.right[i] += k * (rr * rr + ri * ri - averages.right[i]);
+		const float c = averages.crossRe[i] += k * (lr * rr + li * ri - averages.crossRe[i]);
+		const float s = averages.crossIm[i] += k * (li * rr - lr * ri - averages.crossIm[i]);
+
+		sums.left += l;
+		sums.right += r;
+		sums.cross += c;
+
+		out.coherence[i] = std::min((c * c + s * s) / std::max(l * r, FLT_MIN), 1.0f);
+		out.phase[i] = fastAtan2(s, c);
+		out.side[i] = std::clamp((l + r - 2.0f * c) / std::max(2.0f * (l + r), FLT_MIN), 0.0f, 1.0f);
+	}
+}
+
+void processAll(
+	const float* left, const float* right, size_t count, float k, float* averages, const StereoPlanes& out, Sums& sums)
+{
+	processScalar(left, right, 0, count, k, planesOf(averages, count), out, sums);
+}
+
+#if defined(__x86_64__)
+double horizontalSum(__m128 x)
+{
+	const __m128d sum = _mm_add_pd(_mm_cvtps_pd(x), _mm_cvtps_pd(_mm_movehl_ps(x, x)));
+	return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+}
+
+__m128 select(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+__m128 fastAtan2SSE2(__m128 y, __m128 x)
+{
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	const __m128 ax = _mm_andnot_ps(signMask, x);
+	const __m128 ay = _mm_andnot_ps(signMask, y);
+	const __m128 a = _mm_div_ps(_mm_min_ps(ax, ay), _mm_max_ps(_mm_max_ps(ax, ay), _mm_set1_ps(FLT_MIN)));
+	const __m128 s = _mm_mul_ps(a, a);
+
+	__m128 poly = _mm_add_ps(_mm_mul_ps(s, _mm_set1_ps(a5)), _mm_set1_ps(a4));
+	poly = _mm_add_ps(_mm_mul_ps(s, poly), _mm_set1_ps(a3));
+	poly = _mm_add_ps(_mm_mul_ps(s, poly), _mm_set1_ps(a2));
+	poly = _mm_add_ps(_mm_mul_ps(s, poly), _mm_set1_ps(a1));
+	poly = _mm_add_ps(_mm_mul_ps(s, poly), _mm_set1_ps(a0));
+	__m128 angle = _mm_mul_ps(a, poly);
+
+	angle = select(_mm_cmpgt_ps(ay, ax), _mm_sub_ps(_mm_set1_ps(halfPi), angle), angle);
+	angle = select(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(pi), angle), angle);
+	return _mm_or_ps(angle, _mm_and_ps(y, signMask));
+}
+
+void processSSE2(
+	const float* left,
+	const float* right,
+	size_t count,
+	float k,
+	float* averageState,
+	const StereoPlanes& out,
+	Sums& sums)
+{
+	const Averages averages = planesOf(averageState, count);
+	const __m128 coefficient = _mm_set1_ps(k);
+	const __m128 minimum = _mm_set1_ps(FLT_MIN);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+
+	__m128 leftSum = zero;
+	__m128 rightSum = zero;
+	__m128 crossSum = zero;
+
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		// re0 im0 re1 im1 | re2 im2 re3 im3 -> re0..3, im0..3
+		const __m128 la = _mm_loadu_ps(left + 2 * i);
+		const __m128 lb = _mm_loadu_ps(left + 2 * i + 4);
+		const __m128 ra = _mm_loadu_ps(right + 2 * i);
+		const __m128 rb = _mm_loadu_ps(right + 2 * i + 4);
+		const __m128 lr = _mm_shuffle_ps(la, lb, _MM_SHUFFLE(2, 0, 2, 0));
+		const __m128 li = _mm_shuffle_ps(la, lb, _MM_SHUFFLE(3, 1, 3, 1));
+		const __m128 rr = _mm_shuffle_ps(ra, rb, _MM_SHUFFLE(2, 0, 2, 0));
+		const __m128 ri = _mm_shuffle_ps(ra, rb, _MM_SHUFFLE(3, 1, 3, 1));
+
+		const __m128 leftPower = _mm_add_ps(_mm_mul_ps(lr, lr), _mm_mul_ps(li, li));
+		const __m128 rightPower = _mm_add_ps(_mm_mul_ps(rr, rr), _mm_mul_ps(ri, ri));
+		const __m128 crossRe = _mm_add_ps(_mm_mul_ps(lr, rr), _mm_mul_ps(li, ri));
+		const __m128 crossIm = _mm_sub_ps(_mm_mul_ps(li, rr), _mm_mul_ps(lr, ri));
+
+		__m128 l = _mm_loadu_ps(averages.left + i);
+		__m128 r = _mm_loadu_ps(averages.right + i);
+		__m128 c = _mm_loadu_ps(averages.crossRe + i);
+		__m128 s = _mm_loadu_ps(averages.crossIm + i);
+		l = _mm_add_ps(l, _mm_mul_ps(coefficient, _mm_sub_ps(leftPower, l)));
+		r = _mm_add_ps(r, _mm_mul_ps(coefficient, _mm_sub_ps(rightPower, r)));
+		c = _mm_add_ps(c, _mm_mul_ps(coefficient, _mm_sub_ps(crossRe, c)));
+		s = _mm_add_ps(s, _mm_mul_ps(coefficient, _mm_sub_ps(crossIm, s)));
+		_mm_storeu_ps(averages.left + i, l);
+		_mm_storeu_ps(averages.right + i, r);
+		_mm_storeu_ps(averages.crossRe + i, c);
+		_mm_storeu_ps(averages.crossIm + i, s);
+
+		leftSum = _mm_add_ps(leftSum, l);
+		rightSum = _mm_add_ps(rightSum, r);
+		crossSum = _mm_add_ps(crossSum, c);
+
+		const __m128 coherence = _mm_div_ps(
+			_mm_add_ps(_mm_mul_ps(c, c), _mm_mul_ps(s, s)), _mm_max_ps(_mm_mul_ps(l, r), minimum));
+		_mm_storeu_ps(out.coherence + i, _mm_min_ps(coherence, one));
+
+		_mm_storeu_ps(out.phase + i, fastAtan2SSE2(s, c));
+
+		const __m128 powers = _mm_add_ps(l, r);
+		const __m128 side = _mm_div_ps(
+			_mm_sub_ps(powers, _mm_mul_ps(two, c)), _mm_max_ps(_mm_mul_ps(two, powers), minimum));
+		_mm_storeu_ps(out.side + i, _mm_min_ps(_mm_max_ps(side, zero), one));
+	}
+
+	sums.left = horizontalSum(leftSum);
+	sums.right = horizontalSum(rightSum);
+	sums.cross = horizontalSum(crossSum);
+
+	processScalar(left, right, i, count, k, averages, out, sums);
+}
+
+// Bins 0..7 of 8 interleaved (re, im) pairs, in order. The shuffles stay within 128 bit lanes, giving bins
+// 0 1 4 5 2 3 6 7, so swap the middle 64 bit pairs
+__attribute__((target("avx2,fma"))) void deinterleaveAVX2(const float* in, __m256& re, __m256& im)
+{
+	const __m256 a = _mm256_loadu_ps(in);
+	const __m256 b = _mm256_loadu_ps(in + 8);
+	re = _mm256_castpd_ps(_mm256_permute4x64_pd(
+		_mm256_castps_pd(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0)));
+	im = _mm256_castpd_ps(_mm256_permute4x64_pd(
+		_mm256_castps_pd(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+__attribute__((target("avx2,fma"))) __m256 fastAtan2AVX2(__m256 y, __m256 x)
+{
+	const __m256 signMask = _mm256_set1_ps(-0.0f);
+	const __m256 ax = _mm256_andnot_ps(signMask, x);
+	const __m256 ay = _mm256_andnot_ps(signMask, y);
+	const __m256 a =
+		_mm256_div_ps(_mm256_min_ps(ax, ay), _mm256_max_ps(_mm256_max_ps(ax, ay), _mm256_set1_ps(FLT_MIN)));
+	const __m256 s = _mm256_mul_ps(a, a);
+
+	__m256 poly = _mm256_fmadd_ps(s, _mm256_set1_ps(a5), _mm256_set1_ps(a4));
+	poly = _mm256_fmadd_ps(s, poly, _mm256_set1_ps(a3));
+	poly = _mm256_fmadd_ps(s, poly, _mm256_set1_ps(a2));
+	poly = _mm256_fmadd_ps(s, poly, _mm256_set1_ps(a1));
+	poly = _mm256_fmadd_ps(s, poly, _mm256_set1_ps(a0));
+	__m256 angle = _mm256_mul_ps(a, poly);
+
+	const __m256 steep = _mm256_cmp_ps(ay, ax, _CMP_GT_OQ);
+	angle = _mm256_blendv_ps(angle, _mm256_sub_ps(_mm256_set1_ps(halfPi), angle), steep);
+	// blendv only looks at the sign bit, so x itself selects the left half plane
+	angle = _mm256_blendv_ps(angle, _mm256_sub_ps(_mm256_set1_ps(pi), angle), x);
+	return _mm256_or_ps(angle, _mm256_and_ps(y, signMask));
+}
+
+__attribute__((target("avx2,fma"))) double horizontalSum(__m256 x)
+{
+	return horizontalSum(_mm_add_ps(_mm256_castps256_ps128(x), _mm256_extractf128_ps(x, 1)));
+}
+
+__attribute__((target("avx2,fma"))) void processAVX2(
+	const float* left,
+	const float* right,
+	size_t count,
+	float k,
+	float* averageState,
+	const StereoPlanes& out,
+	Sums& sums)
+{
+	const Averages averages = planesOf(averageState, count);
+	const __m256 coefficient = _mm256_set1_ps(k);
+	const __m256 minimum = _mm256_set1_ps(FLT_MIN);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 two = _mm256_set1_ps(2.0f);
+
+	__m256 leftSum = zero;
+	__m256 rightSum = zero;
+	__m256 crossSum = zero;
+
+	size_t i = 0;
+	for(; i + 8 <= count; i += 8)
+	{
+		__m256 lr, li, rr, ri;
+		deinterleaveAVX2(left + 2 * i, lr, li);
+		deinterleaveAVX2(right + 2 * i, rr, ri);
+
+		const __m256 leftPower = _mm256_fmadd_ps(lr, lr, _mm256_mul_ps(li, li));
+		const __m256 rightPower = _mm256_fmadd_ps(rr, rr, _mm256_mul_ps(ri, ri));
+		const __m256 crossRe = _mm256_fmadd_ps(lr, rr, _mm256_mul_ps(li, ri));
+		const __m256 crossIm = _mm256_fmsub_ps(li, rr, _mm256_mul_ps(lr, ri));
+
+		__m256 l = _mm256_loadu_ps(averages.left + i);
+		__m256 r = _mm256_loadu_ps(averages.right + i);
+		__m256 c = _mm256_loadu_ps(averages.crossRe + i);
+		__m256 s = _mm256_loadu_ps(averages.crossIm + i);
+		l = _mm256_fmadd_ps(coefficient, _mm256_sub_ps(leftPower, l), l);
+		r = _mm256_fmadd_ps(coefficient, _mm256_sub_ps(rightPower, r), r);
+		c = _mm256_fmadd_ps(coefficient, _mm256_sub_ps(crossRe, c), c);
+		s = _mm256_fmadd_ps(coefficient, _mm256_sub_ps(crossIm, s), s);
+		_mm256_storeu_ps(averages.left + i, l);
+		_mm256_storeu_ps(averages.right + i, r);
+		_mm256_storeu_ps(averages.crossRe + i, c);
+		_mm256_storeu_ps(averages.crossIm + i, s);
+
+		leftSum = _mm256_add_ps(leftSum, l);
+		rightSum = _mm256_add_ps(rightSum, r);
+		crossSum = _mm256_add_ps(crossSum, c);
+
+		const __m256 coherence =
+			_mm256_div_ps(_mm256_fmadd_ps(c, c, _mm256_mul_ps(s, s)), _mm256_max_ps(_mm256_mul_ps(l, r), minimum));
+		_mm256_storeu_ps(out.coherence + i, _mm256_min_ps(coherence, one));
+
+		_mm256_storeu_ps(out.phase + i, fastAtan2AVX2(s, c));
+
+		const __m256 powers = _mm256_add_ps(l, r);
+		const __m256 side = _mm256_div_ps(
+			_mm256_fnmadd_ps(two, c, powers), _mm256_max_ps(_mm256_mul_ps(two, powers), minimum));
+		_mm256_storeu_ps(out.side + i, _mm256_min_ps(_mm256_max_ps(side, zero), one));
+	}
+
+	sums.left = horizontalSum(leftSum);
+	sums.right = horizontalSum(rightSum);
+	sums.cross = horizontalSum(crossSum);
+
+	processScalar(left, right, i, count, k, averages, out, sums);
+}
+#endif
+
+float correlationOf(const Sums& sums)
+{
+	const double product = sums.left * sums.right;
+	return product > 0.0 ? static_cast<float>(std::clamp(sums.cross / std::sqrt(product), -1.0, 1.0)) : 0.0f;
+}
+
+float sideOf(const Sums& sums)
+{
+	const double powers = sums.left + sums.right;
+	return powers > 0.0 ? static_cast<float>(std::clamp((powers - 2.0 * sums.cross) / (2.0 * powers), 0.0, 1.0)) : 0.0f;
+}
+
+typedef void (*StereoKernel)(const float*, const float*, size_t, float, float*, const StereoPlanes&, Sums&);
+
+StereoKernel selectKernel(DSP::SIMDLevel level)
+{
+	switch(std::min(level, DSP::getSIMDLevel()))
+	{
+#if defined(__x86_64__)
+	case DSP::SIMDLevel::AVX512:
+	case DSP::SIMDLevel::AVX2:
+		return processAVX2;
+	case DSP::SIMDLevel::SSE2:
+		return processSSE2;
+#endif
+	default:
+		return processAll;
+	}
+}
+} // namespace
+
+using DSP::StereoAnalyser;
+
+StereoAnalyser::StereoAnalyser(size_t numBins, float coefficient)
+	: m_numBins(numBins)
+	, m_coefficient(coefficient)
+	, m_averages(4 * numBins, 0.0f)
+	, m_correlation(0.0f)
+	, m_side(0.0f)
+{
+}
+
+void StereoAnalyser::process(const float* left, const float* right, const StereoPlanes& out)
+{
+	static const StereoKernel s_kernel = selectKernel(getSIMDLevel());
+	Sums sums;
+	s_kernel(left, right, m_numBins, m_coefficient, m_averages.data(), out, sums);
+
+	m_correlation = correlationOf(sums);
+	m_side = sideOf(sums);
+}
+
+void StereoAnalyser::process(SIMDLevel level, const float* left, const float* right, const StereoPlanes& out)
+{
+	Sums sums;
+	selectKernel(level)(left, right, m_numBins, m_coefficient, m_averages.data(), out, sums);
+
+	m_correlation = correlationOf(sums);
+	m_side = sideOf(sums);
+}
+
+void StereoAnalyser::reset()
+{
+	std::fill(m_averages.begin(), m_averages.end(), 0.0f);
+	m_correlation = 0.0f;
+	m_side = 0.0f;
+}
@@ -0,0 +1,108 @@
+#include "DSP/Weighting.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+
+namespace
+{
+constexpr double pi = 3.14159265358979323846;
+
+constexpr float minWeightingDecibels = -200.0f;
+
+// IEC 61672-1, the analogue A curve, normalised to 0dB at 1kHz
+double aWeightingDecibels(double frequencyHz)
+{
+	const double f2 = frequencyHz * frequencyHz;
+	const double response = (12194.0 * 12194.0 * f2 * f2)
+		/ ((f2 + 20.6 * 20.6) * std::sqrt((f2 + 107.7 * 107.7) * (f2 + 737.9 * 737.9)) * (f2 + 12194.0 * 12194.0));
+	return 20.0 * std::log10(response) + 2.0;
+}
+
+// |H(e^jw)|² of a biquad
+double powerResponse(const DSP::Biquad& filter, double omega)
+{
+	const std::complex<double> z1 = std::polar(1.0, -omega);
+	const std::complex<double> z2 = z1 * z1;
+	const std::complex<double> numerator = filter.b0 + filter.b1 * z1 + filter.b2 * z2;
+	const std::complex<double> denominator = 1.0 + filter.a1 * z1 + filter.a2 * z2;
+	return std::norm(numerator) / std::norm(denominator);
+}
+} // namespace
+
+const char* DSP::toString(FrequencyWeighting weighting)
+{
+	switch(weighting)
+	{
+	case FrequencyWeighting::None:
+		return "unweighted";
+	case FrequencyWeighting::A:
+		return "A-weighted";
+	case FrequencyWeighting::K:
+		return "K-weighted";
+	}
+	return "unknown";
+}
+
+float DSP::weightingDecibels(FrequencyWeighting weighting, float frequencyHz, unsigned int sampleRate)
+{
+	double decibels = 0.0;
+	switch(weighting)
+	{
+	case FrequencyWeighting::None:
+		return 0.0f;
+	case FrequencyWeighting::A:
+		decibels = frequencyHz > 0.0f ? aWeightingDecibels(frequencyHz) : -HUGE_VAL;
+		break;
+	case FrequencyWeighting::K:
+	{
+		const KWeightingFilter filter = kWeightingFilter(sampleRate);
+		const double omega = 2.0 * pi * frequencyHz / sampleRate;
+		decibels = 10.0 * std::log10(powerResponse(filter.shelf, omega) * powerResponse(filter.highPass, omega));
+		break;
+	}
+	}
+
+	return std::max(static_cast<float>(decibels), minWeightingDecibels);
+}
+
+DSP::KWeightingFilter DSP::kWeightingFilter(unsigned int sampleRate)
+{
+	// The analogue prototypes behind BS.1770's 48kHz coefficients, bilinear transformed for any rate. These are
+	// the values libebur128 and others fit, they reproduce the published coefficients to within rounding
+	KWeightingFilter filter;
+	{
+		const double f0 = 1681.974450955533;
+		const double gain = 3.999843853973347;
+		const double q = 0.7071752369554196;
+
+		const double k = std::tan(pi * f0 / sampleRate);
+		const double vh = std::pow(10.0, gain / 20.0);
+		const double vb = std::pow(vh, 0.4996667741545416);
+		const double a0 = 1.0 + k / q + k * k;
+
+		filter.shelf = {
+			(vh + vb * k / q + k * k) / a0,
+			2.0 * (k * k - vh) / a0,
+			(vh - vb * k / q + k * k) / a0,
+			2.0 * (k * k - 1.0) / a0,
+			(1.0 - k / q + k * k) / a0
+		};
+	}
+	{
+		const double f0 = 38.13547087602444;
+		const double q = 0.5003270373238773;
+
+		const double k = std::tan(pi * f0 / sampleRate);
+		const double a0 = 1.0 + k / q + k * k;
+
+		filter.highPass = {
+			1.0,
+			-2.0,
+			1.0,
+			2.0 * (k * k - 1.0) / a0,
+			(1.0 - k / q + k * k) / a0
+		};
+	}
+	return filter;
+}
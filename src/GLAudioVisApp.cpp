@@ -10,8 +10,13 @@
 
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
+#include "GLUtils/GPUProfiler.h"
 #include "GLUtils/Timer.h"
 
 namespace
@@ -19,7 +24,100 @@ namespace
 	constexpr unsigned int DEFAULT_SCREEN_WIDTH = 1024; // 800;
 	constexpr unsigned int DEFAULT_SCREEN_HEIGHT = 768; // 600;
 
+	// Used when no audio source is given on the command line, see AudioSource::create for the format
+	// const char* DEFAULT_AUDIO_SOURCE = "pulse:alsa_input.pci-0000_00_1b.0.analog-stereo";
+	const char* DEFAULT_AUDIO_SOURCE = "pulse:alsa_output.pci-0000_00_1b.0.analog-stereo.monitor";
+
 	float runLoopElapsed = 0.0f;
+
+	// A profiler scope's colour, picked from its site's address so it's the same on every track and frame
+	ImU32 getSiteColour(const gaz::Profiler::Site* site)
+	{
+		static const ImU32 palette[] = {
+			IM_COL32(86, 119, 164, 255),
+			IM_COL32(164, 104, 86, 255),
+			IM_COL32(96, 150, 96, 255),
+			IM_COL32(150, 96, 150, 255),
+			IM_COL32(160, 140, 72, 255),
+			IM_COL32(72, 146, 150, 255),
+			IM_COL32(120, 120, 170, 255),
+			IM_COL32(170, 110, 130, 255)
+		};
+		constexpr size_t paletteSize = sizeof(palette) / sizeof(palette[0]);
+
+		// Sites are at least pointer aligned, so the low bits are always the same
+		const uintptr_t bits = reinterpret_cast<uintptr_t>(site) >> 3;
+		return palette[(bits ^ (bits >> 5)) % paletteSize];
+	}
+
+	// '<path>[,pcm][,spectra][,every=<n>]', both streams unless one is named
+	bool parseRecordOption(const std::string& option, std::string& path, gaz::Recorder::Settings& settings)
+	{
+		size_t end = option.find(',');
+		path = option.substr(0, end);
+
+		bool pcm = false;
+		bool spectra = false;
+		while (end != std::string::npos)
+		{
+			const size_t begin = end + 1;
+			end = option.find(',', begin);
+			const std::string token = option.substr(begin, end - begin);
+
+			if (token == "pcm")
+			{
+				pcm = true;
+			}
+			else if (token == "spectra")
+			{
+				spectra = true;
+			}
+			else if (std::sscanf(token.c_str(), "every=%u", &settings.spectrumInterval) != 1 ||
+				settings.spectrumInterval == 0)
+			{
+				fmt::print("Invalid recording option '{}'\n", token);
+				return false;
+			}
+		}
+
+		settings.pcm = pcm || !spectra;
+		settings.spectra = spectra || !pcm;
+		return !path.empty();
+	}
+
+	// '<path>[,speed=<x>][,fps=<n>][,loop]'
+	bool parseReplayOption(const std::string& option, std::string& path, gaz::GLAudioVisApp::ReplaySettings& settings)
+	{
+		size_t end = option.find(',');
+		path = option.substr(0, end);
+
+		while (end != std::string::npos)
+		{
+			const size_t begin = end + 1;
+			end = option.find(',', begin);
+			const std::string token = option.substr(begin, end - begin);
+
+			if (token == "loop")
+			{
+				settings.loop = true;
+			}
+			else if (token.rfind("speed=", 0) == 0)
+			{
+				settings.speed = std::strtof(token.c_str() + 6, nullptr);
+			}
+			else if (token.rfind("fps=", 0) == 0)
+			{
+				settings.fixedFPS = static_cast<unsigned int>(std::strtoul(token.c_str() + 4, nullptr, 10));
+			}
+			else
+			{
+				fmt::print("Invalid replay option '{}'\n", token);
+				return false;
+			}
+		}
+
+		return !path.empty() && settings.speed > 0.0f;
+	}
 };
 
 using namespace gaz;
@@ -35,6 +133,96 @@ int GLAudioVisApp::execute(int argc, char* argv[])
 		}
 	}
 
+	// The first argument selects the audio source, e.g. 'pulse:<device>', 'file:<path>,realtime', 'synth:sine@440'.
+	// '--cqt' switches to a constant-Q analysis, which maps octaves evenly onto the cube.
+	// '--channels=<n>' records n channels instead of stereo, e.g. 6 for 5.1 or a multichannel interface.
+	// '--record=<path>[,pcm][,spectra][,every=<n>]' streams the samples and/or spectra to a file while recording.
+	// '--replay=<path>[,speed=<x>][,fps=<n>][,loop]' plays back a recording's spectra instead, without a source
+	const char* audioSourceDescription = DEFAULT_AUDIO_SOURCE;
+	AudioEngine::Analysis analysis = AudioEngine::Analysis::Linear;
+	unsigned int numChannels = 2;
+	std::string recordPath;
+	Recorder::Settings recordSettings;
+	std::string replayPath;
+	ReplaySettings replaySettings;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--cqt") == 0)
+		{
+			analysis = AudioEngine::Analysis::ConstantQ;
+		}
+		else if (std::sscanf(argv[i], "--channels=%u", &numChannels) == 1)
+		{
+			if (numChannels == 0 || numChannels > PA_CHANNELS_MAX)
+			{
+				fmt::print("Invalid channel count {}, must be 1 to {}\n", numChannels, PA_CHANNELS_MAX);
+				return EXIT_FAILURE;
+			}
+		}
+		else if (std::strncmp(argv[i], "--record=", 9) == 0)
+		{
+			if (!parseRecordOption(argv[i] + 9, recordPath, recordSettings))
+			{
+				fmt::print("Invalid recording '{}'\n", argv[i] + 9);
+				return EXIT_FAILURE;
+			}
+		}
+		else if (std::strncmp(argv[i], "--replay=", 9) == 0)
+		{
+			if (!parseReplayOption(argv[i] + 9, replayPath, replaySettings))
+			{
+				fmt::print("Invalid replay '{}'\n", argv[i] + 9);
+				return EXIT_FAILURE;
+			}
+		}
+		else
+		{
+			audioSourceDescription = argv[i];
+		}
+	}
+
+	// A replay brings its own channel count and analysis, and leaves the engine without a source
+	std::unique_ptr<AudioSource> audioSource;
+	std::unique_ptr<RecordingReader> replay;
+	if (!replayPath.empty())
+	{
+		replay = std::make_unique<RecordingReader>();
+		if (!replay->open(replayPath))
+		{
+			return EXIT_FAILURE;
+		}
+
+		const Recording::FileHeader& header = replay->getHeader();
+		if (header.numChannels == 0 || header.numChannels > PA_CHANNELS_MAX || replay->getNumSpectra() == 0)
+		{
+			fmt::print("'{}' has no spectra to replay\n", replayPath);
+			return EXIT_FAILURE;
+		}
+
+		// The rest of the header sizes the texture and the GUI, which the spectra are then read into. The texture's
+		// limits are checked once there's a context, in initDrawingPipeline
+		if ((header.analysis != static_cast<uint32_t>(AudioEngine::Analysis::Linear) &&
+			header.analysis != static_cast<uint32_t>(AudioEngine::Analysis::ConstantQ)) ||
+			header.numOutputBins == 0 ||
+			header.maxBands > AudioEngine::s_maxSpectrumBuckets)
+		{
+			fmt::print("'{}' has an analysis this build can't replay\n", replayPath);
+			return EXIT_FAILURE;
+		}
+
+		numChannels = header.numChannels;
+		analysis = static_cast<AudioEngine::Analysis>(header.analysis);
+	}
+	else
+	{
+		audioSource = AudioSource::create(audioSourceDescription);
+		if (audioSource == nullptr)
+		{
+			fmt::print("Invalid audio source '{}'\n", audioSourceDescription);
+			return EXIT_FAILURE;
+		}
+	}
+
 	if (SDL_Init(SDL_INIT_VIDEO) != 0)
 	{
 		fmt::print("SDL System cannot init with error: {}\n", SDL_GetError());
@@ -44,7 +232,13 @@ int GLAudioVisApp::execute(int argc, char* argv[])
 	}
 	else // Scoped to ensure GLAudioVisApp dtor is called before SDL_Quit
 	{
-		GLAudioVisApp app;
+		GLAudioVisApp app(
+			std::move(audioSource),
+			analysis,
+			static_cast<unsigned char>(numChannels),
+			std::move(replay),
+			replaySettings
+		);
 		// handle init failure
 		if (!app.init())
 		{
@@ -53,6 +247,13 @@ int GLAudioVisApp::execute(int argc, char* argv[])
 			SDL_Quit();
 			return EXIT_FAILURE;
 		}
+		// The engine knows its bin count once it's initialised, and the file's written to as soon as recording starts
+		else if (!recordPath.empty() && !app.m_audioEngine.openRecorder(recordPath, recordSettings))
+		{
+			fmt::print("GLAudioVisApp Failed to open '{}' for recording - exiting\n", recordPath);
+			SDL_Quit();
+			return EXIT_FAILURE;
+		}
 		else
 		{
 			app.run();
@@ -68,7 +269,15 @@ GLAudioVisApp::~GLAudioVisApp()
 {
 	fmt::print("GLAudioVisApp::~GLAudioVisApp\n");
 
+	// The latency of the whole run, for tuning buffer sizes against
+	if (m_audioEngine.getLatencyStats().get(LatencyStage::Capture).getCount() > 0)
+	{
+		fmt::print("Latency from capture:\n");
+		m_audioEngine.getLatencyStats().print(stdout);
+	}
+
 	GLUtils::clearTimers();
+	GLUtils::GPUProfiler::instance().clear();
 
 	if (m_imGuiContext != nullptr)
 	{
@@ -105,22 +314,28 @@ bool GLAudioVisApp::init()
 		return false;
 	}
 
-	if (!initDrawingPipeline())
+	// The engine decides how many bins there are, which sizes the DFT texture. A replay has no source for it to
+	// open, and the recording says how many bins there are instead
+	if (m_replay == nullptr && !m_audioEngine.init())
 	{
 		fmt::print(
-			"GLAudioVisApp::init: Failed to configure drawing pipeline\n"
+			"GLAudioVisApp::init: Failed to init Audio Engine\n"
 		);
 		return false;
 	}
 
-	if (!m_audioEngine.init())
+	if (!initDrawingPipeline())
 	{
 		fmt::print(
-			"GLAudioVisApp::init: Failed to init Audio Engine\n"
+			"GLAudioVisApp::init: Failed to configure drawing pipeline\n"
 		);
 		return false;
 	}
 
+	// Cheap enough to leave on, it can be turned off from the Profiler window
+	Profiler::setThreadName("Render");
+	Profiler::setEnabled(true);
+
 	return true;
 }
 
@@ -244,12 +459,29 @@ bool GLAudioVisApp::initDrawingPipeline()
 	m_dftTexture = std::make_unique<const GLUtils::Texture>();
 	m_dftTexture->bindAs(GL_TEXTURE_3D);
 
+	// Bins across, channels down, which either the engine's settings or a recording's header decide
+	GLint maxTextureSize = 0;
+	glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &maxTextureSize);
+	const unsigned int textureLimit = static_cast<unsigned int>(std::max(maxTextureSize, 0));
+	if (getNumSpectrumBins() > textureLimit ||
+		m_audioEngine.getSamplingSettings().numChannels > textureLimit ||
+		m_sampleCountDFT > textureLimit)
+	{
+		fmt::print(
+			"GLAudioVisApp::initDrawingPipeline: {} bins of {} channel(s) don't fit in a 3D texture, at most {}\n",
+			getNumSpectrumBins(),
+			m_audioEngine.getSamplingSettings().numChannels,
+			textureLimit
+		);
+		return false;
+	}
+
 	// Float texture, [dftSize * numChannels * m_sampleCountDFT]
 	glTexImage3D(
 		GL_TEXTURE_3D,
 		0,
 		GL_R32F,
-		m_audioEngine.getSamplingSettings().numSamples / 2,
+		getNumSpectrumBins(),
 		m_audioEngine.getSamplingSettings().numChannels,
 		m_sampleCountDFT, // acts as a trail of samples
 		0,
@@ -266,6 +498,27 @@ bool GLAudioVisApp::initDrawingPipeline()
 	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	// glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
+	// Spectral descriptors live in a uniform block, sized for the most channels the shader supports, and only the
+	// channels we have are updated
+	if (!m_outputShader->bindUniformBlock("SpectralDescriptors", s_descriptorBindingPoint))
+	{
+		fmt::print("GLAudioVisApp::initDrawingPipeline: output shader has no SpectralDescriptors block!\n");
+		return false;
+	}
+
+	// More than a render's worth of frames, so the render loop doesn't allocate
+	m_uploadedCaptureTimes.reserve(64);
+
+	m_descriptorBlock.assign(s_descriptorFloatsPerChannel * s_maxDescriptorChannels, 0.0f);
+	m_descriptorBuffer = std::make_unique<const GLUtils::Buffer>();
+	m_descriptorBuffer->bindToIndex(GL_UNIFORM_BUFFER, s_descriptorBindingPoint);
+	glBufferData(
+		GL_UNIFORM_BUFFER,
+		m_descriptorBlock.size() * sizeof(float),
+		m_descriptorBlock.data(),
+		GL_DYNAMIC_DRAW
+	);
+
 	// enable programmable point size in vertex shaders, no better place to put this?
 	glEnable(GL_PROGRAM_POINT_SIZE);
 
@@ -275,6 +528,12 @@ bool GLAudioVisApp::initDrawingPipeline()
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_ONE, GL_ONE);
 
+	if (m_replay != nullptr)
+	{
+		m_replayLastUpdate = std::chrono::steady_clock::now();
+		seekReplay(0);
+	}
+
 	return true;
 }
 
@@ -285,7 +544,14 @@ void GLAudioVisApp::run()
 	const auto& mainWindowRaw = m_mainWindow->get();
 	while (true)
 	{
-		const auto start = std::chrono::system_clock::now();
+		const auto start = std::chrono::steady_clock::now();
+
+		// Gather what every thread, and the GPU, has finished since last time, unless the timeline's being looked at
+		if (!m_profilerPaused)
+		{
+			GLUtils::GPUProfiler::instance().collect();
+			Profiler::collect();
+		}
 
 		// Event handling
 		while (SDL_PollEvent(&event) != 0)
@@ -310,16 +576,32 @@ void GLAudioVisApp::run()
 		ImGui::NewFrame();
 
 		// Populate the ImGui frame with scene info
-		drawGUI();
+		{
+			GAZ_PROFILE_SCOPE("GLAudioVisApp::drawGUI");
+			drawGUI();
+		}
 
 		// Draw the ImGui frame
-		ImGui::Render();
-		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		{
+			GAZ_PROFILE_GPU_SCOPE("ImGui::Render");
+			ImGui::Render();
+			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		}
 
-		SDL_GL_SwapWindow(mainWindowRaw);
+		{
+			GAZ_PROFILE_SCOPE("SDL_GL_SwapWindow");
+			SDL_GL_SwapWindow(mainWindowRaw);
+		}
 
-		const auto end = std::chrono::system_clock::now();
-		runLoopElapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+		// The frames uploaded this time round are on their way to the screen
+		const auto end = std::chrono::steady_clock::now();
+		for (const auto captureTime : m_uploadedCaptureTimes)
+		{
+			m_audioEngine.getLatencyStats().record(LatencyStage::Swap, captureTime, end);
+		}
+		m_uploadedCaptureTimes.clear();
+
+		runLoopElapsed = std::chrono::duration<float, std::milli>(end - start).count();
 	}
 }
 
@@ -341,7 +623,21 @@ void GLAudioVisApp::processEvent(const SDL_Event& event)
 	}
 	else if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_SPACE)
 	{
-		m_audioEngine.toggleRecording();
+		if (m_replay != nullptr)
+		{
+			m_replayPaused = !m_replayPaused;
+		}
+		else
+		{
+			m_audioEngine.toggleRecording();
+		}
+	}
+	else if (m_replay != nullptr && event.type == SDL_KEYDOWN &&
+		(event.key.keysym.sym == SDLK_LEFT || event.key.keysym.sym == SDLK_RIGHT))
+	{
+		// Scrub by a few seconds
+		constexpr int64_t scrubNs = 5'000'000'000;
+		seekReplay(m_replayPosition + (event.key.keysym.sym == SDLK_RIGHT ? scrubNs : -scrubNs));
 	}
 
 	m_camera.processInput(event);
@@ -349,7 +645,8 @@ void GLAudioVisApp::processEvent(const SDL_Event& event)
 
 void GLAudioVisApp::drawFrame()
 {
-	GLUtils::scopedTimer(frameTimer);
+	GLUtils::scopedElapsedTimer(frameTimer);
+	GAZ_PROFILE_GPU_SCOPE("GLAudioVisApp::drawFrame");
 
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -358,47 +655,74 @@ void GLAudioVisApp::drawFrame()
 	glActiveTexture(GL_TEXTURE0);
 	m_dftTexture->bindAs(GL_TEXTURE_3D);
 
+	static const auto dftIndexLoc = m_outputShader->getUniformLocation("dftLastIndex");
+
 	// TODO: SoA rather than AoS?
-	if (m_audioEngine.isRecordingActive())
+	if (m_replay != nullptr)
 	{
 		GLUtils::scopedTimer(uniformTimer);
 
-		// Ask AudioEngine for DFT Samples, upload them if it's got one
-		// AudioEngine should not give the same sample twice, so we don't repeat uploads
-
-		static const auto dftIndexLoc = m_outputShader->getUniformLocation("dftLastIndex");
-
-		const auto dftSample = m_audioEngine.requestDFT(/*AudioEngine::Channel::Left*/);
+		if (advanceReplay())
+		{
+			glUniform1ui(dftIndexLoc, m_sampleIndexDFT);
+		}
+	}
+	else if (m_audioEngine.isRecordingActive())
+	{
+		GLUtils::scopedTimer(uniformTimer);
 
-		if (dftSample.has_value())
+		// Ask AudioEngine for DFT Samples, upload every frame it has published since the last render so none are
+		// lost. AudioEngine will not give the same sample twice, so we don't repeat uploads
+		bool dftUploaded = false;
+		while (const SpectrumFrame* dftSample = m_audioEngine.acquireFrame())
 		{
-			glTexSubImage3D(
-				GL_TEXTURE_3D,
-				0,
-				0, // x offset
-				0, // left
-				m_sampleIndexDFT,
-				m_audioEngine.getSamplingSettings().numSamples / 2,
-				m_audioEngine.getSamplingSettings().numChannels, // both channels are combined in the sample
-				1,
-				GL_RED,
-				GL_FLOAT,
-				dftSample.value().data()
+			uploadSpectrum(dftSample->getSpectrum(m_audioEngine.getDisplayPlane()).data());
+
+			m_audioEngine.getLatencyStats().record(
+				LatencyStage::Upload,
+				dftSample->captureTime,
+				std::chrono::steady_clock::now()
 			);
+			m_uploadedCaptureTimes.push_back(dftSample->captureTime);
 
-			// this should go after the uniform update, but seems to work better before?
-			m_sampleIndexDFT = (m_sampleIndexDFT + 1) % m_sampleCountDFT;
+			// Only the newest descriptors are uploaded, so just keep overwriting them
+			const size_t numChannels = std::min<size_t>(dftSample->descriptors.size(), s_maxDescriptorChannels);
+			for (size_t channel = 0; channel < numChannels; ++channel)
+			{
+				const DSP::SpectralDescriptors& descriptors = dftSample->descriptors[channel];
+				float* block = &m_descriptorBlock[s_descriptorFloatsPerChannel * channel];
+				block[0] = descriptors.centroid;
+				block[1] = descriptors.bandwidth;
+				block[2] = descriptors.rolloff;
+				block[3] = descriptors.flatness;
+				block[4] = descriptors.crest;
+				block[5] = descriptors.flux;
+			}
 
-			glUniform1ui(dftIndexLoc, m_sampleIndexDFT);
+			dftUploaded = true;
 
 			// fmt::print("dft sample consumed\n");
 		}
-		// else
-		// {
-		// 	fmt::print("dft sample not ready!\n");
-		// }
+
+		if (dftUploaded)
+		{
+			glUniform1ui(dftIndexLoc, m_sampleIndexDFT);
+
+			const size_t numChannels =
+				std::min<size_t>(m_audioEngine.getSamplingSettings().numChannels, s_maxDescriptorChannels);
+			m_descriptorBuffer->bindAs(GL_UNIFORM_BUFFER);
+			glBufferSubData(
+				GL_UNIFORM_BUFFER,
+				0,
+				s_descriptorFloatsPerChannel * numChannels * sizeof(float),
+				m_descriptorBlock.data()
+			);
+		}
 	}
 
+	static const auto decibelRangeLoc = m_outputShader->getUniformLocation("decibelRange");
+	glUniform2f(decibelRangeLoc, m_cubeDecibelFloor, m_cubeDecibelCeiling);
+
 	static const auto viewLoc = m_outputShader->getUniformLocation("view");
 	glUniformMatrix4fv(
 		viewLoc,
@@ -412,8 +736,88 @@ void GLAudioVisApp::drawFrame()
 	glDrawArrays(GL_POINTS, 0, pointCount);
 }
 
+void GLAudioVisApp::uploadSpectrum(const float* spectrum)
+{
+	glTexSubImage3D(
+		GL_TEXTURE_3D,
+		0,
+		0, // x offset
+		0, // left
+		m_sampleIndexDFT,
+		getNumSpectrumBins(),
+		m_audioEngine.getSamplingSettings().numChannels, // one row per channel
+		1,
+		GL_RED,
+		GL_FLOAT,
+		spectrum
+	);
+
+	// this should go after the uniform update, but seems to work better before?
+	m_sampleIndexDFT = (m_sampleIndexDFT + 1) % m_sampleCountDFT;
+}
+
+bool GLAudioVisApp::advanceReplay()
+{
+	const auto now = std::chrono::steady_clock::now();
+	const int64_t elapsedNs = m_replaySettings.fixedFPS > 0 ?
+		1'000'000'000 / m_replaySettings.fixedFPS :
+		std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_replayLastUpdate).count();
+	m_replayLastUpdate = now;
+
+	// Still upload when paused, in case we've been scrubbed
+	if (!m_replayPaused)
+	{
+		m_replayPosition += static_cast<int64_t>(elapsedNs * static_cast<double>(m_replaySettings.speed));
+		if (m_replayPosition > m_replay->getDurationNs())
+		{
+			if (m_replaySettings.loop)
+			{
+				seekReplay(0);
+			}
+			else
+			{
+				m_replayPosition = m_replay->getDurationNs();
+				m_replayPaused = true;
+			}
+		}
+	}
+
+	// Everything up to the position, but when we're going faster than the trail is long only its last slices are
+	// visible, so don't upload the rest. The spectra go straight from the mapping to the texture
+	const size_t end = m_replay->seek(m_replayPosition + 1);
+	const size_t begin = std::max(m_replayIndex, end > m_sampleCountDFT ? end - m_sampleCountDFT : 0);
+	for (size_t index = begin; index < end; ++index)
+	{
+		// A malformed chunk is skipped, rather than read past
+		RecordingReader::Spectrum spectrum;
+		if (m_replay->getSpectrum(index, spectrum))
+		{
+			uploadSpectrum(spectrum.spectrum);
+		}
+	}
+
+	m_replayIndex = end;
+	return end > begin;
+}
+
+void GLAudioVisApp::seekReplay(int64_t positionNs)
+{
+	m_replayPosition = std::clamp<int64_t>(positionNs, 0, m_replay->getDurationNs());
+
+	// Back far enough that the next update refills the whole trail
+	const size_t end = m_replay->seek(m_replayPosition + 1);
+	m_replayIndex = end > m_sampleCountDFT ? end - m_sampleCountDFT : 0;
+}
+
+unsigned int GLAudioVisApp::getNumSpectrumBins() const
+{
+	return m_replay != nullptr ? m_replay->getHeader().numOutputBins : m_audioEngine.getNumOutputBins();
+}
+
 void GLAudioVisApp::drawGUI()
 {
+	drawProfilerGUI();
+
 	if (!ImGui::Begin("Stats"))
 	{
 		// Early out if the window is collapsed
@@ -459,63 +863,141 @@ void GLAudioVisApp::drawGUI()
 
 	ImGui::Separator();
 
+	// The engine's idle during a replay, so it has nothing to show
+	if (m_replay != nullptr)
+	{
+		drawReplayGUI();
+		ImGui::End();
+		return;
+	}
+
 	ImGui::Text("Audio Sample Size: %lu", pa_sample_size_of_format(m_audioEngine.getSamplingSettings().sampleFormat));
 	ImGui::Text("Audio Samples: %u", m_audioEngine.getSamplingSettings().numSamples);
+	ImGui::Text("DFT Hop Size: %u", m_audioEngine.getSamplingSettings().getHopSize());
+	ImGui::Text(
+		"Spectrum: %u %s bins",
+		m_audioEngine.getNumOutputBins(),
+		m_audioEngine.getSamplingSettings().analysis == AudioEngine::Analysis::ConstantQ ? "constant-Q" : "linear"
+	);
+	ImGui::Text("DFT Plan: %s", m_audioEngine.isDFTPlanOptimal() ? "patient" : "estimated (upgrading)");
+	ImGui::Text("Analysis Threads: %u", m_audioEngine.getNumWorkerThreads());
+	ImGui::Text("Sample History: %s", m_audioEngine.isHistorySpecialised() ? "specialised" : "runtime sized");
+	ImGui::Text("Dropped DFT frames: %lu", m_audioEngine.getDroppedFrameCount());
+
+	const CaptureStats captureStats = m_audioEngine.getCaptureStats();
+	if (captureStats.fragments > 0)
+	{
+		ImGui::Text("Capture Latency: %.1fms", captureStats.latencyMs);
+		ImGui::Text(
+			"Capture Fragment Interval: %.1fms (max %.1fms)",
+			captureStats.fragmentIntervalMs,
+			captureStats.maxFragmentIntervalMs
+		);
+		ImGui::Text(
+			"Capture Overruns: %lu server, %lu frames dropped",
+			captureStats.serverOverflows,
+			captureStats.droppedFrames
+		);
+	}
 
 	{
 		if (ImGui::Button(!m_audioEngine.isRecordingActive() ? "Start Recording" : "Stop Recording"))
 		{
 			m_audioEngine.toggleRecording();
 		}
-/*
+
+		float decibelFloor = m_audioEngine.getDecibelFloor();
+		if (ImGui::SliderFloat("##DecibelFloor", &decibelFloor, -160.0f, 0.0f, "DFT Floor: %.0f dB"))
+		{
+			m_audioEngine.setDecibelFloor(decibelFloor);
+		}
+
 		int numSpectrumBuckets = m_audioEngine.getSpectrumBucketCount();
-		if (ImGui::SliderInt("##NumBuckets", &numSpectrumBuckets, 1, 100, "Num Spectrum Buckets: %i"))
+		if (ImGui::SliderInt(
+			"##NumBuckets",
+			&numSpectrumBuckets,
+			1,
+			AudioEngine::s_maxSpectrumBuckets,
+			"Num Spectrum Buckets: %i"
+		))
 		{
 			m_audioEngine.setSpectrumBucketCount(numSpectrumBuckets);
 		}
 
-		ImGui::SetNextItemWidth(currentWidth);
+		int bandScale = static_cast<int>(m_audioEngine.getSpectrumBandScale());
+		if (ImGui::Combo("##BandScale", &bandScale, "Log\0Mel\0Bark\0"))
+		{
+			m_audioEngine.setSpectrumBandScale(DSP::BandScale(bandScale));
+		}
 
-		float histogramSmoothing = m_audioEngine.getHistogramSmoothing();
-		if (ImGui::SliderFloat("##Smoothing", &histogramSmoothing, 0.0f, 1.0f, "Histogram Smoothing: %.1f"))
+		int weighting = static_cast<int>(m_audioEngine.getFrequencyWeighting());
+		if (ImGui::Combo("##Weighting", &weighting, "Unweighted\0A-weighted\0K-weighted\0"))
 		{
-			m_audioEngine.setHistogramSmoothing(histogramSmoothing);
+			m_audioEngine.setFrequencyWeighting(DSP::FrequencyWeighting(weighting));
 		}
-*/
-		ImGui::Columns(m_audioEngine.getSamplingSettings().numChannels);
-		for (unsigned int i = 0; i < m_audioEngine.getSamplingSettings().numChannels; ++i)
+
+		drawCubeRangeGUI();
+
+		int displayPlane = static_cast<int>(m_audioEngine.getDisplayPlane());
+		if (ImGui::Combo("##DisplayPlane", &displayPlane, "Raw\0Smoothed\0Peak Hold\0Average\0"))
 		{
-			const auto& columnWidth = ImGui::GetColumnWidth();
+			m_audioEngine.setDisplayPlane(SpectrumPlane(displayPlane));
+		}
 
-			const AudioEngine::Channel channel = AudioEngine::Channel(i);
-			const char* channelNameShort = channel == AudioEngine::Channel::Left ? "L" : "R";
-			const char* channelNameLong = channel == AudioEngine::Channel::Left ? "Left" : "Right";
+		AudioEngine::SmoothingSettings smoothing = m_audioEngine.getSmoothing();
+		bool smoothingChanged = false;
+		smoothingChanged |= ImGui::SliderFloat(
+			"##Attack", &smoothing.attackSeconds, 0.0f, 1.0f, "Attack: %.3f s");
+		smoothingChanged |= ImGui::SliderFloat(
+			"##Release", &smoothing.releaseSeconds, 0.0f, 5.0f, "Release: %.2f s");
+		smoothingChanged |= ImGui::SliderFloat(
+			"##PeakFall", &smoothing.peakFallDecibelsPerSecond, 0.0f, 120.0f, "Peak Fall: %.0f dB/s");
+		smoothingChanged |= ImGui::SliderFloat(
+			"##Average", &smoothing.averageSeconds, 0.1f, 60.0f, "Average: %.1f s");
+		if (smoothingChanged)
+		{
+			m_audioEngine.setSmoothing(smoothing);
+		}
 
-			ImGui::Text("%s (%s)", channelNameShort, channelNameLong);
+		m_audioEngine.showLoudness();
+		m_audioEngine.showRhythm();
+		m_audioEngine.showStereo(ImVec2(0, 60));
+		m_audioEngine.showRecorder();
+		m_audioEngine.showLatency();
+
+		// One column per channel, wrapping onto more rows when there are lots of them
+		const unsigned int numChannels = m_audioEngine.getSamplingSettings().numChannels;
+		ImGui::Columns(std::min(numChannels, 4u));
+		for (unsigned int channel = 0; channel < numChannels; ++channel)
+		{
+			const auto& columnWidth = ImGui::GetColumnWidth();
+
+			ImGui::Text("%u (%s)", channel, m_audioEngine.getChannelName(channel).c_str());
+			m_audioEngine.showLevelMeters(channel);
 
 			// Raw PCM
 			m_audioEngine.plotInputPCM(
 				channel,
-				fmt::format("##AudioSamples{}", channelNameShort).c_str(),
-				fmt::format("Raw PCM ({})", channelNameShort).c_str(),
+				fmt::format("##AudioSamples{}", channel).c_str(),
+				fmt::format("Raw PCM ({})", channel).c_str(),
 				ImVec2(columnWidth, 80)
 			);
 
 			// Raw DFT
 			m_audioEngine.plotDFT(
 				channel,
-				fmt::format("##fftOutputRaw{}", channelNameShort).c_str(),
-				fmt::format("Raw DFT ({})", channelNameShort).c_str(),
+				fmt::format("##fftOutputRaw{}", channel).c_str(),
+				fmt::format("Raw DFT ({})", channel).c_str(),
 				ImVec2(columnWidth, 80)
 			);
 
-			// // Histogram
-			// m_audioEngine.plotSpectrum(
-			// 	channel,
-			// 	fmt::format("##AudioHistogram{}", channelNameShort).c_str(),
-			// 	fmt::format("Histogram ({})", channelNameShort).c_str(),
-			// 	ImVec2(columnWidth, 80)
-			// );
+			// Histogram
+			m_audioEngine.plotSpectrum(
+				channel,
+				fmt::format("##AudioHistogram{}", channel).c_str(),
+				fmt::format("Histogram ({})", channel).c_str(),
+				ImVec2(columnWidth, 80)
+			);
 
 			ImGui::NextColumn();
 		}
@@ -525,4 +1007,254 @@ void GLAudioVisApp::drawGUI()
 	}
 
 	ImGui::End();
-}
\ No newline at end of file
+}
+
+void GLAudioVisApp::drawReplayGUI()
+{
+	const Recording::FileHeader& header = m_replay->getHeader();
+	ImGui::Text("Replaying: %s", m_replay->getPath().c_str());
+	const bool constantQ = static_cast<AudioEngine::Analysis>(header.analysis) == AudioEngine::Analysis::ConstantQ;
+	ImGui::Text(
+		"%u channel(s) at %uHz, %u %s bins, DFT window %u, hop %u",
+		header.numChannels,
+		header.sampleRate,
+		header.numOutputBins,
+		constantQ ? "constant-Q" : "linear",
+		header.numSamples,
+		header.hopSize
+	);
+	ImGui::Text("Spectra: %zu%s", m_replay->getNumSpectra(), m_replay->isIndexed() ? "" : " (unindexed, scanned)");
+
+	if (ImGui::Button(m_replayPaused ? "Play" : "Pause"))
+	{
+		m_replayPaused = !m_replayPaused;
+	}
+	ImGui::SameLine();
+	ImGui::Checkbox("Loop", &m_replaySettings.loop);
+
+	float positionSeconds = m_replayPosition * 1e-9f;
+	if (ImGui::SliderFloat(
+		"##ReplayPosition",
+		&positionSeconds,
+		0.0f,
+		m_replay->getDurationNs() * 1e-9f,
+		"Position: %.2f s"
+	))
+	{
+		seekReplay(static_cast<int64_t>(positionSeconds * 1e9));
+	}
+
+	ImGui::SliderFloat("##ReplaySpeed", &m_replaySettings.speed, 0.05f, 16.0f, "Speed: %.2fx");
+	m_replaySettings.speed = std::max(m_replaySettings.speed, 0.05f);
+
+	drawCubeRangeGUI();
+
+	// The meters of the last spectrum uploaded
+	if (m_replayIndex == 0)
+	{
+		return;
+	}
+
+	RecordingReader::Spectrum spectrum;
+	if (!m_replay->getSpectrum(m_replayIndex - 1, spectrum))
+	{
+		ImGui::Text("Spectrum %zu is malformed", m_replayIndex - 1);
+		return;
+	}
+
+	const Recording::SpectrumChunk& meters = *spectrum.meters;
+	ImGui::Text(
+		"Loudness: %.1f LUFS momentary, %.1f LUFS short-term",
+		meters.momentaryLoudness,
+		meters.shortTermLoudness
+	);
+	ImGui::Text("Tempo: %.1f BPM, Onset Strength: %.2f dB", meters.tempo, meters.onsetStrength);
+	ImGui::ProgressBar(meters.beatPhase, ImVec2(-1.0f, 0.0f), "Beat Phase");
+	if (header.numChannels >= 2)
+	{
+		ImGui::Text("Stereo: Correlation %+.2f, Width %.2f", meters.stereoCorrelation, meters.stereoWidth);
+	}
+
+	ImGui::Columns(std::min(header.numChannels, 4u));
+	for (unsigned int channel = 0; channel < header.numChannels; ++channel)
+	{
+		ImGui::Text("%u: %.1f dBFS RMS, %.1f dBTP", channel, spectrum.rms[channel], spectrum.truePeak[channel]);
+		ImGui::PlotHistogram(
+			fmt::format("##ReplayBands{}", channel).c_str(),
+			spectrum.bands + meters.numBands * channel,
+			static_cast<int>(meters.numBands),
+			0,
+			fmt::format("Histogram ({})", channel).c_str(),
+			m_audioEngine.getDecibelFloor(),
+			0.0f,
+			ImVec2(ImGui::GetColumnWidth(), 80)
+		);
+		ImGui::NextColumn();
+	}
+	ImGui::Columns(1);
+}
+
+void GLAudioVisApp::drawCubeRangeGUI()
+{
+	ImGui::DragFloatRange2(
+		"##CubeRange",
+		&m_cubeDecibelFloor,
+		&m_cubeDecibelCeiling,
+		0.5f,
+		-160.0f,
+		12.0f,
+		"Cube Floor: %.0f dB",
+		"Ceiling: %.0f dB"
+	);
+}
+
+void GLAudioVisApp::drawProfilerGUI()
+{
+	if (!ImGui::Begin("Profiler"))
+	{
+		// Early out if the window is collapsed
+		ImGui::End();
+		return;
+	}
+
+	bool enabled = Profiler::isEnabled();
+	if (ImGui::Checkbox("Record", &enabled))
+	{
+		Profiler::setEnabled(enabled);
+	}
+	ImGui::SameLine();
+	ImGui::Checkbox("Pause", &m_profilerPaused);
+	ImGui::SameLine();
+	ImGui::SliderFloat("##ProfilerSpan", &m_profilerSpanMs, 1.0f, Profiler::s_historyNs * 1e-6f, "Span: %.0f ms");
+	m_profilerSpanMs = std::max(m_profilerSpanMs, 1.0f);
+
+	const std::vector<int64_t>& frameTimes = Profiler::getFrameTimes();
+	if (!m_profilerPaused && !frameTimes.empty())
+	{
+		m_profilerViewEnd = frameTimes.back();
+	}
+
+	const unsigned long gpuSkipped = GLUtils::GPUProfiler::instance().getSkipped();
+	if (gpuSkipped > 0)
+	{
+		ImGui::Text("GPU scopes skipped, waiting on the GPU: %lu", gpuSkipped);
+	}
+
+	const int64_t spanNs = static_cast<int64_t>(m_profilerSpanMs * 1e6f);
+	const int64_t viewStart = m_profilerViewEnd - spanNs;
+
+	constexpr float labelWidth = 120.0f;
+	const float timelineWidth = std::max(ImGui::GetContentRegionAvail().x - labelWidth, 1.0f);
+	const float nsToPixels = timelineWidth / spanNs;
+	const float rowHeight = ImGui::GetTextLineHeight() + 2.0f;
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+
+	// Everything from the site hovered last frame is outlined, on every track, e.g. to find a scope's GPU work
+	static const Profiler::Site* highlightedSite = nullptr;
+	const Profiler::Site* hoveredSite = nullptr;
+
+	for (const Profiler::Track* track : Profiler::getTracks())
+	{
+		uint32_t numRows = 1;
+		for (const Profiler::Event& event : track->events)
+		{
+			if (event.endNs >= viewStart && event.startNs <= m_profilerViewEnd)
+			{
+				numRows = std::max(numRows, event.depth + 1);
+			}
+		}
+
+		const ImVec2 origin = ImGui::GetCursorScreenPos();
+		const float height = numRows * rowHeight;
+		ImGui::Dummy(ImVec2(labelWidth + timelineWidth, height + 2.0f));
+		const bool trackHovered = ImGui::IsItemHovered();
+
+		// The tracks of threads which have exited stay until their last events have scrolled off
+		const bool alive = track->alive.load(std::memory_order_relaxed);
+		drawList->AddText(
+			origin,
+			alive ? IM_COL32(255, 255, 255, 255) : IM_COL32(128, 128, 128, 255),
+			track->name.c_str()
+		);
+		const uint64_t dropped = Profiler::getDropped(*track);
+		if (dropped > 0)
+		{
+			const std::string droppedText = fmt::format("{} dropped", dropped);
+			drawList->AddText(ImVec2(origin.x, origin.y + rowHeight), IM_COL32(255, 96, 96, 255), droppedText.c_str());
+		}
+
+		const float left = origin.x + labelWidth;
+		const float right = left + timelineWidth;
+		drawList->AddRectFilled(ImVec2(left, origin.y), ImVec2(right, origin.y + height), IM_COL32(32, 32, 32, 255));
+
+		// Each frame starts at a collect()
+		for (const int64_t frameTime : frameTimes)
+		{
+			if (frameTime >= viewStart && frameTime <= m_profilerViewEnd)
+			{
+				const float x = left + (frameTime - viewStart) * nsToPixels;
+				drawList->AddRectFilled(
+					ImVec2(x, origin.y),
+					ImVec2(x + 1.0f, origin.y + height),
+					IM_COL32(255, 255, 255, 64)
+				);
+			}
+		}
+
+		for (const Profiler::Event& event : track->events)
+		{
+			if (event.endNs < viewStart || event.startNs > m_profilerViewEnd)
+			{
+				continue;
+			}
+
+			const float x0 = left + std::max<int64_t>(event.startNs - viewStart, 0) * nsToPixels;
+			const float x1 = std::max(left + std::min(event.endNs - viewStart, spanNs) * nsToPixels, x0 + 1.0f);
+			const float y0 = origin.y + event.depth * rowHeight;
+			const float y1 = y0 + rowHeight - 1.0f;
+
+			drawList->AddRectFilled(ImVec2(x0, y0), ImVec2(x1, y1), getSiteColour(event.site));
+			if (event.site == highlightedSite)
+			{
+				drawList->AddRect(ImVec2(x0, y0), ImVec2(x1, y1), IM_COL32(255, 255, 255, 255));
+			}
+
+			// Only label the scopes wide enough to fit theirs
+			if (ImGui::CalcTextSize(event.site->name).x + 4.0f < x1 - x0)
+			{
+				drawList->AddText(ImVec2(x0 + 2.0f, y0), IM_COL32(255, 255, 255, 255), event.site->name);
+			}
+
+			if (trackHovered && ImGui::IsMouseHoveringRect(ImVec2(x0, y0), ImVec2(x1, y1)))
+			{
+				hoveredSite = event.site;
+				const double durationMs = (event.endNs - event.startNs) * 1e-6;
+				if (event.issuedNs != 0)
+				{
+					ImGui::SetTooltip(
+						"%s\n%.3f ms on the GPU, starting %.3f ms after it was issued\n%s:%d",
+						event.site->name,
+						durationMs,
+						(event.startNs - event.issuedNs) * 1e-6,
+						event.site->file,
+						event.site->line
+					);
+				}
+				else
+				{
+					ImGui::SetTooltip(
+						"%s\n%.3f ms\n%s:%d",
+						event.site->name,
+						durationMs,
+						event.site->file,
+						event.site->line
+					);
+				}
+			}
+		}
+	}
+
+	highlightedSite = hoveredSite;
+
+	ImGui::End();
+}
@@ -0,0 +1,131 @@
+#include "GLUtils/GPUProfiler.h"
+
+namespace
+{
+// How often the GPU's clock is lined up with the CPU's again, in case they drift
+constexpr int64_t s_calibrationIntervalNs = 1000000000;
+} // namespace
+
+GLUtils::GPUProfiler& GLUtils::GPUProfiler::instance()
+{
+	static GPUProfiler profiler;
+	return profiler;
+}
+
+GLUtils::GPUProfiler::GPUProfiler()
+	: m_queries() // default initialize elements
+	, m_hasQueries(true)
+	, m_begun(0)
+	, m_collected(0)
+	, m_depth(0)
+	, m_skipped(0)
+	, m_clockOffset(0)
+	, m_lastCalibration(0)
+	, m_track(nullptr)
+{
+	for(Query& query : m_queries)
+	{
+		glGenQueries(1, &query.start);
+		glGenQueries(1, &query.end);
+	}
+}
+
+int GLUtils::GPUProfiler::begin(const gaz::Profiler::Site& site)
+{
+	if(!gaz::Profiler::isEnabled() || !m_hasQueries)
+	{
+		return -1;
+	}
+
+	// Skip the scope rather than wait for a slot
+	if(m_begun - m_collected >= s_numQueries)
+	{
+		++m_skipped;
+		return -1;
+	}
+
+	// Like a thread's, the track's only made once there's something to put on it
+	if(m_track == nullptr)
+	{
+		m_track = gaz::Profiler::createTrack("GPU");
+	}
+
+	const int slot = static_cast<int>(m_begun++ % s_numQueries);
+	Query& query = m_queries[slot];
+	query.site = &site;
+	query.depth = m_depth++;
+	query.issuedNs = gaz::Profiler::now();
+	query.ended = false;
+	glQueryCounter(query.start, GL_TIMESTAMP);
+	return slot;
+}
+
+void GLUtils::GPUProfiler::end(int slot)
+{
+	if(slot < 0 || !m_hasQueries)
+	{
+		return;
+	}
+
+	Query& query = m_queries[slot];
+	glQueryCounter(query.end, GL_TIMESTAMP);
+	query.ended = true;
+	--m_depth;
+}
+
+void GLUtils::GPUProfiler::collect()
+{
+	if(!m_hasQueries)
+	{
+		return;
+	}
+
+	// Asking for the GPU's time doesn't wait for it to finish, but it isn't free either, so only now and then
+	const int64_t now = gaz::Profiler::now();
+	if(m_lastCalibration == 0 || now - m_lastCalibration > s_calibrationIntervalNs)
+	{
+		GLint64 gpuTime;
+		glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+		m_clockOffset = gaz::Profiler::now() - gpuTime;
+		m_lastCalibration = now;
+	}
+
+	// Results arrive in submission order, so stop at the first one that isn't ready
+	while(m_collected != m_begun)
+	{
+		const Query& query = m_queries[m_collected % s_numQueries];
+		if(!query.ended || !isAvailable(query.end) || !isAvailable(query.start))
+		{
+			break;
+		}
+
+		GLint64 start, end;
+		glGetQueryObjecti64v(query.start, GL_QUERY_RESULT, &start);
+		glGetQueryObjecti64v(query.end, GL_QUERY_RESULT, &end);
+		gaz::Profiler::record(
+			*m_track,
+			{query.site, start + m_clockOffset, end + m_clockOffset, query.depth, query.issuedNs});
+
+		++m_collected;
+	}
+}
+
+void GLUtils::GPUProfiler::clear()
+{
+	if(m_hasQueries)
+	{
+		for(Query& query : m_queries)
+		{
+			glDeleteQueries(1, &query.start);
+			glDeleteQueries(1, &query.end);
+		}
+		m_hasQueries = false;
+	}
+}
+
+bool GLUtils::GPUProfiler::isAvailable(GLuint query)
+{
+	GLint available = GL_FALSE;
+	glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+	return available != GL_FALSE;
+}
@@ -134,3 +134,20 @@ GLint ShaderProgram::getUniformLocation(const char* uniformName) const
 		m_uniformLocationCache.find(uniformName);
 	return it != m_uniformLocationCache.end() ? it->second : -1;
 }
+
+bool ShaderProgram::bindUniformBlock(const char* blockName, GLuint bindingPoint) const
+{
+	if(!m_isValid)
+	{
+		return false;
+	}
+
+	const GLuint blockIndex = glGetUniformBlockIndex(m_shaderProgramID, blockName);
+	if(blockIndex == GL_INVALID_INDEX)
+	{
+		return false;
+	}
+
+	glUniformBlockBinding(m_shaderProgramID, blockIndex, bindingPoint);
+	return true;
+}
@@ -12,11 +12,9 @@ typedef std::unordered_map<size_t, GLUtils::Timer, decltype(noHash)> TimerMap;
 static TimerMap s_timers(10, noHash); // bucket size of 10?
 } // namespace
 
-void GLUtils::_startTimer(const size_t& id)
+void GLUtils::_startTimer(const size_t& id, TimerMode mode)
 {
-	// TimerMap::const_iterator it = s_timers.try_emplace(id).first;
-	// it->second.start();
-	s_timers[id].start(); // or this, since GLUtils::Timer is trivially constructed
+	s_timers.try_emplace(id, mode).first->second.start();
 }
 
 void GLUtils::_endTimer(const size_t& id)
@@ -57,23 +55,98 @@ void GLUtils::clearTimers()
 	s_timers.clear();
 }
 
-GLUtils::Timer::Timer()
-	: m_queries()
-	, // default initialize elements
-	m_elapsed(0.0f)
+GLUtils::Timer::Timer(TimerMode mode)
+	: m_mode(mode)
+	, m_queries() // default initialize elements
+	, m_started(0)
+	, m_collected(0)
+	, m_measuring(false)
+	, m_skipped(0)
+	, m_elapsed(0.0f)
 {
 	glGenQueries(s_bufferSize * 2, &m_queries.data()->start);
 }
 
+void GLUtils::Timer::start()
+{
+	// Make room first if we can, but if every slot is still in flight, skip this measurement rather than wait
+	collect();
+	m_measuring = m_started - m_collected < s_bufferSize;
+	if(!m_measuring)
+	{
+		++m_skipped;
+		return;
+	}
+
+	const TimerQuery& query = m_queries[m_started % s_bufferSize];
+	if(m_mode == TimerMode::TimeElapsed)
+	{
+		glBeginQuery(GL_TIME_ELAPSED, query.start);
+	}
+	else
+	{
+		glQueryCounter(query.start, GL_TIMESTAMP);
+	}
+}
+
 void GLUtils::Timer::end()
 {
-	glQueryCounter(m_queries.front().end, GL_TIMESTAMP);
+	if(!m_measuring)
+	{
+		return;
+	}
 
-	// rotate the buffer left 1 element, maybe not necessary?
-	std::rotate(m_queries.begin(), m_queries.begin() + 1, m_queries.end());
+	const TimerQuery& query = m_queries[m_started % s_bufferSize];
+	if(m_mode == TimerMode::TimeElapsed)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+	}
+	else
+	{
+		glQueryCounter(query.end, GL_TIMESTAMP);
+	}
+
+	++m_started;
+	m_measuring = false;
+}
+
+void GLUtils::Timer::collect()
+{
+	// Results arrive in submission order, so stop at the first one that isn't ready
+	while(m_collected != m_started)
+	{
+		const TimerQuery& query = m_queries[m_collected % s_bufferSize];
+		if(m_mode == TimerMode::TimeElapsed)
+		{
+			if(!isAvailable(query.start))
+			{
+				break;
+			}
 
-	GLint64 start, end;
-	glGetQueryObjecti64v(m_queries.front().start, GL_QUERY_RESULT, &start);
-	glGetQueryObjecti64v(m_queries.front().end, GL_QUERY_RESULT, &end);
-	m_elapsed = (end - start) / 1000000.0;
+			GLuint64 elapsed;
+			glGetQueryObjectui64v(query.start, GL_QUERY_RESULT, &elapsed);
+			m_elapsed = elapsed / 1000000.0;
+		}
+		else
+		{
+			if(!isAvailable(query.end) || !isAvailable(query.start))
+			{
+				break;
+			}
+
+			GLint64 start, end;
+			glGetQueryObjecti64v(query.start, GL_QUERY_RESULT, &start);
+			glGetQueryObjecti64v(query.end, GL_QUERY_RESULT, &end);
+			m_elapsed = (end - start) / 1000000.0;
+		}
+
+		++m_collected;
+	}
+}
+
+bool GLUtils::Timer::isAvailable(GLuint query)
+{
+	GLint available = GL_FALSE;
+	glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+	return available != GL_FALSE;
 }
@@ -0,0 +1,129 @@
+#include "LatencyHistogram.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace gaz;
+
+LatencyHistogram::LatencyHistogram() :
+	m_counts{},
+	m_count{0},
+	m_sum{0},
+	m_max{0}
+{
+	reset();
+}
+
+int64_t LatencyHistogram::getMean() const
+{
+	const uint64_t count = getCount();
+	return count > 0 ? static_cast<int64_t>(m_sum.load(std::memory_order_relaxed) / count) : 0;
+}
+
+int64_t LatencyHistogram::getPercentile(double percentile) const
+{
+	// Walk the buckets to the one holding the value at this rank. The total is taken from the buckets themselves,
+	// rather than m_count, so a value being recorded in between can't make us run off the end
+	uint64_t total = 0;
+	for (const auto& count : m_counts)
+	{
+		total += count.load(std::memory_order_relaxed);
+	}
+
+	if (total == 0)
+	{
+		return 0;
+	}
+
+	const double clamped = std::min(std::max(percentile, 0.0), 100.0);
+	const uint64_t rank = std::max<uint64_t>(static_cast<uint64_t>(std::ceil(clamped / 100.0 * total)), 1);
+
+	uint64_t seen = 0;
+	for (size_t bucket = 0; bucket < s_numBuckets; ++bucket)
+	{
+		seen += m_counts[bucket].load(std::memory_order_relaxed);
+		if (seen >= rank)
+		{
+			// A bucket's middle can overshoot the largest value in it, and the last bucket has no upper bound
+			const int64_t max = getMax();
+			return bucket + 1 < s_numBuckets ? std::min(static_cast<int64_t>(getBucketValue(bucket)), max) : max;
+		}
+	}
+
+	return getMax();
+}
+
+void LatencyHistogram::reset()
+{
+	for (auto& count : m_counts)
+	{
+		count.store(0, std::memory_order_relaxed);
+	}
+	m_count.store(0, std::memory_order_relaxed);
+	m_sum.store(0, std::memory_order_relaxed);
+	m_max.store(0, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::print(std::FILE* file, const char* name) const
+{
+	constexpr double nsToMs = 1e-6;
+	fmt::print(
+		file,
+		"{:<10} {:>8} samples, mean {:.2f}ms, p50 {:.2f}ms, p90 {:.2f}ms, p99 {:.2f}ms, p99.9 {:.2f}ms, max {:.2f}ms\n",
+		name,
+		getCount(),
+		getMean() * nsToMs,
+		getPercentile(50.0) * nsToMs,
+		getPercentile(90.0) * nsToMs,
+		getPercentile(99.0) * nsToMs,
+		getPercentile(99.9) * nsToMs,
+		getMax() * nsToMs
+	);
+}
+
+uint64_t LatencyHistogram::getBucketValue(size_t bucket)
+{
+	if (bucket < s_numSubBuckets)
+	{
+		return bucket;
+	}
+
+	// The inverse of getBucket()
+	const unsigned int shift = static_cast<unsigned int>(bucket / s_numSubBuckets) - 1;
+	const uint64_t lowest = (s_numSubBuckets + bucket % s_numSubBuckets) << shift;
+	return lowest + ((uint64_t(1) << shift) >> 1);
+}
+
+const char* gaz::toString(LatencyStage stage)
+{
+	switch (stage)
+	{
+		case LatencyStage::Capture: return "Capture";
+		case LatencyStage::Analysis: return "Analysis";
+		case LatencyStage::Publish: return "Publish";
+		case LatencyStage::Upload: return "Upload";
+		case LatencyStage::Swap: return "Swap";
+		default: return "Unknown";
+	}
+}
+
+void LatencyStats::reset()
+{
+	for (auto& histogram : m_histograms)
+	{
+		histogram.reset();
+	}
+}
+
+void LatencyStats::print(std::FILE* file) const
+{
+	for (size_t stage = 0; stage < s_numStages; ++stage)
+	{
+		if (m_histograms[stage].getCount() > 0)
+		{
+			m_histograms[stage].print(file, toString(static_cast<LatencyStage>(stage)));
+		}
+	}
+}
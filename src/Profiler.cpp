@@ -0,0 +1,156 @@
+#include "Profiler.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+
+using namespace gaz;
+
+namespace
+{
+	// Every track ever made, they're kept until exit since the render thread may still be reading a thread's
+	// events after the thread has gone, and are reused once their thread has gone
+	struct Registry
+	{
+		std::mutex mutex;
+		std::vector<std::unique_ptr<Profiler::Track>> tracks;
+		unsigned int numUnnamedTracks = 0;
+
+		// collect() only
+		std::vector<Profiler::Track*> collected;
+		std::vector<int64_t> frameTimes;
+	};
+
+	Registry& getRegistry()
+	{
+		static Registry registry;
+		return registry;
+	}
+
+	// The calling thread's name and track, the track is retired when the thread exits
+	struct ThreadTrack
+	{
+		std::string name;
+		Profiler::Track* track = nullptr;
+
+		~ThreadTrack()
+		{
+			if (track != nullptr)
+			{
+				// Under the lock, so whichever thread takes the track over sees everything we wrote to it
+				Registry& registry = getRegistry();
+				std::lock_guard<std::mutex> lock(registry.mutex);
+				track->alive.store(false, std::memory_order_relaxed);
+			}
+		}
+	};
+
+	thread_local ThreadTrack t_thread;
+};
+
+std::atomic<bool> Profiler::s_enabled{false};
+
+void Profiler::setThreadName(const std::string& name)
+{
+	// Only before the thread's first scope, a track's name doesn't change once the render thread can see it
+	if (t_thread.track == nullptr)
+	{
+		t_thread.name = name;
+	}
+}
+
+Profiler::Track* Profiler::getThreadTrack()
+{
+	if (t_thread.track != nullptr)
+	{
+		return t_thread.track;
+	}
+
+	Registry& registry = getRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+
+	// Take over the track of an exited thread by the same name, or any exited unnamed thread's
+	const bool named = !t_thread.name.empty();
+	for (const auto& track : registry.tracks)
+	{
+		if (!track->alive.load(std::memory_order_relaxed) &&
+			track->named == named &&
+			(!named || track->name == t_thread.name))
+		{
+			track->depth = 0;
+			track->alive.store(true, std::memory_order_relaxed);
+			t_thread.track = track.get();
+			return t_thread.track;
+		}
+	}
+
+	const std::string name = named ? t_thread.name : fmt::format("Thread {}", ++registry.numUnnamedTracks);
+	registry.tracks.push_back(std::make_unique<Track>(name, named));
+	t_thread.track = registry.tracks.back().get();
+	return t_thread.track;
+}
+
+Profiler::Track* Profiler::createTrack(const std::string& name)
+{
+	Registry& registry = getRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	registry.tracks.push_back(std::make_unique<Track>(name, true));
+	return registry.tracks.back().get();
+}
+
+void Profiler::collect()
+{
+	Registry& registry = getRegistry();
+	{
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		registry.collected.clear();
+		for (const auto& track : registry.tracks)
+		{
+			registry.collected.push_back(track.get());
+		}
+	}
+
+	const int64_t time = now();
+	const int64_t oldest = time - s_historyNs;
+
+	// Only we read the rings and touch the events, so the tracks themselves don't need the lock
+	for (Track* collectedTrack : registry.collected)
+	{
+		Track& track = *collectedTrack;
+		while (const Event* event = track.ring.acquire())
+		{
+			track.events.push_back(*event);
+		}
+
+		// Events are in the order they ended, near enough, so the old ones are at the front
+		const auto firstKept = std::find_if(track.events.begin(), track.events.end(), [oldest](const Event& event)
+		{
+			return event.endNs >= oldest;
+		});
+		track.events.erase(track.events.begin(), firstKept);
+	}
+
+	// Hide the tracks of threads which have gone, once there's nothing left of them to show
+	registry.collected.erase(
+		std::remove_if(registry.collected.begin(), registry.collected.end(), [](const Track* track)
+		{
+			return !track->alive.load(std::memory_order_relaxed) && track->events.empty();
+		}),
+		registry.collected.end()
+	);
+
+	registry.frameTimes.push_back(time);
+	const auto firstFrame = std::lower_bound(registry.frameTimes.begin(), registry.frameTimes.end(), oldest);
+	registry.frameTimes.erase(registry.frameTimes.begin(), firstFrame);
+}
+
+std::vector<const Profiler::Track*> Profiler::getTracks()
+{
+	const Registry& registry = getRegistry();
+	return {registry.collected.begin(), registry.collected.end()};
+}
+
+const std::vector<int64_t>& Profiler::getFrameTimes()
+{
+	return getRegistry().frameTimes;
+}
@@ -0,0 +1,487 @@
+#include "Recorder.h"
+
+#include "Profiler.h"
+
+#include <fmt/core.h>
+
+#include <pulse/sample.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace gaz;
+
+namespace
+{
+	// A buffer is handed to the I/O thread once it's been collecting chunks this long, even if it isn't full, so a
+	// slow stream still reaches the disk regularly, and little is lost if we crash
+	constexpr auto maxBufferAge = std::chrono::seconds(1);
+
+	// The I/O thread polls this often on top of being woken, since the writers never take its lock
+	constexpr auto pollInterval = std::chrono::milliseconds(50);
+
+	// Written data is handed to the kernel for writeback in windows of this size, see Recorder::writeFile
+	constexpr uint64_t writebackWindow = 16 << 20;
+
+	// Every buffer holds at least this many of its stream's largest chunks
+	constexpr size_t minChunksPerBuffer = 4;
+};
+
+Recorder::Recorder() :
+	m_path{},
+	m_file{-1},
+	m_settings{},
+	m_header{},
+	m_start{},
+	m_streams{},
+	m_pcmSequence{0},
+	m_ioThread{nullptr},
+	m_ioMutex{},
+	m_ioCondition{},
+	m_closing{false},
+	m_index{},
+	m_failed{false},
+	m_failedChunks{0},
+	m_bytesWritten{0},
+	m_writebackOffset{0},
+	m_cachedOffset{0}
+{
+}
+
+Recorder::~Recorder()
+{
+	close();
+}
+
+bool Recorder::open(const std::string& path, const Recording::FileHeader& header, const Settings& settings)
+{
+	close();
+
+	if (!settings.pcm && !settings.spectra)
+	{
+		fmt::print("Recorder::open: Nothing to record\n");
+		return false;
+	}
+
+	m_file = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (m_file < 0)
+	{
+		fmt::print("Recorder::open: Failed to open '{}', error: {}\n", path, std::strerror(errno));
+		return false;
+	}
+
+	m_path = path;
+	m_settings = settings;
+	m_settings.spectrumInterval = std::max(settings.spectrumInterval, 1u);
+
+	m_header = header;
+	std::memcpy(m_header.magic, Recording::s_magic, sizeof(m_header.magic));
+	m_header.version = Recording::s_version;
+	m_header.headerSize = sizeof(Recording::FileHeader);
+	m_header.streams =
+		(settings.pcm ? Recording::s_pcmStream : 0) | (settings.spectra ? Recording::s_spectrumStream : 0);
+	m_header.startTimeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::system_clock::now().time_since_epoch()
+	).count();
+
+	m_pcmSequence = 0;
+	m_index.clear();
+	m_closing = false;
+	m_failed = false;
+	m_failedChunks = 0;
+	m_bytesWritten = 0;
+	m_writebackOffset = 0;
+	m_cachedOffset = 0;
+
+	// The header's tiny, so write it here, and the file's valid (if empty) from now on
+	if (!writeFile(reinterpret_cast<const char*>(&m_header), sizeof(m_header)))
+	{
+		::close(m_file);
+		m_file = -1;
+		return false;
+	}
+
+	// Size each stream's buffers for its largest chunk, and allocate them all now, so the writers never do
+	const size_t sampleSize = pa_sample_size_of_format(static_cast<pa_sample_format_t>(header.sampleFormat));
+	const size_t pcmSize = size_t(header.framesPerRead) * header.numChannels * sampleSize;
+	const size_t spectrumSize = Recording::spectrumChunkSize(header.numChannels, header.numOutputBins, header.maxBands);
+	const std::array<size_t, NumStreams> maxChunkSizes{
+		sizeof(Recording::ChunkHeader) + Recording::paddedSize(pcmSize),
+		sizeof(Recording::ChunkHeader) + Recording::paddedSize(spectrumSize)
+	};
+	const std::array<bool, NumStreams> enabled{settings.pcm, settings.spectra};
+
+	for (size_t index = 0; index < NumStreams; ++index)
+	{
+		m_streams[index].reset();
+		if (!enabled[index])
+		{
+			continue;
+		}
+
+		const size_t bufferSize = std::max(settings.bufferSize, minChunksPerBuffer * maxChunkSizes[index]);
+		m_streams[index] = std::make_unique<Stream>(std::max<size_t>(settings.numBuffers, 2));
+		m_streams[index]->ring.forEachSlot([bufferSize](Buffer& buffer) { buffer.data.resize(bufferSize); });
+	}
+
+	m_start = std::chrono::steady_clock::now();
+	m_ioThread = std::make_unique<std::thread>(&Recorder::writeBuffers, this);
+
+	fmt::print(
+		"Recorder: Writing{}{} to '{}'\n",
+		settings.pcm ? " PCM" : "",
+		settings.spectra ? fmt::format(" spectra (every {} frame(s))", m_settings.spectrumInterval) : "",
+		path
+	);
+	return true;
+}
+
+void Recorder::close()
+{
+	if (m_file < 0)
+	{
+		return;
+	}
+
+	// The I/O thread drains the rings once more after it sees m_closing, so this is everything
+	flush();
+	m_closing = true;
+	wakeWriter();
+	if (m_ioThread != nullptr && m_ioThread->joinable())
+	{
+		m_ioThread->join();
+	}
+	m_ioThread.reset();
+
+	// Without the index the file's still readable, it just has to be scanned
+	if (!m_failed && m_streams[SpectrumStream] != nullptr && !writeIndex())
+	{
+		fmt::print("Recorder::close: Failed to write the index to '{}'\n", m_path);
+	}
+
+	if (::close(m_file) != 0)
+	{
+		fmt::print("Recorder::close: Failed to close '{}', error: {}\n", m_path, std::strerror(errno));
+	}
+	m_file = -1;
+
+	fmt::print(
+		"Recorder: Wrote {} bytes to '{}', {} chunk(s) dropped\n",
+		getBytesWritten(),
+		m_path,
+		getDroppedChunks()
+	);
+}
+
+void Recorder::writePCM(const char* samples, size_t size)
+{
+	Stream* stream = m_streams[PCMStream].get();
+	if (stream == nullptr)
+	{
+		return;
+	}
+
+	// Dropped reads still use up a sequence number, so the gap shows up in the file
+	char* payload = beginChunk(*stream, Recording::ChunkType::PCM, m_pcmSequence++, size);
+	if (payload == nullptr)
+	{
+		return;
+	}
+
+	std::memcpy(payload, samples, size);
+	endChunk(*stream);
+}
+
+void Recorder::writeSpectrum(const SpectrumFrame& frame)
+{
+	Stream* stream = m_streams[SpectrumStream].get();
+	if (stream == nullptr || frame.sequence % m_settings.spectrumInterval != 0)
+	{
+		return;
+	}
+
+	const uint32_t numChannels = m_header.numChannels;
+	const uint32_t numBins = m_header.numOutputBins;
+	const uint32_t numBands = std::min<uint32_t>(frame.numBands, m_header.maxBands);
+
+	char* payload = beginChunk(
+		*stream,
+		Recording::ChunkType::Spectrum,
+		frame.sequence,
+		Recording::spectrumChunkSize(numChannels, numBins, numBands)
+	);
+	if (payload == nullptr)
+	{
+		return;
+	}
+
+	const Recording::SpectrumChunk chunk{
+		numBands,
+		(frame.onset ? Recording::s_onsetFlag : 0) | (frame.beat ? Recording::s_beatFlag : 0),
+		frame.momentaryLoudness,
+		frame.shortTermLoudness,
+		frame.onsetStrength,
+		frame.tempo,
+		frame.beatPhase,
+		frame.stereoCorrelation,
+		frame.stereoWidth,
+		0.0f
+	};
+	std::memcpy(payload, &chunk, sizeof(chunk));
+	payload += sizeof(chunk);
+
+	const auto append = [&payload](const float* values, size_t count)
+	{
+		std::memcpy(payload, values, count * sizeof(float));
+		payload += count * sizeof(float);
+	};
+	append(frame.spectrum.data(), size_t(numChannels) * numBins);
+	append(frame.bands.data(), size_t(numChannels) * numBands);
+	append(frame.rms.data(), numChannels);
+	append(frame.truePeak.data(), numChannels);
+
+	endChunk(*stream);
+}
+
+void Recorder::flush()
+{
+	for (auto& stream : m_streams)
+	{
+		if (stream != nullptr)
+		{
+			publish(*stream);
+		}
+	}
+}
+
+uint64_t Recorder::getDroppedChunks() const
+{
+	uint64_t dropped = m_failedChunks.load(std::memory_order_relaxed);
+	for (const auto& stream : m_streams)
+	{
+		if (stream != nullptr)
+		{
+			dropped += stream->dropped.load(std::memory_order_relaxed);
+		}
+	}
+	return dropped;
+}
+
+int64_t Recorder::timestamp() const
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count();
+}
+
+char* Recorder::beginChunk(Stream& stream, Recording::ChunkType type, uint64_t sequence, size_t payloadSize)
+{
+	const size_t chunkSize = sizeof(Recording::ChunkHeader) + Recording::paddedSize(payloadSize);
+
+	if (stream.current != nullptr && stream.current->size + chunkSize > stream.current->data.size())
+	{
+		publish(stream);
+	}
+
+	if (stream.current == nullptr)
+	{
+		// Never take the ring's scratch slot, that would quietly throw away a whole buffer of chunks later
+		if (stream.ring.full())
+		{
+			stream.dropped.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		stream.current = stream.ring.beginWrite();
+		stream.current->size = 0;
+		stream.current->numChunks = 0;
+		stream.current->opened = std::chrono::steady_clock::now();
+	}
+
+	// Buffers are sized for the largest chunk in open(), so this only catches a caller writing something bigger
+	if (chunkSize > stream.current->data.size() - stream.current->size)
+	{
+		stream.dropped.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	char* chunk = stream.current->data.data() + stream.current->size;
+	const Recording::ChunkHeader header{type, static_cast<uint32_t>(payloadSize), sequence, timestamp()};
+	std::memcpy(chunk, &header, sizeof(header));
+
+	// Zero the padding, rather than writing whatever the buffer held last time
+	char* payload = chunk + sizeof(header);
+	std::memset(payload + payloadSize, 0, chunkSize - sizeof(header) - payloadSize);
+
+	stream.pendingSize = chunkSize;
+	return payload;
+}
+
+void Recorder::endChunk(Stream& stream)
+{
+	stream.current->size += stream.pendingSize;
+	stream.current->numChunks++;
+	stream.pendingSize = 0;
+
+	if (std::chrono::steady_clock::now() - stream.current->opened >= maxBufferAge)
+	{
+		publish(stream);
+	}
+}
+
+void Recorder::publish(Stream& stream)
+{
+	if (stream.current == nullptr)
+	{
+		return;
+	}
+
+	stream.current = nullptr;
+	stream.ring.endWrite();
+	wakeWriter();
+}
+
+void Recorder::writeBuffers()
+{
+	Profiler::setThreadName("Recorder I/O");
+
+	while (true)
+	{
+		// Read before draining, so everything published before close() set it is written
+		const bool closing = m_closing;
+
+		bool wroteAny = false;
+		for (size_t index = 0; index < NumStreams; ++index)
+		{
+			Stream* stream = m_streams[index].get();
+			if (stream == nullptr)
+			{
+				continue;
+			}
+
+			// Each acquire() hands the previous buffer back to its writer
+			while (const Buffer* buffer = stream->ring.acquire())
+			{
+				GAZ_PROFILE_SCOPE("Recorder::writeBuffer");
+				wroteAny = true;
+
+				const uint64_t offset = getBytesWritten();
+				if (m_failed || !writeFile(buffer->data.data(), buffer->size))
+				{
+					m_failed = true;
+					m_failedChunks.fetch_add(buffer->numChunks, std::memory_order_relaxed);
+				}
+				else if (index == SpectrumStream)
+				{
+					indexBuffer(*buffer, offset);
+				}
+			}
+		}
+
+		if (closing)
+		{
+			break;
+		}
+
+		if (!wroteAny)
+		{
+			std::unique_lock<std::mutex> lock(m_ioMutex);
+			m_ioCondition.wait_for(lock, pollInterval);
+		}
+	}
+}
+
+void Recorder::indexBuffer(const Buffer& buffer, uint64_t offset)
+{
+	size_t position = 0;
+	while (position < buffer.size)
+	{
+		Recording::ChunkHeader header;
+		std::memcpy(&header, &buffer.data[position], sizeof(header));
+		m_index.push_back({header.timestampNs, offset + position});
+
+		position += sizeof(header) + Recording::paddedSize(header.size);
+	}
+}
+
+bool Recorder::writeIndex()
+{
+	const size_t indexSize = m_index.size() * sizeof(Recording::IndexEntry);
+	if (indexSize > UINT32_MAX)
+	{
+		return false;
+	}
+
+	const Recording::ChunkHeader header{
+		Recording::ChunkType::Index,
+		static_cast<uint32_t>(indexSize),
+		0,
+		timestamp()
+	};
+	Recording::Trailer trailer{};
+	std::memcpy(trailer.magic, Recording::s_trailerMagic, sizeof(trailer.magic));
+	trailer.indexOffset = getBytesWritten();
+
+	// The entries are 16 bytes, so the index needs no padding
+	return writeFile(reinterpret_cast<const char*>(&header), sizeof(header)) &&
+		writeFile(reinterpret_cast<const char*>(m_index.data()), indexSize) &&
+		writeFile(reinterpret_cast<const char*>(&trailer), sizeof(trailer));
+}
+
+bool Recorder::writeFile(const char* data, size_t size)
+{
+	while (size > 0)
+	{
+		const ssize_t written = ::write(m_file, data, size);
+		if (written < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			fmt::print("Recorder::writeFile: Failed to write to '{}', error: {}\n", m_path, std::strerror(errno));
+			return false;
+		}
+
+		data += written;
+		size -= static_cast<size_t>(written);
+		m_bytesWritten.fetch_add(static_cast<uint64_t>(written), std::memory_order_relaxed);
+	}
+
+	// Start writing back each full window as soon as we have it, rather than letting dirty pages pile up into a burst,
+	// and once the next window is full, wait for the previous one and drop it from the page cache. Nothing reads it
+	// back, and left alone a multi-hour recording would push everything else out of memory
+	const uint64_t end = m_bytesWritten.load(std::memory_order_relaxed);
+	if (end - m_writebackOffset >= writebackWindow)
+	{
+#if defined(__linux__)
+		sync_file_range(m_file, m_writebackOffset, end - m_writebackOffset, SYNC_FILE_RANGE_WRITE);
+#endif
+		// Careful, a length of 0 means the rest of the file to both of these
+		if (m_writebackOffset > m_cachedOffset)
+		{
+#if defined(__linux__)
+			sync_file_range(
+				m_file,
+				m_cachedOffset,
+				m_writebackOffset - m_cachedOffset,
+				SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER
+			);
+#endif
+			posix_fadvise(m_file, m_cachedOffset, m_writebackOffset - m_cachedOffset, POSIX_FADV_DONTNEED);
+		}
+
+		m_cachedOffset = m_writebackOffset;
+		m_writebackOffset = end;
+	}
+
+	return true;
+}
+
+void Recorder::wakeWriter()
+{
+	m_ioCondition.notify_one();
+}
@@ -0,0 +1,245 @@
+#include "RecordingReader.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace gaz;
+
+RecordingReader::RecordingReader() :
+	m_path{},
+	m_data{nullptr},
+	m_size{0},
+	m_header{},
+	m_index{nullptr},
+	m_numSpectra{0},
+	m_chunksEnd{0},
+	m_scannedIndex{}
+{
+}
+
+RecordingReader::~RecordingReader()
+{
+	close();
+}
+
+bool RecordingReader::open(const std::string& path)
+{
+	close();
+
+	const int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (file < 0)
+	{
+		fmt::print("RecordingReader::open: Failed to open '{}', error: {}\n", path, std::strerror(errno));
+		return false;
+	}
+
+	struct stat status{};
+	if (fstat(file, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(Recording::FileHeader))
+	{
+		fmt::print("RecordingReader::open: '{}' is too short to be a recording\n", path);
+		::close(file);
+		return false;
+	}
+
+	// The mapping keeps its own reference to the file
+	const size_t size = static_cast<size_t>(status.st_size);
+	void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+	::close(file);
+	if (data == MAP_FAILED)
+	{
+		fmt::print("RecordingReader::open: Failed to map '{}', error: {}\n", path, std::strerror(errno));
+		return false;
+	}
+
+	m_path = path;
+	m_data = static_cast<const char*>(data);
+	m_size = size;
+
+	std::memcpy(&m_header, m_data, sizeof(m_header));
+	if (std::memcmp(m_header.magic, Recording::s_magic, sizeof(m_header.magic)) != 0 ||
+		m_header.version != Recording::s_version ||
+		m_header.headerSize < sizeof(Recording::FileHeader) ||
+		m_header.headerSize > m_size ||
+		m_header.headerSize % 8 != 0)
+	{
+		fmt::print("RecordingReader::open: '{}' isn't a version {} recording\n", path, Recording::s_version);
+		close();
+		return false;
+	}
+
+	if (!findIndex())
+	{
+		scanIndex();
+	}
+
+	fmt::print(
+		"RecordingReader: '{}' holds {} spectra over {:.1f}s{}\n",
+		path,
+		m_numSpectra,
+		getDurationNs() * 1e-9,
+		isIndexed() ? "" : ", found by scanning it"
+	);
+	return true;
+}
+
+void RecordingReader::close()
+{
+	if (m_data != nullptr)
+	{
+		munmap(const_cast<char*>(m_data), m_size);
+	}
+
+	m_data = nullptr;
+	m_size = 0;
+	m_index = nullptr;
+	m_numSpectra = 0;
+	m_chunksEnd = 0;
+	m_scannedIndex.clear();
+}
+
+bool RecordingReader::getSpectrum(size_t index, Spectrum& spectrum) const
+{
+	// Everything in the file is 8 byte aligned, and the mapping is page aligned, so the chunks can be used in place.
+	// The index has already checked there's room for the headers
+	const uint64_t offset = m_index[index].offset;
+	const char* chunk = m_data + offset;
+	const auto* header = reinterpret_cast<const Recording::ChunkHeader*>(chunk);
+	const auto* meters = reinterpret_cast<const Recording::SpectrumChunk*>(chunk + sizeof(Recording::ChunkHeader));
+
+	if (header->type != Recording::ChunkType::Spectrum ||
+		meters->numBands > m_header.maxBands ||
+		header->size != Recording::spectrumChunkSize(m_header.numChannels, m_header.numOutputBins, meters->numBands) ||
+		offset + sizeof(Recording::ChunkHeader) + header->size > m_chunksEnd)
+	{
+		return false;
+	}
+
+	const size_t numChannels = m_header.numChannels;
+	const float* values = reinterpret_cast<const float*>(meters + 1);
+	const float* bands = values + numChannels * m_header.numOutputBins;
+	const float* rms = bands + numChannels * meters->numBands;
+
+	spectrum = {header->sequence, header->timestampNs, meters, values, bands, rms, rms + numChannels};
+	return true;
+}
+
+size_t RecordingReader::seek(int64_t timestampNs) const
+{
+	const Recording::IndexEntry* end = m_index + m_numSpectra;
+	const Recording::IndexEntry* found = std::lower_bound(
+		m_index,
+		end,
+		timestampNs,
+		[](const Recording::IndexEntry& entry, int64_t timestamp) { return entry.timestampNs < timestamp; }
+	);
+	return static_cast<size_t>(found - m_index);
+}
+
+bool RecordingReader::findIndex()
+{
+	if (m_size < m_header.headerSize + sizeof(Recording::ChunkHeader) + sizeof(Recording::Trailer))
+	{
+		return false;
+	}
+
+	Recording::Trailer trailer;
+	std::memcpy(&trailer, m_data + m_size - sizeof(trailer), sizeof(trailer));
+	if (std::memcmp(trailer.magic, Recording::s_trailerMagic, sizeof(trailer.magic)) != 0)
+	{
+		return false;
+	}
+
+	const uint64_t indexEnd = m_size - sizeof(trailer);
+	if (trailer.indexOffset < m_header.headerSize ||
+		trailer.indexOffset % 8 != 0 ||
+		trailer.indexOffset + sizeof(Recording::ChunkHeader) > indexEnd)
+	{
+		return false;
+	}
+
+	Recording::ChunkHeader header;
+	std::memcpy(&header, m_data + trailer.indexOffset, sizeof(header));
+	if (header.type != Recording::ChunkType::Index ||
+		trailer.indexOffset + sizeof(header) + header.size != indexEnd ||
+		header.size % sizeof(Recording::IndexEntry) != 0)
+	{
+		return false;
+	}
+
+	const auto* index = reinterpret_cast<const Recording::IndexEntry*>(m_data + trailer.indexOffset + sizeof(header));
+	const size_t numSpectra = header.size / sizeof(Recording::IndexEntry);
+
+	// Only the index itself is checked, checking the chunks it points at would read the whole file
+	const uint64_t minChunkSize = sizeof(Recording::ChunkHeader) + sizeof(Recording::SpectrumChunk);
+	for (size_t i = 0; i < numSpectra; ++i)
+	{
+		if (index[i].offset < m_header.headerSize ||
+			index[i].offset % 8 != 0 ||
+			index[i].offset + minChunkSize > trailer.indexOffset ||
+			(i > 0 && index[i].timestampNs < index[i - 1].timestampNs))
+		{
+			return false;
+		}
+	}
+
+	m_index = index;
+	m_numSpectra = numSpectra;
+	m_chunksEnd = trailer.indexOffset;
+	return true;
+}
+
+void RecordingReader::scanIndex()
+{
+	// Every chunk header is read once, front to back
+	madvise(const_cast<char*>(m_data), m_size, MADV_SEQUENTIAL);
+
+	size_t offset = m_header.headerSize;
+	while (offset + sizeof(Recording::ChunkHeader) <= m_size)
+	{
+		Recording::ChunkHeader header;
+		std::memcpy(&header, m_data + offset, sizeof(header));
+
+		// Stop at a chunk which was cut short, or the index of a file whose trailer didn't make it
+		const size_t next = offset + sizeof(header) + Recording::paddedSize(header.size);
+		if (next > m_size || header.type == Recording::ChunkType::Index)
+		{
+			break;
+		}
+
+		if (header.type == Recording::ChunkType::Spectrum)
+		{
+			Recording::SpectrumChunk meters{};
+			if (header.size >= sizeof(meters))
+			{
+				std::memcpy(&meters, m_data + offset + sizeof(header), sizeof(meters));
+			}
+
+			const size_t expectedSize =
+				Recording::spectrumChunkSize(m_header.numChannels, m_header.numOutputBins, meters.numBands);
+			if (header.size < sizeof(meters) || meters.numBands > m_header.maxBands || header.size != expectedSize)
+			{
+				fmt::print("RecordingReader::scanIndex: Malformed spectrum chunk at {} in '{}'\n", offset, m_path);
+				break;
+			}
+
+			m_scannedIndex.push_back({header.timestampNs, offset});
+		}
+
+		// Anything else is skipped, including chunk types from later versions
+		offset = next;
+	}
+
+	madvise(const_cast<char*>(m_data), m_size, MADV_NORMAL);
+
+	m_index = m_scannedIndex.data();
+	m_numSpectra = m_scannedIndex.size();
+	m_chunksEnd = offset;
+}
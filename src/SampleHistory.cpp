@@ -0,0 +1,130 @@
+#include "SampleHistory.h"
+
+namespace
+{
+	using gaz::SampleHistory;
+	using gaz::FixedSampleHistory;
+	using DSP::SampleFormat;
+
+	template <unsigned int NumChannels, unsigned int WindowSize, SampleFormat Format>
+	struct Configuration
+	{
+		static bool matches(unsigned int numChannels, unsigned int windowSize, SampleFormat format)
+		{
+			return numChannels == NumChannels && windowSize == WindowSize && format == Format;
+		}
+
+		static std::unique_ptr<SampleHistory> create()
+		{
+			return std::make_unique<FixedSampleHistory<NumChannels, WindowSize, Format>>();
+		}
+	};
+
+	// The first of 'Configurations' which matches, or nullptr
+	template <typename Configuration, typename... Rest>
+	std::unique_ptr<SampleHistory> createFixed(unsigned int numChannels, unsigned int windowSize, SampleFormat format)
+	{
+		if (Configuration::matches(numChannels, windowSize, format))
+		{
+			return Configuration::create();
+		}
+
+		if constexpr (sizeof...(Rest) > 0)
+		{
+			return createFixed<Rest...>(numChannels, windowSize, format);
+		}
+		else
+		{
+			return nullptr;
+		}
+	}
+
+	// Mono and stereo, in float and 16 bit, at the DFT sizes we run (linear analysis up to 4096, constant-Q at 16384).
+	// Each one is a separate instantiation of the hot loops, so keep this list to what's actually deployed
+	template <SampleFormat Format>
+	std::unique_ptr<SampleHistory> createDeployed(unsigned int numChannels, unsigned int windowSize)
+	{
+		return createFixed<
+			Configuration<1, 1024, Format>,
+			Configuration<1, 2048, Format>,
+			Configuration<1, 4096, Format>,
+			Configuration<1, 16384, Format>,
+			Configuration<2, 1024, Format>,
+			Configuration<2, 2048, Format>,
+			Configuration<2, 4096, Format>,
+			Configuration<2, 16384, Format>
+		>(numChannels, windowSize, Format);
+	}
+};
+
+using namespace gaz;
+
+std::unique_ptr<SampleHistory> SampleHistory::create(
+	unsigned int numChannels,
+	unsigned int windowSize,
+	DSP::SampleFormat format
+)
+{
+	std::unique_ptr<SampleHistory> history;
+	switch (format)
+	{
+		case SampleFormat::Float32:
+			history = createDeployed<SampleFormat::Float32>(numChannels, windowSize);
+			break;
+		case SampleFormat::S16:
+			history = createDeployed<SampleFormat::S16>(numChannels, windowSize);
+			break;
+		default:
+			break;
+	}
+
+	if (history == nullptr)
+	{
+		history = std::make_unique<DynamicSampleHistory>(numChannels, windowSize, format);
+	}
+
+	return history;
+}
+
+DynamicSampleHistory::DynamicSampleHistory(unsigned int numChannels, unsigned int windowSize, DSP::SampleFormat format) :
+	m_numChannels{numChannels},
+	m_windowSize{windowSize},
+	m_format{format},
+	m_frameSize{numChannels * DSP::bytesPerSample(format)},
+	m_samples(numChannels * windowSize, 0.0f),
+	m_writeIndex{0},
+	m_writePointers(numChannels, nullptr)
+{
+}
+
+void DynamicSampleHistory::push(const char* frames, size_t numFrames)
+{
+	while (numFrames > 0)
+	{
+		// Stop where the rings wrap around
+		const size_t count = std::min<size_t>(numFrames, m_windowSize - m_writeIndex);
+
+		for (unsigned int channel = 0; channel < m_numChannels; ++channel)
+		{
+			m_writePointers[channel] = &m_samples[channel * m_windowSize + m_writeIndex];
+		}
+		DSP::deinterleave(frames, m_format, m_numChannels, count, m_writePointers.data());
+
+		frames += count * m_frameSize;
+		numFrames -= count;
+		m_writeIndex = (m_writeIndex + count) % m_windowSize;
+	}
+}
+
+void DynamicSampleHistory::copyWindow(unsigned int channel, float* out) const
+{
+	const float* samples = &m_samples[channel * m_windowSize];
+	std::copy(samples + m_writeIndex, samples + m_windowSize, out);
+	std::copy(samples, samples + m_writeIndex, out + (m_windowSize - m_writeIndex));
+}
+
+void DynamicSampleHistory::clear()
+{
+	std::fill(m_samples.begin(), m_samples.end(), 0.0f);
+	m_writeIndex = 0;
+}
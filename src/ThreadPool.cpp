@@ -0,0 +1,179 @@
+#include "ThreadPool.h"
+
+#include "Profiler.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+
+using namespace gaz;
+
+namespace
+{
+	uint64_t packRange(uint64_t begin, uint64_t end)
+	{
+		return (end << 32) | begin;
+	}
+};
+
+ThreadPool::ThreadPool(unsigned int numThreads) :
+	m_workers{},
+	m_shares{nullptr},
+	m_task{nullptr},
+	m_context{nullptr},
+	m_remaining{0},
+	m_mutex{},
+	m_wake{},
+	m_generation{0},
+	m_stopping{false}
+{
+	if (numThreads == 0)
+	{
+		numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	m_shares = std::make_unique<Share[]>(numThreads);
+
+	// The calling thread is the last participant, so it doesn't need a thread of its own
+	m_workers.reserve(numThreads - 1);
+	for (unsigned int i = 0; i + 1 < numThreads; ++i)
+	{
+		m_workers.emplace_back(&ThreadPool::workerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+
+	for (auto& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+void ThreadPool::run(size_t count, Task task, void* context)
+{
+	m_task = task;
+	m_context = context;
+	m_remaining.store(count, std::memory_order_relaxed);
+
+	// Even shares, published with release so that a worker which takes an index also sees the task
+	const unsigned int numParticipants = getNumThreads();
+	for (unsigned int i = 0; i < numParticipants; ++i)
+	{
+		const uint64_t begin = count * i / numParticipants;
+		const uint64_t end = count * (i + 1) / numParticipants;
+		m_shares[i].range.store(packRange(begin, end), std::memory_order_release);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_generation;
+	}
+	m_wake.notify_all();
+
+	work(numParticipants - 1);
+
+	// Everything has been taken by now, just wait for whatever is still running on the workers
+	while (m_remaining.load(std::memory_order_acquire) != 0)
+	{
+		std::this_thread::yield();
+	}
+}
+
+void ThreadPool::workerLoop(unsigned int participant)
+{
+	Profiler::setThreadName(fmt::format("Worker {}", participant + 1));
+
+	uint64_t lastGeneration = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [this, lastGeneration] { return m_stopping || m_generation != lastGeneration; });
+
+			if (m_stopping)
+			{
+				return;
+			}
+
+			lastGeneration = m_generation;
+		}
+
+		work(participant);
+	}
+}
+
+void ThreadPool::work(unsigned int participant)
+{
+	const auto execute = [this](size_t index)
+	{
+		m_task(m_context, index);
+		m_remaining.fetch_sub(1, std::memory_order_acq_rel);
+	};
+
+	size_t index = 0;
+	while (takeFront(m_shares[participant], index))
+	{
+		execute(index);
+	}
+
+	// Steal from everyone else, starting with our neighbour so thieves spread out
+	const unsigned int numParticipants = getNumThreads();
+	for (unsigned int i = 1; i < numParticipants; ++i)
+	{
+		Share& victim = m_shares[(participant + i) % numParticipants];
+		while (takeBack(victim, index))
+		{
+			execute(index);
+		}
+	}
+}
+
+bool ThreadPool::takeFront(Share& share, size_t& index)
+{
+	uint64_t range = share.range.load(std::memory_order_acquire);
+	while (true)
+	{
+		const uint64_t begin = range & 0xFFFFFFFFu;
+		const uint64_t end = range >> 32;
+		if (begin >= end)
+		{
+			return false;
+		}
+
+		if (share.range.compare_exchange_weak(
+			range, packRange(begin + 1, end), std::memory_order_acq_rel, std::memory_order_acquire))
+		{
+			index = begin;
+			return true;
+		}
+	}
+}
+
+bool ThreadPool::takeBack(Share& share, size_t& index)
+{
+	uint64_t range = share.range.load(std::memory_order_acquire);
+	while (true)
+	{
+		const uint64_t begin = range & 0xFFFFFFFFu;
+		const uint64_t end = range >> 32;
+		if (begin >= end)
+		{
+			return false;
+		}
+
+		if (share.range.compare_exchange_weak(
+			range, packRange(begin, end - 1), std::memory_order_acq_rel, std::memory_order_acquire))
+		{
+			index = end - 1;
+			return true;
+		}
+	}
+}
@@ -0,0 +1,195 @@
+#include "DSP/Decibels.h"
+#include "DSP/SIMD.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <vector>
+
+// Accuracy of DSP::powerToDecibels on every SIMD path this CPU has, against 10 * log10 in double precision. Each path
+// is run on random spectra, and on the edge cases: zero, denormal and infinite parts, powers below the floor, with
+// and without offsets, for every length up to a few vectors past the widest one, so every tail is covered
+
+namespace
+{
+	// The documented accuracy, for anything above the floor
+	constexpr double maxErrorDb = 1e-4;
+
+	// What powerToDecibels promises: the power is clamped to the smallest normal float (or the floor without
+	// offsets), so the log never sees zero or a denormal, and infinities saturate at the top of the float range
+	double referenceDecibels(float re, float im, float floorDb, const float* offsetsDb, size_t bin)
+	{
+		double power = static_cast<double>(re) * re + static_cast<double>(im) * im;
+		power = std::min(std::max(power, static_cast<double>(FLT_MIN)), static_cast<double>(FLT_MAX));
+		if (offsetsDb == nullptr)
+		{
+			power = std::max(power, std::pow(10.0, floorDb / 10.0));
+		}
+
+		const double decibels = 10.0 * std::log10(power) + (offsetsDb != nullptr ? offsetsDb[bin] : 0.0);
+		return std::max(decibels, static_cast<double>(floorDb));
+	}
+
+	struct Case
+	{
+		const char* name;
+		std::vector<float> complexIn;
+	};
+
+	std::vector<Case> makeCases(size_t maxCount)
+	{
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> mantissa(-1.0f, 1.0f);
+		std::uniform_int_distribution<int> exponent(-70, 60);
+
+		std::vector<Case> cases;
+
+		// Spread over most of the float range, like a spectrum's quiet and loud bins
+		Case spread{"random", std::vector<float>(2 * maxCount)};
+		for (float& value : spread.complexIn)
+		{
+			value = std::ldexp(mantissa(random), exponent(random));
+		}
+		cases.push_back(spread);
+
+		// Around full scale, where the polynomial's error matters most
+		Case fullScale{"full scale", std::vector<float>(2 * maxCount)};
+		for (float& value : fullScale.complexIn)
+		{
+			value = mantissa(random) * 4096.0f;
+		}
+		cases.push_back(fullScale);
+
+		const float denormal = std::numeric_limits<float>::denorm_min() * 1000.0f;
+		const float infinity = std::numeric_limits<float>::infinity();
+		const std::vector<float> edges = {
+			0.0f, -0.0f, denormal, -denormal, FLT_MIN, 1e-30f, 1e-7f, 1.0f, 1e19f, FLT_MAX, infinity, -infinity
+		};
+
+		Case edge{"edges", std::vector<float>(2 * maxCount)};
+		for (size_t i = 0; i < edge.complexIn.size(); ++i)
+		{
+			// Every pairing of edges, in every lane
+			edge.complexIn[i] = edges[(i % 2 == 0 ? i / 2 : i / (2 * edges.size()) + i) % edges.size()];
+		}
+		cases.push_back(edge);
+
+		Case zeros{"zeros", std::vector<float>(2 * maxCount, 0.0f)};
+		cases.push_back(zeros);
+
+		Case denormals{"denormals", std::vector<float>(2 * maxCount, denormal)};
+		cases.push_back(denormals);
+
+		return cases;
+	}
+
+	// The largest error of 'level' over every case, length, floor and offsets
+	double measure(DSP::SIMDLevel level, const std::vector<Case>& cases, size_t maxCount)
+	{
+		std::mt19937 random(5678);
+		std::uniform_real_distribution<float> offset(-140.0f, 20.0f);
+		std::vector<float> offsetsDb(maxCount);
+		for (float& value : offsetsDb)
+		{
+			value = offset(random);
+		}
+
+		// An everyday floor, one below the smallest normal float's -376 dB, and one above most of the values
+		const float floors[] = {-120.0f, -400.0f, 10.0f};
+
+		double maxError = 0.0;
+		std::vector<float> out(maxCount + 1);
+		for (const Case& testCase : cases)
+		{
+			for (const float floorDb : floors)
+			{
+				const float* noOffsets = nullptr;
+				for (const float* offsets : {noOffsets, static_cast<const float*>(offsetsDb.data())})
+				{
+					for (size_t count = 0; count <= maxCount; ++count)
+					{
+						// One past the end, to catch a tail which writes too far
+						const float guard = -12345.0f;
+						out[count] = guard;
+
+						DSP::powerToDecibels(level, testCase.complexIn.data(), count, floorDb, offsets, out.data());
+
+						if (out[count] != guard)
+						{
+							fmt::print(
+								"FAIL {}: {} wrote past {} bins ({})\n",
+								DSP::toString(level),
+								testCase.name,
+								count,
+								offsets != nullptr ? "offsets" : "no offsets"
+							);
+							return std::numeric_limits<double>::infinity();
+						}
+
+						for (size_t bin = 0; bin < count; ++bin)
+						{
+							const float re = testCase.complexIn[2 * bin];
+							const float im = testCase.complexIn[2 * bin + 1];
+							const double expected = referenceDecibels(re, im, floorDb, offsets, bin);
+							const double error = std::abs(out[bin] - expected);
+							if (!(error <= maxErrorDb))
+							{
+								fmt::print(
+									"FAIL {}: {} bin {} of {}, ({}, {}), floor {} dB{}: got {} dB, expected {} dB\n",
+									DSP::toString(level),
+									testCase.name,
+									bin,
+									count,
+									re,
+									im,
+									floorDb,
+									offsets != nullptr ? fmt::format(", offset {} dB", offsets[bin]) : "",
+									out[bin],
+									expected
+								);
+							}
+							maxError = std::max(maxError, std::isnan(error) ? INFINITY : error);
+						}
+					}
+				}
+			}
+		}
+		return maxError;
+	}
+};
+
+int main()
+{
+	// Three of the widest vectors (16 bins) and then some, so every path runs its main loop and every tail length
+	constexpr size_t maxCount = 3 * 16 + 15;
+	const std::vector<Case> cases = makeCases(maxCount);
+
+	bool passed = true;
+	const DSP::SIMDLevel widest = DSP::getSIMDLevel();
+	for (int level = 0; level <= static_cast<int>(DSP::SIMDLevel::AVX512); ++level)
+	{
+		const auto simdLevel = static_cast<DSP::SIMDLevel>(level);
+		if (simdLevel > widest)
+		{
+			fmt::print("{:<8} skipped, not supported by this CPU\n", DSP::toString(simdLevel));
+			continue;
+		}
+
+		const double maxError = measure(simdLevel, cases, maxCount);
+		const bool levelPassed = maxError <= maxErrorDb;
+		fmt::print(
+			"{:<8} max error {:.3g} dB, {}\n",
+			DSP::toString(simdLevel),
+			maxError,
+			levelPassed ? "ok" : "FAILED"
+		);
+		passed = passed && levelPassed;
+	}
+
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,427 @@
+#include "AudioEngine.h"
+#include "AudioSources/FileAudioSource.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <limits>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Headless offline analysis: runs WAV files through the engine's analysis as fast as the CPU allows, with no SDL,
+// OpenGL or ImGui. Writes a row of summary features per file to <out>/summary.csv, and optionally each file's spectra
+// as a recording (see RecordingFormat.h), which GLAudioVisApp can --replay.
+//
+//  gaz_analyse [--out=<dir>] [--spectra[=<n>]] [--jobs=<n>] [--cqt] [--samples=<n>] [--hop=<n>] <wav | dir>...
+//
+// Files are analysed in parallel, one per job, and each file's channels are shared between the threads left over
+
+namespace
+{
+	struct Options
+	{
+		std::filesystem::path outputDirectory = ".";
+		bool spectra = false;
+		unsigned int spectrumInterval = 1; // keep every n'th spectrum
+		unsigned int numJobs = 0; // files analysed at once, 0 uses the hardware concurrency
+		gaz::AudioEngine::Analysis analysis = gaz::AudioEngine::Analysis::Linear;
+		unsigned int numSamples = 0; // DFT window, 0 uses GLAudioVisApp's for the analysis
+		unsigned int hopSize = 0; // 0 uses GLAudioVisApp's for the analysis
+	};
+
+	// What's kept from each of a file's frames
+	struct Summary
+	{
+		bool ok = false;
+		unsigned int numChannels = 0;
+		unsigned int sampleRate = 0;
+		uint64_t numFrames = 0;
+		double audioSeconds = 0.0;
+		double analysisSeconds = 0.0;
+
+		float maxMomentaryLoudness = std::numeric_limits<float>::lowest();
+		float maxShortTermLoudness = std::numeric_limits<float>::lowest();
+		float maxRMS = std::numeric_limits<float>::lowest();
+		float maxTruePeak = std::numeric_limits<float>::lowest();
+
+		// Over every channel of every frame
+		double centroidSum = 0.0;
+		double bandwidthSum = 0.0;
+		double rolloffSum = 0.0;
+		double flatnessSum = 0.0;
+
+		uint64_t numOnsets = 0;
+		float tempo = 0.0f; // the final estimate
+		double correlationSum = 0.0;
+	};
+
+	void accumulate(Summary& summary, const gaz::SpectrumFrame& frame)
+	{
+		summary.numFrames++;
+		summary.maxMomentaryLoudness = std::max(summary.maxMomentaryLoudness, frame.momentaryLoudness);
+		summary.maxShortTermLoudness = std::max(summary.maxShortTermLoudness, frame.shortTermLoudness);
+
+		for (size_t channel = 0; channel < frame.rms.size(); ++channel)
+		{
+			summary.maxRMS = std::max(summary.maxRMS, frame.rms[channel]);
+			summary.maxTruePeak = std::max(summary.maxTruePeak, frame.truePeak[channel]);
+		}
+
+		for (const DSP::SpectralDescriptors& descriptors : frame.descriptors)
+		{
+			summary.centroidSum += descriptors.centroid;
+			summary.bandwidthSum += descriptors.bandwidth;
+			summary.rolloffSum += descriptors.rolloff;
+			summary.flatnessSum += descriptors.flatness;
+		}
+
+		summary.numOnsets += frame.onset ? 1 : 0;
+		summary.tempo = frame.tempo;
+		summary.correlationSum += frame.stereoCorrelation;
+	}
+
+	std::string toLower(std::string text)
+	{
+		std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c)
+		{
+			return static_cast<char>(std::tolower(c));
+		});
+		return text;
+	}
+
+	// Where each input's spectra go: <out>/<stem>.gaz, with -2, -3... added to any stem already taken, so files of
+	// the same name in different directories (or the same file given twice) never share, or race on, a recording.
+	// Compared without case, for the file systems which ignore it
+	std::vector<std::filesystem::path> recordingPaths(
+		const std::vector<std::filesystem::path>& inputs,
+		const std::filesystem::path& outputDirectory)
+	{
+		std::vector<std::filesystem::path> paths;
+		std::set<std::string> taken;
+		for (const std::filesystem::path& input : inputs)
+		{
+			const std::string stem = input.stem().string();
+			std::string name = stem;
+			for (unsigned int n = 2; !taken.insert(toLower(name)).second; ++n)
+			{
+				name = fmt::format("{}-{}", stem, n);
+			}
+			paths.push_back(outputDirectory / (name + ".gaz"));
+		}
+		return paths;
+	}
+
+	// A CSV field, quoted, with any quotes in it doubled
+	std::string csvField(const std::string& text)
+	{
+		std::string field = "\"";
+		for (const char c : text)
+		{
+			field += c == '"' ? "\"\"" : std::string(1, c);
+		}
+		return field + "\"";
+	}
+
+	// 'recordingPath' is where to write the spectra, if they're wanted
+	Summary analyseFile(
+		const std::filesystem::path& path,
+		const std::filesystem::path& recordingPath,
+		const Options& options,
+		unsigned int numWorkerThreads)
+	{
+		Summary summary;
+
+		const auto sampleSpec = gaz::FileAudioSource::probe(path.string());
+		if (!sampleSpec.has_value())
+		{
+			fmt::print("gaz_analyse: '{}' isn't a WAV file we can read\n", path.string());
+			return summary;
+		}
+
+		// The same windows as GLAudioVisApp, so the results match what it shows
+		const bool constantQ = options.analysis == gaz::AudioEngine::Analysis::ConstantQ;
+		const unsigned int numSamples = options.numSamples != 0 ? options.numSamples : (constantQ ? 16384 : 1024);
+		const unsigned int hopSize = options.hopSize != 0 ? options.hopSize : (constantQ ? 1024 : 0);
+
+		gaz::AudioEngine engine(
+			gaz::AudioEngine::SamplingSettings{
+				sampleSpec->channels,
+				sampleSpec->rate,
+				numSamples,
+				sampleSpec->format,
+				hopSize,
+				0, // framesPerRead, a window at a time
+				false, // upgradePlanInBackground, nothing's waiting on init(), so plan properly up front
+				options.analysis,
+				24, // binsPerOctave
+				32.70f, // minFrequency
+				numWorkerThreads
+			},
+			std::make_unique<gaz::FileAudioSource>(path.string(), false, false)
+		);
+		if (!engine.init())
+		{
+			fmt::print("gaz_analyse: Failed to set up the analysis of '{}'\n", path.string());
+			return summary;
+		}
+
+		if (options.spectra)
+		{
+			gaz::Recorder::Settings settings;
+			settings.pcm = false;
+			settings.spectrumInterval = options.spectrumInterval;
+
+			if (!engine.openRecorder(recordingPath.string(), settings))
+			{
+				return summary;
+			}
+		}
+
+		const auto start = std::chrono::steady_clock::now();
+		engine.analyseOffline([&summary](const gaz::SpectrumFrame& frame) { accumulate(summary, frame); });
+		summary.analysisSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		// Finish the recording before we say we're done with the file
+		engine.closeRecorder();
+
+		summary.ok = true;
+		summary.numChannels = sampleSpec->channels;
+		summary.sampleRate = sampleSpec->rate;
+		summary.audioSeconds =
+			static_cast<double>(summary.numFrames) * engine.getSamplingSettings().getHopSize() / sampleSpec->rate;
+		return summary;
+	}
+
+	// Files as given, and the WAV files directly inside any directories, in name order
+	std::vector<std::filesystem::path> findInputs(const std::vector<std::string>& arguments)
+	{
+		std::vector<std::filesystem::path> inputs;
+		for (const std::string& argument : arguments)
+		{
+			std::error_code error;
+			if (!std::filesystem::is_directory(argument, error))
+			{
+				inputs.emplace_back(argument);
+				continue;
+			}
+
+			std::vector<std::filesystem::path> files;
+			for (const auto& entry : std::filesystem::directory_iterator(argument, error))
+			{
+				if (entry.is_regular_file() && toLower(entry.path().extension().string()) == ".wav")
+				{
+					files.push_back(entry.path());
+				}
+			}
+
+			std::sort(files.begin(), files.end());
+			inputs.insert(inputs.end(), files.begin(), files.end());
+		}
+		return inputs;
+	}
+
+	bool writeSummaries(
+		const std::filesystem::path& path,
+		const std::vector<std::filesystem::path>& inputs,
+		const std::vector<std::filesystem::path>& recordings,
+		const std::vector<Summary>& summaries)
+	{
+		std::FILE* file = std::fopen(path.string().c_str(), "w");
+		if (file == nullptr)
+		{
+			fmt::print("gaz_analyse: Failed to create '{}'\n", path.string());
+			return false;
+		}
+
+		fmt::print(
+			file,
+			"file,channels,sample_rate,seconds,frames,max_momentary_lufs,max_short_term_lufs,max_rms_dbfs,"
+			"max_true_peak_dbtp,mean_centroid_hz,mean_bandwidth_hz,mean_rolloff_hz,mean_flatness,onsets,tempo_bpm,"
+			"mean_stereo_correlation,analysis_seconds,frames_per_second,spectra\n"
+		);
+
+		for (size_t i = 0; i < inputs.size(); ++i)
+		{
+			const Summary& summary = summaries[i];
+			if (!summary.ok || summary.numFrames == 0)
+			{
+				continue;
+			}
+
+			const double numFrames = static_cast<double>(summary.numFrames);
+			const double numDescriptors = numFrames * summary.numChannels;
+			fmt::print(
+				file,
+				"{},{},{},{:.3f},{},{:.2f},{:.2f},{:.2f},{:.2f},{:.1f},{:.1f},{:.1f},{:.4f},{},{:.1f},{:.3f},"
+				"{:.3f},{:.0f},{}\n",
+				csvField(inputs[i].string()),
+				summary.numChannels,
+				summary.sampleRate,
+				summary.audioSeconds,
+				summary.numFrames,
+				summary.maxMomentaryLoudness,
+				summary.maxShortTermLoudness,
+				summary.maxRMS,
+				summary.maxTruePeak,
+				summary.centroidSum / numDescriptors,
+				summary.bandwidthSum / numDescriptors,
+				summary.rolloffSum / numDescriptors,
+				summary.flatnessSum / numDescriptors,
+				summary.numOnsets,
+				summary.tempo,
+				summary.correlationSum / numFrames,
+				summary.analysisSeconds,
+				numFrames / std::max(summary.analysisSeconds, 1e-9),
+				recordings.empty() ? "" : csvField(recordings[i].filename().string())
+			);
+		}
+
+		std::fclose(file);
+		return true;
+	}
+};
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	std::vector<std::string> arguments;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string argument = argv[i];
+		if (argument.rfind("--out=", 0) == 0)
+		{
+			options.outputDirectory = argument.substr(6);
+		}
+		else if (argument == "--spectra")
+		{
+			options.spectra = true;
+		}
+		else if (argument.rfind("--spectra=", 0) == 0)
+		{
+			options.spectra = true;
+			options.spectrumInterval = std::max(1ul, std::strtoul(argument.c_str() + 10, nullptr, 10));
+		}
+		else if (argument.rfind("--jobs=", 0) == 0)
+		{
+			options.numJobs = static_cast<unsigned int>(std::strtoul(argument.c_str() + 7, nullptr, 10));
+		}
+		else if (argument == "--cqt")
+		{
+			options.analysis = gaz::AudioEngine::Analysis::ConstantQ;
+		}
+		else if (argument.rfind("--samples=", 0) == 0)
+		{
+			options.numSamples = static_cast<unsigned int>(std::strtoul(argument.c_str() + 10, nullptr, 10));
+		}
+		else if (argument.rfind("--hop=", 0) == 0)
+		{
+			options.hopSize = static_cast<unsigned int>(std::strtoul(argument.c_str() + 6, nullptr, 10));
+		}
+		else if (argument.rfind("--", 0) == 0)
+		{
+			fmt::print("gaz_analyse: Unknown option '{}'\n", argument);
+			return EXIT_FAILURE;
+		}
+		else
+		{
+			arguments.push_back(argument);
+		}
+	}
+
+	const std::vector<std::filesystem::path> inputs = findInputs(arguments);
+	if (inputs.empty())
+	{
+		fmt::print(
+			"Usage: gaz_analyse [--out=<dir>] [--spectra[=<n>]] [--jobs=<n>] [--cqt] [--samples=<n>] [--hop=<n>] "
+			"<wav | dir>...\n"
+		);
+		return EXIT_FAILURE;
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(options.outputDirectory, error);
+
+	// Whole files in parallel scale best, since they share nothing. Only when there are fewer files than cores are
+	// each file's channels spread over the rest
+	const unsigned int numCores = std::max(std::thread::hardware_concurrency(), 1u);
+	const unsigned int numJobs = static_cast<unsigned int>(
+		std::min<size_t>(options.numJobs != 0 ? options.numJobs : numCores, inputs.size())
+	);
+	const unsigned int numWorkerThreads = std::max(numCores / numJobs, 1u);
+
+	// Named up front, as the jobs would race to claim a name
+	const std::vector<std::filesystem::path> recordings =
+		options.spectra ? recordingPaths(inputs, options.outputDirectory) : std::vector<std::filesystem::path>{};
+
+	std::vector<Summary> summaries(inputs.size());
+	std::atomic<size_t> nextInput{0};
+
+	const auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> jobs;
+	for (unsigned int job = 0; job < numJobs; ++job)
+	{
+		jobs.emplace_back([&]
+		{
+			for (size_t i = nextInput++; i < inputs.size(); i = nextInput++)
+			{
+				summaries[i] = analyseFile(
+					inputs[i],
+					recordings.empty() ? std::filesystem::path{} : recordings[i],
+					options,
+					numWorkerThreads
+				);
+			}
+		});
+	}
+	for (auto& job : jobs)
+	{
+		job.join();
+	}
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	uint64_t totalFrames = 0;
+	double totalAudioSeconds = 0.0;
+	size_t numFailed = 0;
+	for (size_t i = 0; i < inputs.size(); ++i)
+	{
+		const Summary& summary = summaries[i];
+		if (!summary.ok)
+		{
+			numFailed++;
+			continue;
+		}
+
+		totalFrames += summary.numFrames;
+		totalAudioSeconds += summary.audioSeconds;
+		fmt::print(
+			"{}: {} frames in {:.2f}s, {:.0f} frames/s, {:.1f}x real time\n",
+			inputs[i].string(),
+			summary.numFrames,
+			summary.analysisSeconds,
+			summary.numFrames / std::max(summary.analysisSeconds, 1e-9),
+			summary.audioSeconds / std::max(summary.analysisSeconds, 1e-9)
+		);
+	}
+
+	fmt::print(
+		"gaz_analyse: {} file(s), {} job(s) x {} thread(s): {} frames in {:.2f}s, {:.0f} frames/s, {:.1f}x real time\n",
+		inputs.size() - numFailed,
+		numJobs,
+		numWorkerThreads,
+		totalFrames,
+		seconds,
+		totalFrames / std::max(seconds, 1e-9),
+		totalAudioSeconds / std::max(seconds, 1e-9)
+	);
+
+	const bool written = writeSummaries(options.outputDirectory / "summary.csv", inputs, recordings, summaries);
+	return written && numFailed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,552 @@
+#include "AudioEngine.h"
+#include "SPSCRing.h"
+#include "SampleHistory.h"
+#include "SpectrumFrame.h"
+#include "DSP/Decibels.h"
+#include "DSP/Deinterleave.h"
+#include "DSP/FFTBatch.h"
+#include "DSP/SIMD.h"
+#include "DSP/Smoothing.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <limits>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Microbenchmarks of each stage of the engine's hot path, in isolation, across DFT sizes, channel counts and sample
+// formats, so a change to the analysis can be compared before and after:
+//
+//  gaz_bench [--stages=<a,b,..>] [--sizes=<n,..>] [--channels=<n,..>] [--formats=<f,..>] [--time=<s>] [--patient]
+//            [--json=<path>]
+//
+// Every stage processes one window of 'size' frames per iteration, so the costs add up to the cost of a frame (less
+// the meters, bands and rhythm). Throughput is in input samples per second, and the cost per output bin is over
+// every channel's size / 2 + 1 bins, both from the fastest batch of iterations. --json writes the results for a
+// script to compare, '-' for stdout. The DFT is measured with FFTW_MEASURE plans, or with the engine's patient ones
+// if they're cached: --patient makes any that aren't, which can take minutes per size and channel count
+
+namespace
+{
+	enum struct Stage
+	{
+		Deinterleave, // convert and deinterleave a window of PCM into the sample history
+		Window, // copy each channel's window out of the history into the DFT input
+		FFT, // the batched DFT
+		Decibels, // power to dB, at each SIMD level the CPU supports
+		Frame, // smooth the dB plane into the frame's other planes, each holding every channel
+		Publish, // fill a frame's spectrum plane, publish it through the ring, and read it back as the renderer would
+		NumStages
+	};
+
+	const char* toString(Stage stage)
+	{
+		switch (stage)
+		{
+			case Stage::Deinterleave: return "deinterleave";
+			case Stage::Window: return "window";
+			case Stage::FFT: return "fft";
+			case Stage::Decibels: return "decibels";
+			case Stage::Frame: return "frame";
+			case Stage::Publish: return "publish";
+			default: return "unknown";
+		}
+	}
+
+	const char* toString(DSP::SampleFormat format)
+	{
+		switch (format)
+		{
+			case DSP::SampleFormat::Float32: return "f32";
+			case DSP::SampleFormat::S16: return "s16";
+			case DSP::SampleFormat::S24: return "s24";
+			case DSP::SampleFormat::S24In32: return "s24in32";
+			case DSP::SampleFormat::S32: return "s32";
+			default: return "unknown";
+		}
+	}
+
+	struct Options
+	{
+		std::vector<Stage> stages{
+			Stage::Deinterleave, Stage::Window, Stage::FFT, Stage::Decibels, Stage::Frame, Stage::Publish
+		};
+		std::vector<unsigned int> sizes{256, 512, 1024, 2048, 4096, 8192, 16384, 32768, 65536};
+		std::vector<unsigned int> channels{1, 2, 6};
+		std::vector<DSP::SampleFormat> formats{
+			DSP::SampleFormat::Float32,
+			DSP::SampleFormat::S16,
+			DSP::SampleFormat::S24,
+			DSP::SampleFormat::S24In32,
+			DSP::SampleFormat::S32
+		};
+		double seconds = 0.1; // spent measuring each configuration
+		bool patient = false; // plan every DFT as the engine does, rather than only using the cached patient plans
+		std::string jsonPath;
+	};
+
+	struct Result
+	{
+		Stage stage;
+		unsigned int size;
+		unsigned int numChannels;
+		std::string variant; // the sample format, SIMD level or the like, whatever else the stage depends on
+		uint64_t iterations; // timed, over every batch, not counting those which found the batch size
+		uint64_t batchIterations;
+		double nsPerIteration; // in the fastest batch
+		double samplesPerSecond;
+		double nsPerBin;
+	};
+
+	// Somewhere for results to go, so the work that makes them isn't optimised away
+	volatile float g_sink = 0.0f;
+
+	// Time 'iteration', in batches long enough for the clock, keeping the fastest batch, which is the one least
+	// disturbed by everything else on the machine
+	Result measure(
+		Stage stage,
+		unsigned int size,
+		unsigned int numChannels,
+		std::string variant,
+		double seconds,
+		const std::function<void()>& iteration)
+	{
+		using Clock = std::chrono::steady_clock;
+		constexpr unsigned int numBatches = 5;
+
+		const auto runBatch = [&iteration](uint64_t count)
+		{
+			const auto start = Clock::now();
+			for (uint64_t i = 0; i < count; ++i)
+			{
+				iteration();
+			}
+			return std::chrono::duration<double>(Clock::now() - start).count();
+		};
+
+		// Warm the caches and the branch predictors, then grow the batch until it fills its share of the time
+		const double batchSeconds = seconds / numBatches;
+		uint64_t count = 1;
+		for (double elapsed = runBatch(count); elapsed < batchSeconds && count < (uint64_t(1) << 40); )
+		{
+			const double scale = elapsed > 0.0 ? std::min(batchSeconds / elapsed * 1.2, 10.0) : 10.0;
+			count = std::max<uint64_t>(count + 1, static_cast<uint64_t>(count * scale));
+			elapsed = runBatch(count);
+		}
+
+		double best = std::numeric_limits<double>::max();
+		for (unsigned int batch = 0; batch < numBatches; ++batch)
+		{
+			best = std::min(best, runBatch(count));
+		}
+
+		const double nsPerIteration = best * 1e9 / count;
+		const double numBins = static_cast<double>(numChannels) * (size / 2 + 1);
+		return {
+			stage,
+			size,
+			numChannels,
+			std::move(variant),
+			count * numBatches,
+			count,
+			nsPerIteration,
+			static_cast<double>(size) * numChannels / (nsPerIteration * 1e-9),
+			nsPerIteration / numBins
+		};
+	}
+
+	// Noise at a realistic level, so the conversions and the log see the values they would
+	std::vector<float> makeSignal(size_t count)
+	{
+		std::mt19937 generator{1234};
+		std::uniform_real_distribution<float> distribution{-0.5f, 0.5f};
+
+		std::vector<float> signal(count);
+		for (float& sample : signal)
+		{
+			sample = distribution(generator);
+		}
+		return signal;
+	}
+
+	void benchDeinterleave(const Options& options, unsigned int size, unsigned int numChannels,
+		std::vector<Result>& results)
+	{
+		const std::vector<float> signal = makeSignal(size_t(size) * numChannels);
+		for (DSP::SampleFormat format : options.formats)
+		{
+			std::vector<char> pcm(signal.size() * DSP::bytesPerSample(format));
+			DSP::encodeSamples(signal.data(), format, signal.size(), pcm.data());
+
+			// The history the engine would pick, specialised for the deployed configurations
+			const auto history = gaz::SampleHistory::create(numChannels, size, format);
+			const std::string variant =
+				fmt::format("{}/{}", toString(format), history->isSpecialised() ? "fixed" : "dynamic");
+
+			results.push_back(measure(Stage::Deinterleave, size, numChannels, variant, options.seconds, [&]
+			{
+				history->push(pcm.data(), size);
+			}));
+		}
+	}
+
+	void benchWindow(const Options& options, unsigned int size, unsigned int numChannels, std::vector<Result>& results)
+	{
+		const auto history = gaz::SampleHistory::create(numChannels, size, DSP::SampleFormat::Float32);
+		const std::vector<float> signal = makeSignal(size_t(size) * numChannels);
+
+		// Start part way round the rings, as the engine usually is, so each copy is in two parts
+		history->push(reinterpret_cast<const char*>(signal.data()), size / 3);
+
+		std::vector<float> windows(size_t(size) * numChannels);
+		results.push_back(measure(Stage::Window, size, numChannels, "f32", options.seconds, [&]
+		{
+			for (unsigned int channel = 0; channel < numChannels; ++channel)
+			{
+				history->copyWindow(channel, &windows[size_t(size) * channel]);
+			}
+		}));
+	}
+
+	void benchFFT(const Options& options, unsigned int size, unsigned int numChannels, std::vector<Result>& results)
+	{
+		// The patient plan the engine ends up with if it's cached, otherwise a measured one, unless asked to be patient
+		DSP::FFTBatch fft(
+			size,
+			numChannels,
+			options.patient ? DSP::FFTBatch::Planning::Patient : DSP::FFTBatch::Planning::Measure
+		);
+		if (!fft.isValid())
+		{
+			fmt::print("gaz_bench: Failed to plan a {} point DFT of {} channel(s)\n", size, numChannels);
+			return;
+		}
+
+		// The DFT destroys its input, but the values it's left with are as good as any
+		const std::vector<float> signal = makeSignal(size);
+		for (unsigned int channel = 0; channel < numChannels; ++channel)
+		{
+			std::copy(signal.begin(), signal.end(), fft.getInput(channel));
+		}
+
+		const char* variant = fft.isOptimal() ? "patient" : "measure";
+		results.push_back(measure(Stage::FFT, size, numChannels, variant, options.seconds, [&]
+		{
+			fft.execute();
+		}));
+	}
+
+	void benchDecibels(const Options& options, unsigned int size, unsigned int numChannels,
+		std::vector<Result>& results)
+	{
+		const unsigned int numBins = size / 2 + 1;
+		const std::vector<float> complex = makeSignal(size_t(2) * numBins * numChannels);
+		const std::vector<float> offsets(numBins, 0.0f);
+		std::vector<float> decibels(size_t(numBins) * numChannels);
+
+		for (int level = 0; level <= static_cast<int>(DSP::getSIMDLevel()); ++level)
+		{
+			const auto simdLevel = static_cast<DSP::SIMDLevel>(level);
+			results.push_back(measure(Stage::Decibels, size, numChannels, DSP::toString(simdLevel), options.seconds, [&]
+			{
+				for (unsigned int channel = 0; channel < numChannels; ++channel)
+				{
+					DSP::powerToDecibels(
+						simdLevel,
+						&complex[size_t(2) * numBins * channel],
+						numBins,
+						-120.0f,
+						offsets.data(),
+						&decibels[size_t(numBins) * channel]
+					);
+				}
+				g_sink = decibels[0];
+			}));
+		}
+	}
+
+	void benchFrame(const Options& options, unsigned int size, unsigned int numChannels, std::vector<Result>& results)
+	{
+		const size_t numBins = size / 2 + 1;
+		const size_t planeSize = numBins * numChannels;
+
+		// Levels which move around from frame to frame, so both attack and release are taken
+		std::vector<float> decibels = makeSignal(planeSize);
+		for (float& level : decibels)
+		{
+			level = -60.0f + 100.0f * level;
+		}
+
+		gaz::SpectrumFrame frame;
+		frame.spectrum = decibels;
+		frame.smoothedSpectrum.resize(planeSize);
+		frame.peakSpectrum.resize(planeSize);
+		frame.averageSpectrum.resize(planeSize);
+
+		std::vector<float> state(3 * planeSize);
+		const DSP::SmoothingCoefficients coefficients{0.5f, 0.1f, 0.2f, 0.01f};
+
+		results.push_back(measure(Stage::Frame, size, numChannels, "f32", options.seconds, [&]
+		{
+			for (unsigned int channel = 0; channel < numChannels; ++channel)
+			{
+				const size_t offset = numBins * channel;
+				DSP::smoothSpectrum(
+					&frame.spectrum[offset],
+					numBins,
+					coefficients,
+					{&state[offset], &state[planeSize + offset], &state[2 * planeSize + offset]},
+					{&frame.smoothedSpectrum[offset], &frame.peakSpectrum[offset], &frame.averageSpectrum[offset]}
+				);
+			}
+		}));
+	}
+
+	void benchPublish(const Options& options, unsigned int size, unsigned int numChannels,
+		std::vector<Result>& results)
+	{
+		const size_t planeSize = size_t(size / 2 + 1) * numChannels;
+		const std::vector<float> decibels = makeSignal(planeSize);
+
+		// The engine's ring, so the frames cycle through the same number of slots and caches as they do there
+		gaz::SPSCRing<gaz::SpectrumFrame> ring{gaz::AudioEngine::s_frameRingCapacity};
+		ring.forEachSlot([planeSize](gaz::SpectrumFrame& frame) { frame.spectrum.resize(planeSize); });
+
+		uint64_t sequence = 0;
+		results.push_back(measure(Stage::Publish, size, numChannels, "f32", options.seconds, [&]
+		{
+			gaz::SpectrumFrame* frame = ring.beginWrite();
+			frame->sequence = sequence++;
+			std::copy(decibels.begin(), decibels.end(), frame->spectrum.begin());
+			ring.endWrite();
+
+			// The renderer reads the whole plane to upload it
+			const gaz::SpectrumFrame* published = ring.acquire();
+			float sum = 0.0f;
+			for (float level : published->spectrum)
+			{
+				sum += level;
+			}
+			g_sink = sum;
+		}));
+	}
+
+	void printResult(std::FILE* file, const Result& result)
+	{
+		fmt::print(
+			file,
+			"{:<13} {:>6} {:>3}ch {:<16} {:>12.0f} ns {:>10.1f} Msamples/s {:>8.3f} ns/bin\n",
+			toString(result.stage),
+			result.size,
+			result.numChannels,
+			result.variant,
+			result.nsPerIteration,
+			result.samplesPerSecond * 1e-6,
+			result.nsPerBin
+		);
+	}
+
+	bool writeJSON(const std::string& path, const Options& options, const std::vector<Result>& results)
+	{
+		std::FILE* file = path == "-" ? stdout : std::fopen(path.c_str(), "w");
+		if (file == nullptr)
+		{
+			fmt::print("gaz_bench: Failed to create '{}'\n", path);
+			return false;
+		}
+
+		fmt::print(
+			file,
+			"{{\n  \"timestamp\": {},\n  \"simd\": \"{}\",\n  \"hardware_concurrency\": {},\n  \"seconds\": {},\n"
+			"  \"results\": [\n",
+			static_cast<long long>(std::time(nullptr)),
+			DSP::toString(DSP::getSIMDLevel()),
+			std::thread::hardware_concurrency(),
+			options.seconds
+		);
+
+		for (size_t i = 0; i < results.size(); ++i)
+		{
+			const Result& result = results[i];
+			fmt::print(
+				file,
+				"    {{\"stage\": \"{}\", \"size\": {}, \"channels\": {}, \"variant\": \"{}\", \"iterations\": {}, "
+				"\"batch_iterations\": {}, \"ns_per_iteration\": {:.1f}, \"samples_per_second\": {:.0f}, "
+				"\"ns_per_bin\": {:.4f}}}{}\n",
+				toString(result.stage),
+				result.size,
+				result.numChannels,
+				result.variant,
+				result.iterations,
+				result.batchIterations,
+				result.nsPerIteration,
+				result.samplesPerSecond,
+				result.nsPerBin,
+				i + 1 < results.size() ? "," : ""
+			);
+		}
+
+		fmt::print(file, "  ]\n}}\n");
+		if (file != stdout)
+		{
+			std::fclose(file);
+		}
+		return true;
+	}
+
+	// Comma separated values, each parsed by 'parse', which returns false for one it doesn't know
+	template <typename T, typename Parse>
+	bool parseList(const std::string& list, std::vector<T>& values, Parse&& parse)
+	{
+		values.clear();
+		size_t start = 0;
+		while (start <= list.size())
+		{
+			const size_t end = std::min(list.find(',', start), list.size());
+			T value;
+			if (!parse(list.substr(start, end - start), value))
+			{
+				fmt::print("gaz_bench: Unknown value '{}'\n", list.substr(start, end - start));
+				return false;
+			}
+			values.push_back(value);
+			start = end + 1;
+		}
+		return !values.empty();
+	}
+
+	bool parseCount(const std::string& text, unsigned int& value, unsigned int min, unsigned int max)
+	{
+		char* end = nullptr;
+		const unsigned long parsed = std::strtoul(text.c_str(), &end, 10);
+		value = static_cast<unsigned int>(parsed);
+		return end != text.c_str() && *end == '\0' && parsed >= min && parsed <= max;
+	}
+};
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string argument = argv[i];
+		bool ok = true;
+		if (argument.rfind("--stages=", 0) == 0)
+		{
+			ok = parseList(argument.substr(9), options.stages, [](const std::string& name, Stage& stage)
+			{
+				for (int s = 0; s < static_cast<int>(Stage::NumStages); ++s)
+				{
+					if (name == toString(static_cast<Stage>(s)))
+					{
+						stage = static_cast<Stage>(s);
+						return true;
+					}
+				}
+				return false;
+			});
+		}
+		else if (argument.rfind("--sizes=", 0) == 0)
+		{
+			// Powers of two, as the engine requires
+			ok = parseList(argument.substr(8), options.sizes, [](const std::string& text, unsigned int& size)
+			{
+				return parseCount(text, size, 16, 1u << 20) && (size & (size - 1)) == 0;
+			});
+		}
+		else if (argument.rfind("--channels=", 0) == 0)
+		{
+			ok = parseList(argument.substr(11), options.channels, [](const std::string& text, unsigned int& count)
+			{
+				return parseCount(text, count, 1, 32);
+			});
+		}
+		else if (argument.rfind("--formats=", 0) == 0)
+		{
+			ok = parseList(argument.substr(10), options.formats, [](const std::string& name, DSP::SampleFormat& format)
+			{
+				for (DSP::SampleFormat candidate : Options{}.formats)
+				{
+					if (name == toString(candidate))
+					{
+						format = candidate;
+						return true;
+					}
+				}
+				return false;
+			});
+		}
+		else if (argument.rfind("--time=", 0) == 0)
+		{
+			options.seconds = std::max(0.01, std::strtod(argument.c_str() + 7, nullptr));
+		}
+		else if (argument == "--patient")
+		{
+			options.patient = true;
+		}
+		else if (argument.rfind("--json=", 0) == 0)
+		{
+			options.jsonPath = argument.substr(7);
+		}
+		else
+		{
+			ok = false;
+		}
+
+		if (!ok)
+		{
+			fmt::print(
+				"Usage: gaz_bench [--stages=<a,b,..>] [--sizes=<n,..>] [--channels=<n,..>] [--formats=<f,..>] "
+				"[--time=<s>] [--patient] [--json=<path>]\n"
+				"  stages: deinterleave, window, fft, decibels, frame, publish\n"
+				"  formats: f32, s16, s24, s24in32, s32\n"
+			);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// With the JSON on stdout, the table goes to stderr
+	std::FILE* table = options.jsonPath == "-" ? stderr : stdout;
+	fmt::print(table, "gaz_bench: SIMD {}\n", DSP::toString(DSP::getSIMDLevel()));
+
+	std::vector<Result> results;
+	for (Stage stage : options.stages)
+	{
+		for (unsigned int size : options.sizes)
+		{
+			for (unsigned int numChannels : options.channels)
+			{
+				const size_t first = results.size();
+				switch (stage)
+				{
+					case Stage::Deinterleave: benchDeinterleave(options, size, numChannels, results); break;
+					case Stage::Window: benchWindow(options, size, numChannels, results); break;
+					case Stage::FFT: benchFFT(options, size, numChannels, results); break;
+					case Stage::Decibels: benchDecibels(options, size, numChannels, results); break;
+					case Stage::Frame: benchFrame(options, size, numChannels, results); break;
+					case Stage::Publish: benchPublish(options, size, numChannels, results); break;
+					default: break;
+				}
+
+				for (size_t i = first; i < results.size(); ++i)
+				{
+					printResult(table, results[i]);
+				}
+			}
+		}
+	}
+
+	if (!options.jsonPath.empty() && !writeJSON(options.jsonPath, options, results))
+	{
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}